@@ -6326,6 +6326,7 @@ static void __init s5pv310_reserve(void)
 				.alignment = 1 << 17,
 			},
 			.start = 0,
+			.lend = 1,
 		},
 #endif
 #ifdef CONFIG_VIDEO_SAMSUNG_MEMSIZE_MFC1
@@ -6336,6 +6337,7 @@ static void __init s5pv310_reserve(void)
 				.alignment = 1 << 17,
 			},
 			.start = 0,
+			.lend = 1,
 		},
 #endif
 #ifdef CONFIG_VIDEO_SAMSUNG_MEMSIZE_FIMC0
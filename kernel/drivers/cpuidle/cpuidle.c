@@ -42,6 +42,33 @@ static void cpuidle_kick_cpus(void) {}
 
 static int __cpuidle_register_device(struct cpuidle_device *dev);
 
+/**
+ * cpuidle_account_residency - classifies the last idle period
+ * @dev: the CPU
+ * @state: the state that was entered
+ *
+ * An idle period shorter than the target residency of the state means the
+ * governor picked a state that was too deep; one long enough for the next
+ * deeper state means the pick was too shallow.  Anything else is a hit.
+ */
+static void cpuidle_account_residency(struct cpuidle_device *dev,
+				      struct cpuidle_state *state)
+{
+	int next = state - dev->states + 1;
+	unsigned int residency = dev->last_residency;
+
+	if (residency > state->exit_latency)
+		residency -= state->exit_latency;
+
+	if (residency < state->target_residency)
+		state->too_deep++;
+	else if (next < dev->state_count &&
+		 residency >= dev->states[next].target_residency)
+		state->too_shallow++;
+	else
+		state->hit++;
+}
+
 /**
  * cpuidle_idle_call - the main idle loop
  *
@@ -91,6 +118,8 @@ static void cpuidle_idle_call(void)
 
 	target_state->time += (unsigned long long)dev->last_residency;
 	target_state->usage++;
+	if (target_state->flags & CPUIDLE_FLAG_TIME_VALID)
+		cpuidle_account_residency(dev, target_state);
 
 	/* give the governor an opportunity to reflect on the outcome */
 	if (cpuidle_curr_governor->reflect)
@@ -177,6 +206,9 @@ int cpuidle_enable_device(struct cpuidle_device *dev)
 	for (i = 0; i < dev->state_count; i++) {
 		dev->states[i].usage = 0;
 		dev->states[i].time = 0;
+		dev->states[i].hit = 0;
+		dev->states[i].too_shallow = 0;
+		dev->states[i].too_deep = 0;
 	}
 	dev->last_residency = 0;
 	dev->last_state = NULL;
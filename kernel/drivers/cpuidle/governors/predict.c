@@ -0,0 +1,417 @@
+/*
+ * predict.c - the predictive idle governor
+ *
+ * Based on the menu governor:
+ * Copyright (C) 2006-2007 Adam Belay <abelay@novell.com>
+ * Copyright (C) 2009 Intel Corporation
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos_params.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+
+#define BUCKETS 6
+#define INTERVALS 8
+#define SOURCES 8
+#define RESOLUTION 1024
+#define DECAY 8
+#define MAX_INTERESTING 50000
+#define MAX_SOURCE_INTERVAL 1000000
+#define STDDEV_THRESH 400
+#define STALE_PERIODS 4
+
+/*
+ * Concepts and ideas behind the predict governor
+ *
+ * The menu governor starts from the next timer event and scales it with
+ * a correction factor learnt from past behaviour.  On a phone most idle
+ * periods are not ended by timers but by device interrupts (touchscreen,
+ * modem, audio DMA), many of which fire at a fixed rate for as long as
+ * the user interacts with the device.  A single correction factor blurs
+ * these together and regularly makes the CPU enter a deep state just
+ * before the next touch sample arrives.
+ *
+ * Per-wakeup-source history
+ * -------------------------
+ * The interrupt that ends an idle period is recorded by the irq core
+ * (cpuidle_note_irq()).  For the last SOURCES distinct interrupts that
+ * woke this CPU we keep the time of the last wakeup and the last
+ * INTERVALS intervals between wakeups.  If those intervals repeat (their
+ * standard deviation is small compared to their average) the source is
+ * periodic and its next wakeup is predicted by extrapolating from the
+ * last one.  Sources that have not woken us for STALE_PERIODS periods
+ * are ignored, so a finished touch gesture stops influencing the choice.
+ *
+ * Per-CPU history
+ * ---------------
+ * As in menu, the last INTERVALS idle durations of the CPU are checked
+ * for a repeating pattern, and the next timer event is scaled by a
+ * correction factor indexed by its order of magnitude.
+ *
+ * Prediction
+ * ----------
+ * When at least one wakeup source is periodic, its earliest predicted
+ * wakeup replaces the correction-factor estimate, which lets the CPU go
+ * deep between two touch samples and stay shallow right before one.
+ * The result is then bounded by the per-CPU pattern and the next timer.
+ *
+ * Whether the choice was right is accounted by the cpuidle core in the
+ * per-state "hit", "too_shallow" and "too_deep" sysfs files.
+ */
+
+struct predict_source {
+	int		irq;
+	u64		last_us;
+	u32		intervals[INTERVALS];
+	int		interval_ptr;
+	int		nr_intervals;
+};
+
+struct predict_device {
+	int		last_state_idx;
+	int		needs_update;
+	int		wakeup_irq;
+
+	unsigned int	expected_us;
+	unsigned int	predicted_us;
+	unsigned int	exit_us;
+	unsigned int	bucket;
+	u64		entry_us;
+	u64		correction_factor[BUCKETS];
+	u32		intervals[INTERVALS];
+	int		interval_ptr;
+	int		nr_intervals;
+	struct predict_source sources[SOURCES];
+};
+
+DEFINE_PER_CPU(int, cpuidle_wakeup_irq) = -1;
+static DEFINE_PER_CPU(struct predict_device, predict_devices);
+
+static void predict_update(struct cpuidle_device *dev);
+
+static inline int which_bucket(unsigned int duration)
+{
+	if (duration < 10)
+		return 0;
+	if (duration < 100)
+		return 1;
+	if (duration < 1000)
+		return 2;
+	if (duration < 10000)
+		return 3;
+	if (duration < 100000)
+		return 4;
+	return 5;
+}
+
+/*
+ * Waiting for IO makes us reluctant to pick states with a high exit
+ * latency, as in menu.
+ */
+static inline int performance_multiplier(void)
+{
+	return 1 + 10 * nr_iowait_cpu(smp_processor_id());
+}
+
+/* This implements DIV_ROUND_CLOSEST but avoids 64 bit division */
+static u64 div_round64(u64 dividend, u32 divisor)
+{
+	return div_u64(dividend + (divisor / 2), divisor);
+}
+
+/*
+ * Returns the average of @count samples if they form a repeating
+ * pattern, that is if their standard deviation is below STDDEV_THRESH
+ * squared or small compared to the average, and 0 otherwise.
+ */
+static unsigned int repeating_interval(const u32 *intervals, int count)
+{
+	u64 avg = 0;
+	u64 variance = 0;
+	int i;
+
+	if (count < INTERVALS / 2)
+		return 0;
+
+	for (i = 0; i < count; i++)
+		avg += intervals[i];
+	avg = div_u64(avg, count);
+
+	for (i = 0; i < count; i++) {
+		s64 diff = (s64)intervals[i] - (s64)avg;
+
+		variance += diff * diff;
+	}
+	variance = div_u64(variance, count);
+
+	if (avg && (variance < STDDEV_THRESH || avg * avg > variance * 36))
+		return avg;
+
+	return 0;
+}
+
+/*
+ * Returns the time in us until the earliest predicted wakeup by one of
+ * the periodic wakeup sources, or UINT_MAX if none is periodic.
+ */
+static unsigned int predict_irq_wakeup(struct predict_device *data,
+				       u64 now_us)
+{
+	unsigned int next = UINT_MAX;
+	int i;
+
+	for (i = 0; i < SOURCES; i++) {
+		struct predict_source *src = &data->sources[i];
+		unsigned int period;
+		u64 elapsed;
+		u32 rem;
+
+		if (src->irq < 0)
+			continue;
+
+		period = repeating_interval(src->intervals, src->nr_intervals);
+		if (!period)
+			continue;
+
+		elapsed = now_us - src->last_us;
+		if (elapsed > (u64)period * STALE_PERIODS)
+			continue;
+
+		div_u64_rem(elapsed, period, &rem);
+		next = min(next, period - rem);
+	}
+
+	return next;
+}
+
+/*
+ * Records that @irq ended the idle period at @wake_us, recycling the
+ * least recently seen slot for a new source.
+ */
+static void predict_record_source(struct predict_device *data, int irq,
+				  u64 wake_us)
+{
+	struct predict_source *src, *victim = &data->sources[0];
+	u64 interval;
+	int i;
+
+	for (i = 0; i < SOURCES; i++) {
+		src = &data->sources[i];
+		if (src->irq == irq)
+			goto found;
+		if (src->last_us < victim->last_us)
+			victim = src;
+	}
+
+	memset(victim, 0, sizeof(*victim));
+	victim->irq = irq;
+	victim->last_us = wake_us;
+	return;
+
+found:
+	interval = wake_us - src->last_us;
+	if (interval > MAX_SOURCE_INTERVAL)
+		interval = MAX_SOURCE_INTERVAL;
+
+	src->intervals[src->interval_ptr++] = interval;
+	if (src->interval_ptr >= INTERVALS)
+		src->interval_ptr = 0;
+	if (src->nr_intervals < INTERVALS)
+		src->nr_intervals++;
+	src->last_us = wake_us;
+}
+
+/**
+ * predict_select - selects the next idle state to enter
+ * @dev: the CPU
+ */
+static int predict_select(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int pattern_us, irq_us;
+	int i;
+	int multiplier;
+
+	if (data->needs_update) {
+		predict_update(dev);
+		data->needs_update = 0;
+	}
+
+	data->last_state_idx = 0;
+	data->exit_us = 0;
+	__get_cpu_var(cpuidle_wakeup_irq) = -1;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	/* determine the expected residency time, round up */
+	data->expected_us =
+	    DIV_ROUND_UP((u32)ktime_to_ns(tick_nohz_get_sleep_length()), 1000);
+	data->entry_us = ktime_to_us(ktime_get());
+
+	data->bucket = which_bucket(data->expected_us);
+
+	multiplier = performance_multiplier();
+
+	if (data->correction_factor[data->bucket] == 0)
+		data->correction_factor[data->bucket] = RESOLUTION * DECAY;
+
+	irq_us = predict_irq_wakeup(data, data->entry_us);
+	if (irq_us != UINT_MAX)
+		data->predicted_us = min(irq_us, data->expected_us);
+	else
+		data->predicted_us = div_round64((u64)data->expected_us *
+					data->correction_factor[data->bucket],
+					RESOLUTION * DECAY);
+
+	pattern_us = repeating_interval(data->intervals, data->nr_intervals);
+	if (pattern_us && pattern_us < data->predicted_us)
+		data->predicted_us = pattern_us;
+
+	/*
+	 * We want to default to C1 (hlt), not to busy polling
+	 * unless the timer is happening really really soon.
+	 */
+	if (data->expected_us > 5)
+		data->last_state_idx = CPUIDLE_DRIVER_STATE_START;
+
+	/* find the deepest idle state that satisfies our constraints */
+	for (i = CPUIDLE_DRIVER_STATE_START; i < dev->state_count; i++) {
+		struct cpuidle_state *s = &dev->states[i];
+
+		if (s->target_residency > data->predicted_us)
+			break;
+		if (s->exit_latency > latency_req)
+			break;
+		if (s->exit_latency * multiplier > data->predicted_us)
+			break;
+		data->exit_us = s->exit_latency;
+		data->last_state_idx = i;
+	}
+
+	return data->last_state_idx;
+}
+
+/**
+ * predict_reflect - records the wakeup source, defers the rest
+ * @dev: the CPU
+ *
+ * NOTE: it's important to be fast here because this operation will add to
+ *       the overall exit latency.
+ */
+static void predict_reflect(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+
+	data->wakeup_irq = __get_cpu_var(cpuidle_wakeup_irq);
+	data->needs_update = 1;
+}
+
+/**
+ * predict_update - learns from the last idle period
+ * @dev: the CPU
+ */
+static void predict_update(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	struct cpuidle_state *target = &dev->states[data->last_state_idx];
+	unsigned int last_idle_us = cpuidle_get_last_residency(dev);
+	unsigned int measured_us;
+	u64 new_factor;
+
+	/*
+	 * Without residency measurements assume we slept for the whole
+	 * expected time, and don't trust the wakeup timestamp either.
+	 */
+	if (unlikely(!(target->flags & CPUIDLE_FLAG_TIME_VALID))) {
+		last_idle_us = data->expected_us;
+		data->wakeup_irq = -1;
+	}
+
+	measured_us = last_idle_us;
+	if (measured_us > data->exit_us)
+		measured_us -= data->exit_us;
+
+	/* update our correction ratio */
+	new_factor = data->correction_factor[data->bucket]
+			* (DECAY - 1) / DECAY;
+
+	if (data->expected_us > 0 && measured_us < MAX_INTERESTING)
+		new_factor += RESOLUTION * measured_us / data->expected_us;
+	else
+		new_factor += RESOLUTION;
+
+	if (new_factor == 0)
+		new_factor = 1;
+
+	data->correction_factor[data->bucket] = new_factor;
+
+	/* update the per-CPU repeating-pattern data */
+	data->intervals[data->interval_ptr++] = last_idle_us;
+	if (data->interval_ptr >= INTERVALS)
+		data->interval_ptr = 0;
+	if (data->nr_intervals < INTERVALS)
+		data->nr_intervals++;
+
+	/* and the history of whoever woke us up */
+	if (data->wakeup_irq >= 0)
+		predict_record_source(data, data->wakeup_irq,
+				      data->entry_us + last_idle_us);
+}
+
+/**
+ * predict_enable_device - scans a CPU's states and does setup
+ * @dev: the CPU
+ */
+static int predict_enable_device(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &per_cpu(predict_devices, dev->cpu);
+	int i;
+
+	memset(data, 0, sizeof(struct predict_device));
+	data->wakeup_irq = -1;
+	for (i = 0; i < SOURCES; i++)
+		data->sources[i].irq = -1;
+
+	return 0;
+}
+
+static struct cpuidle_governor predict_governor = {
+	.name =		"predict",
+	.rating =	25,
+	.enable =	predict_enable_device,
+	.select =	predict_select,
+	.reflect =	predict_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_predict - initializes the governor
+ */
+static int __init init_predict(void)
+{
+	return cpuidle_register_governor(&predict_governor);
+}
+
+/**
+ * exit_predict - exits the governor
+ */
+static void __exit exit_predict(void)
+{
+	cpuidle_unregister_governor(&predict_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_predict);
+module_exit(exit_predict);
@@ -33,6 +33,8 @@
 #define PMEM_MAX_DEVICES 10
 #define PMEM_MAX_ORDER 128
 #define PMEM_MIN_ALLOC PAGE_SIZE
+/* number of free lists, enough for any region num_entries can describe */
+#define PMEM_NR_ORDERS (sizeof(unsigned long) * 8)
 
 #define PMEM_DEBUG 1
 
@@ -85,6 +87,7 @@ struct pmem_data {
 struct pmem_bits {
 	unsigned allocated:1;		/* 1 if allocated, 0 if free */
 	unsigned order:7;		/* size of the region in pmem space */
+	struct list_head free;		/* on free_area[order] if free */
 };
 
 struct pmem_region_node {
@@ -119,6 +122,12 @@ struct pmem_info {
 	/* the bitmap for the region indicating which entries are allocated
 	 * and which are free */
 	struct pmem_bits *bitmap;
+	/* the free blocks of each order, linked through their first entry
+	 * in the bitmap, so allocating and freeing never scan the bitmap */
+	struct list_head free_area[PMEM_NR_ORDERS];
+	unsigned long nr_free[PMEM_NR_ORDERS];
+	/* allocations that found no free block large enough */
+	unsigned long nr_failed;
 	/* indicates the region should not be managed with an allocator */
 	unsigned no_allocator;
 	/* indicates maps of this region should be cached, if a mix of
@@ -134,7 +143,7 @@ struct pmem_info {
 	 * needed */
 	struct semaphore data_list_sem;
 	struct list_head data_list;
-	/* pmem_sem protects the bitmap array
+	/* pmem_sem protects the bitmap array and the free lists
 	 * a write lock should be held when modifying entries in bitmap
 	 * a read lock should be held when reading data from bits or
 	 * dereferencing a pointer into bitmap
@@ -235,6 +244,20 @@ static int is_master_owner(struct file *file)
 	return ret;
 }
 
+static void pmem_add_free(int id, int index)
+{
+	int order = PMEM_ORDER(id, index);
+
+	list_add(&pmem[id].bitmap[index].free, &pmem[id].free_area[order]);
+	pmem[id].nr_free[order]++;
+}
+
+static void pmem_del_free(int id, int index)
+{
+	list_del(&pmem[id].bitmap[index].free);
+	pmem[id].nr_free[PMEM_ORDER(id, index)]--;
+}
+
 static int pmem_free(int id, int index)
 {
 	/* caller should hold the write lock on pmem_sem! */
@@ -251,17 +274,17 @@ static int pmem_free(int id, int index)
 	 * if the buddy is also free merge them
 	 * repeat until the buddy is not free or end of the bitmap is reached
 	 */
-	do {
+	for (;;) {
 		buddy = PMEM_BUDDY_INDEX(id, curr);
-		if (PMEM_IS_FREE(id, buddy) &&
-				PMEM_ORDER(id, buddy) == PMEM_ORDER(id, curr)) {
-			PMEM_ORDER(id, buddy)++;
-			PMEM_ORDER(id, curr)++;
-			curr = min(buddy, curr);
-		} else {
+		if (buddy >= pmem[id].num_entries || !PMEM_IS_FREE(id, buddy) ||
+		    PMEM_ORDER(id, buddy) != PMEM_ORDER(id, curr))
 			break;
-		}
-	} while (curr < pmem[id].num_entries);
+		pmem_del_free(id, buddy);
+		PMEM_ORDER(id, buddy)++;
+		PMEM_ORDER(id, curr)++;
+		curr = min(buddy, curr);
+	}
+	pmem_add_free(id, curr);
 
 	return 0;
 }
@@ -383,10 +406,9 @@ static int pmem_allocate(int id, unsigned long len)
 {
 	/* caller should hold the write lock on pmem_sem! */
 	/* return the corresponding pdata[] entry */
-	int curr = 0;
-	int end = pmem[id].num_entries;
-	int best_fit = -1;
-	unsigned long order = pmem_order(len);
+	struct pmem_bits *bits;
+	int best_fit;
+	unsigned long order = pmem_order(len), curr;
 
 	if (pmem[id].no_allocator) {
 		DLOG("no allocator");
@@ -400,32 +422,25 @@ static int pmem_allocate(int id, unsigned long len)
 		return -1;
 	DLOG("order %lx\n", order);
 
-	/* look through the bitmap:
-	 * 	if you find a free slot of the correct order use it
-	 * 	otherwise, use the best fit (smallest with size > order) slot
+	/* use a free slot of the correct order if there is one,
+	 * otherwise the best fit (smallest with size > order) slot
 	 */
-	while (curr < end) {
-		if (PMEM_IS_FREE(id, curr)) {
-			if (PMEM_ORDER(id, curr) == (unsigned char)order) {
-				/* set the not free bit and clear others */
-				best_fit = curr;
-				break;
-			}
-			if (PMEM_ORDER(id, curr) > (unsigned char)order &&
-			    (best_fit < 0 ||
-			     PMEM_ORDER(id, curr) < PMEM_ORDER(id, best_fit)))
-				best_fit = curr;
-		}
-		curr = PMEM_NEXT_INDEX(id, curr);
-	}
+	for (curr = order; curr < PMEM_NR_ORDERS; curr++)
+		if (!list_empty(&pmem[id].free_area[curr]))
+			break;
 
-	/* if best_fit < 0, there are no suitable slots,
+	/* if there is no such order, there are no suitable slots,
 	 * return an error
 	 */
-	if (best_fit < 0) {
+	if (curr >= PMEM_NR_ORDERS) {
+		pmem[id].nr_failed++;
 		printk("pmem: no space left to allocate!\n");
 		return -1;
 	}
+	bits = list_first_entry(&pmem[id].free_area[curr], struct pmem_bits,
+				free);
+	best_fit = bits - pmem[id].bitmap;
+	pmem_del_free(id, best_fit);
 
 	/* now partition the best fit:
 	 * 	split the slot into 2 buddies of order - 1
@@ -436,6 +451,8 @@ static int pmem_allocate(int id, unsigned long len)
 		PMEM_ORDER(id, best_fit) -= 1;
 		buddy = PMEM_BUDDY_INDEX(id, best_fit);
 		PMEM_ORDER(id, buddy) = PMEM_ORDER(id, best_fit);
+		pmem[id].bitmap[buddy].allocated = 0;
+		pmem_add_free(id, buddy);
 	}
 	pmem[id].bitmap[best_fit].allocated = 1;
 	return best_fit;
@@ -1202,11 +1219,35 @@ static ssize_t debug_read(struct file *file, char __user *buf, size_t count,
 	int id = (int)file->private_data;
 	const int debug_bufmax = 4096;
 	static char buffer[4096];
-	int n = 0;
+	unsigned long free = 0, largest = 0;
+	int i, n = 0;
 
 	DLOG("debug open\n");
-	n = scnprintf(buffer, debug_bufmax,
-		      "pid #: mapped regions (offset, len) (offset,len)...\n");
+	if (!pmem[id].no_allocator) {
+		/* fragmentation: how much of the free space lies outside the
+		 * largest free block */
+		down_read(&pmem[id].bitmap_sem);
+		n += scnprintf(buffer + n, debug_bufmax - n,
+			       "free blocks (order:count):");
+		for (i = 0; i < PMEM_NR_ORDERS; i++) {
+			if (!pmem[id].nr_free[i])
+				continue;
+			n += scnprintf(buffer + n, debug_bufmax - n, " %d:%lu",
+				       i, pmem[id].nr_free[i]);
+			free += pmem[id].nr_free[i] << i;
+			largest = 1UL << i;
+		}
+		n += scnprintf(buffer + n, debug_bufmax - n,
+			       "\nfree %lukB largest %lukB fragmentation %lu%% "
+			       "failed %lu\n",
+			       free * (PMEM_MIN_ALLOC >> 10),
+			       largest * (PMEM_MIN_ALLOC >> 10),
+			       free ? 100 - largest * 100 / free : 0,
+			       pmem[id].nr_failed);
+		up_read(&pmem[id].bitmap_sem);
+	}
+	n += scnprintf(buffer + n, debug_bufmax - n,
+		       "pid #: mapped regions (offset, len) (offset,len)...\n");
 
 	down(&pmem[id].data_list_sem);
 	list_for_each(elt, &pmem[id].data_list) {
@@ -1288,9 +1329,13 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	memset(pmem[id].bitmap, 0, sizeof(struct pmem_bits) *
 					  pmem[id].num_entries);
 
+	for (i = 0; i < PMEM_NR_ORDERS; i++)
+		INIT_LIST_HEAD(&pmem[id].free_area[i]);
+
 	for (i = sizeof(pmem[id].num_entries) * 8 - 1; i >= 0; i--) {
 		if ((pmem[id].num_entries) &  1<<i) {
 			PMEM_ORDER(id, index) = i;
+			pmem_add_free(id, index);
 			index = PMEM_NEXT_INDEX(id, index);
 		}
 	}
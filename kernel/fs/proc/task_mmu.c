@@ -9,6 +9,10 @@
 #include <linux/mempolicy.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/memsum.h>
+#include <linux/proc_fs.h>
+#include <linux/pid_namespace.h>
+#include <linux/init.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -108,7 +112,7 @@ static void *m_start(struct seq_file *m, loff_t *pos)
 
 	/*
 	 * We remember last_addr rather than next_addr to hit with
-	 * mmap_cache most of the time. We have zero last_addr at
+	 * vmacache most of the time. We have zero last_addr at
 	 * the beginning and also after lseek. We will have -1 last_addr
 	 * after the end of the vmas.
 	 */
@@ -448,6 +452,246 @@ const struct file_operations proc_smaps_operations = {
 	.release	= seq_release_private,
 };
 
+/*
+ * Memory summaries: the smaps numbers summed up per mapping type, in
+ * binary.  Monitoring every process through smaps costs a page table
+ * walk per vma restarted from seq_file and a lot of formatting.
+ */
+
+/* How long /proc/memsum trusts a PSS whose rss counters did not change */
+#define MEMSUM_MAX_AGE	(30 * HZ)
+
+static int memsum_vma_type(struct vm_area_struct *vma)
+{
+	if (!vma->vm_file)
+		return MEMSUM_ANON;
+	if (vma->vm_flags & VM_MAYSHARE)
+		return MEMSUM_SHARED;
+	return MEMSUM_FILE;
+}
+
+/*
+ * Sums up the memory of @mm into @ms and returns the total PSS.
+ * The caller must hold mmap_sem for reading.
+ */
+static u64 memsum_mm(struct mm_struct *mm, struct memsum *ms)
+{
+	unsigned long stamp[NR_MM_COUNTERS];
+	u64 pss[MEMSUM_NR_TYPES] = { 0 };
+	struct vm_area_struct *vma;
+	struct memsum_type *t;
+	struct mem_size_stats mss;
+	struct mm_walk memsum_walk = {
+		.pmd_entry = smaps_pte_range,
+		.mm = mm,
+		.private = &mss,
+	};
+	u64 total = 0;
+	int i;
+
+	/* before the walk: a change while walking forces the next one */
+	for (i = 0; i < NR_MM_COUNTERS; i++)
+		stamp[i] = get_mm_counter(mm, i);
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		i = memsum_vma_type(vma);
+		t = &ms->type[i];
+
+		memset(&mss, 0, sizeof mss);
+		mss.vma = vma;
+		if (!is_vm_hugetlb_page(vma))
+			walk_page_range(vma->vm_start, vma->vm_end,
+					&memsum_walk);
+
+		t->size += vma->vm_end - vma->vm_start;
+		t->rss += mss.resident;
+		t->swap += mss.swap;
+		t->shared_clean += mss.shared_clean;
+		t->shared_dirty += mss.shared_dirty;
+		t->private_clean += mss.private_clean;
+		t->private_dirty += mss.private_dirty;
+		pss[i] += mss.pss;
+	}
+	for (i = 0; i < MEMSUM_NR_TYPES; i++) {
+		ms->type[i].pss = pss[i] >> PSS_SHIFT;
+		total += ms->type[i].pss;
+	}
+
+	spin_lock(&mm->page_table_lock);
+	memcpy(mm->memsum_rss_stat, stamp, sizeof stamp);
+	mm->memsum_pss = total;
+	mm->memsum_time = jiffies ?: 1;
+	spin_unlock(&mm->page_table_lock);
+
+	return total;
+}
+
+/*
+ * PSS of @mm from its last walk if its own rss counters have not changed
+ * since.  Pages it shares may have been mapped or unmapped by others in
+ * the meantime, so the result is not trusted for longer than
+ * MEMSUM_MAX_AGE.
+ */
+static u64 memsum_pss(struct mm_struct *mm)
+{
+	struct memsum ms;
+	bool fresh = true;
+	u64 pss;
+	int i;
+
+	spin_lock(&mm->page_table_lock);
+	if (!mm->memsum_time ||
+	    time_after(jiffies, mm->memsum_time + MEMSUM_MAX_AGE))
+		fresh = false;
+	for (i = 0; fresh && i < NR_MM_COUNTERS; i++)
+		if (mm->memsum_rss_stat[i] != get_mm_counter(mm, i))
+			fresh = false;
+	pss = mm->memsum_pss;
+	spin_unlock(&mm->page_table_lock);
+	if (fresh)
+		return pss;
+
+	memset(&ms, 0, sizeof ms);
+	down_read(&mm->mmap_sem);
+	pss = memsum_mm(mm, &ms);
+	up_read(&mm->mmap_sem);
+	return pss;
+}
+
+static ssize_t memsum_read(struct file *file, char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	struct task_struct *task = get_proc_task(file->f_path.dentry->d_inode);
+	struct mm_struct *mm;
+	struct memsum ms;
+
+	if (!task)
+		return -ESRCH;
+	if (*ppos >= sizeof ms) {
+		put_task_struct(task);
+		return 0;
+	}
+	mm = mm_for_maps(task);
+	put_task_struct(task);
+	if (!mm)
+		return 0;
+
+	memset(&ms, 0, sizeof ms);
+	ms.version = MEMSUM_VERSION;
+	ms.nr_types = MEMSUM_NR_TYPES;
+	down_read(&mm->mmap_sem);
+	memsum_mm(mm, &ms);
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+
+	return simple_read_from_buffer(buf, count, ppos, &ms, sizeof ms);
+}
+
+const struct file_operations proc_memsum_operations = {
+	.llseek		= mem_lseek, /* borrow this */
+	.read		= memsum_read,
+};
+
+/* Returns the first thread group leader with a tgid >= *tgid, referenced */
+static struct task_struct *memsum_next_task(struct pid_namespace *ns,
+					    pid_t *tgid)
+{
+	struct task_struct *task = NULL;
+	struct pid *pid;
+
+	rcu_read_lock();
+retry:
+	pid = find_ge_pid(*tgid, ns);
+	if (pid) {
+		*tgid = pid_nr_ns(pid, ns);
+		task = pid_task(pid, PIDTYPE_PID);
+		if (!task || !has_group_leader_pid(task)) {
+			*tgid += 1;
+			goto retry;
+		}
+		get_task_struct(task);
+	}
+	rcu_read_unlock();
+	return task;
+}
+
+/*
+ * /proc/memsum: a struct memsum_proc for every process with an mm, as
+ * many as fit in the buffer.  The file position is the pid to go on
+ * from.  The rss and swap numbers are the counters the mm maintains
+ * anyway; only the PSS needs a page table walk, and that is skipped
+ * when it cannot have changed much, see memsum_pss().
+ */
+static ssize_t memsum_all_read(struct file *file, char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct pid_namespace *ns = file->f_path.dentry->d_sb->s_fs_info;
+	struct task_struct *task;
+	struct memsum_proc rec;
+	struct mm_struct *mm;
+	ssize_t copied = 0;
+	pid_t tgid;
+
+	if (count < sizeof rec)
+		return -EINVAL;
+	if (*ppos < 0 || *ppos >= PID_MAX_LIMIT)
+		return 0;
+	tgid = *ppos;
+
+	while (count >= sizeof rec) {
+		task = memsum_next_task(ns, &tgid);
+		if (!task)
+			break;
+
+		mm = get_task_mm(task);
+		if (mm) {
+			memset(&rec, 0, sizeof rec);
+			rec.pid = tgid;
+			rec.oom_adj = task->signal->oom_adj;
+			rec.rss_anon = (u64)get_mm_counter(mm, MM_ANONPAGES)
+					<< PAGE_SHIFT;
+			rec.rss_file = (u64)get_mm_counter(mm, MM_FILEPAGES)
+					<< PAGE_SHIFT;
+			rec.swap = (u64)get_mm_counter(mm, MM_SWAPENTS)
+					<< PAGE_SHIFT;
+			rec.pss = memsum_pss(mm);
+			mmput(mm);
+		}
+		put_task_struct(task);
+
+		if (mm) {
+			if (copy_to_user(buf, &rec, sizeof rec)) {
+				if (!copied)
+					copied = -EFAULT;
+				break;
+			}
+			buf += sizeof rec;
+			count -= sizeof rec;
+			copied += sizeof rec;
+		}
+		tgid++;
+
+		if (fatal_signal_pending(current))
+			break;
+		cond_resched();
+	}
+	if (copied > 0)
+		*ppos = tgid;
+	return copied;
+}
+
+static const struct file_operations proc_memsum_all_operations = {
+	.llseek		= mem_lseek, /* borrow this */
+	.read		= memsum_all_read,
+};
+
+static int __init proc_memsum_init(void)
+{
+	proc_create("memsum", S_IRUSR, NULL, &proc_memsum_all_operations);
+	return 0;
+}
+module_init(proc_memsum_init);
+
 static int clear_refs_pte_range(pmd_t *pmd, unsigned long addr,
 				unsigned long end, struct mm_walk *walk)
 {
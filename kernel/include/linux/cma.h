@@ -223,6 +223,17 @@ struct cma_allocator;
  *		this region is converted from early to normal.  Early.
  *		Private.
  * @free_alloc_name:	Whether @alloc_name was kmalloced().  Private.
+ * @lend:	Whether the region's memory is lent to the page allocator
+ *		while no chunk uses it.  Early.  Needs CONFIG_CMA_MIGRATE.
+ * @lent_start:	First pfn of the part of the region that is lent.  Only
+ *		whole, aligned pageblocks are lent.  Read only.
+ * @lent_end:	The pfn after the lent part.  Read only.
+ * @reclaims:	Number of allocations that had to take lent pages back.
+ * @reclaim_fails:	Number of those that failed because some page could
+ *		not be migrated.
+ * @migrated:	Number of pages migrated away for allocations.
+ * @reclaim_us:	Total time spent taking lent pages back, in microseconds.
+ * @reclaim_max_us:	Longest time a single allocation spent on it.
  *
  * Regions come in two types: an early region and normal region.  The
  * former can be reserved or not-reserved.  Fields marked as "early"
@@ -237,6 +248,12 @@ struct cma_allocator;
  * Later, during CMA initialisation all reserved regions from the
  * cma_early_regions list are registered as normal regions and can be
  * used using standard mechanisms.
+ *
+ * With CONFIG_CMA_MIGRATE, the memory of a region that has the lend
+ * flag set is given to the page allocator when the region is
+ * registered, for movable pages only.  Allocating a chunk then
+ * migrates the pages in its way elsewhere, and freeing it gives the
+ * memory back.
  */
 struct cma_region {
 	const char *name;
@@ -258,11 +275,18 @@ struct cma_region {
 	struct kobject kobj;
 #endif
 
+#if defined CONFIG_CMA_MIGRATE
+	unsigned long lent_start, lent_end;
+	unsigned long reclaims, reclaim_fails, migrated;
+	unsigned long reclaim_us, reclaim_max_us;
+#endif
+
 	unsigned used:1;
 	unsigned registered:1;
 	unsigned reserved:1;
 	unsigned copy_name:1;
 	unsigned free_alloc_name:1;
+	unsigned lend:1;
 };
 
 
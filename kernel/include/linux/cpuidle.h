@@ -40,6 +40,9 @@ struct cpuidle_state {
 
 	unsigned long long	usage;
 	unsigned long long	time; /* in US */
+	unsigned long long	hit; /* fit this state */
+	unsigned long long	too_shallow; /* a deeper state would have fit */
+	unsigned long long	too_deep; /* left before target_residency */
 
 	int (*enter)	(struct cpuidle_device *dev,
 			 struct cpuidle_state *state);
@@ -184,6 +187,29 @@ static inline void cpuidle_unregister_governor(struct cpuidle_governor *gov) { }
 
 #endif
 
+#ifdef CONFIG_CPU_IDLE_GOV_PREDICT
+
+DECLARE_PER_CPU(int, cpuidle_wakeup_irq);
+
+/**
+ * cpuidle_note_irq - records the first interrupt taken after idle entry
+ * @irq: the interrupt number
+ *
+ * The predict governor arms cpuidle_wakeup_irq with -1 before each idle
+ * period, so only the interrupt that actually ended it is recorded.
+ */
+static inline void cpuidle_note_irq(unsigned int irq)
+{
+	if (unlikely(__get_cpu_var(cpuidle_wakeup_irq) < 0))
+		__get_cpu_var(cpuidle_wakeup_irq) = irq;
+}
+
+#else
+
+static inline void cpuidle_note_irq(unsigned int irq) { }
+
+#endif
+
 #ifdef CONFIG_ARCH_HAS_CPU_RELAX
 #define CPUIDLE_DRIVER_STATE_START	1
 #else
@@ -632,6 +632,10 @@ struct address_space {
 	spinlock_t		i_mmap_lock;	/* protect tree, count, list */
 	unsigned int		truncate_count;	/* Cover race condition with truncate */
 	unsigned long		nrpages;	/* number of total pages */
+	unsigned long		nrshadows;	/* number of shadow entries */
+	struct list_head	shadow_list;	/* mappings with shadows */
+	pgoff_t			shadow_index;	/* where pruning goes on */
+	unsigned int		ra_wasted;	/* readahead evicted unused */
 	pgoff_t			writeback_index;/* writeback starts here */
 	const struct address_space_operations *a_ops;	/* methods */
 	unsigned long		flags;		/* error bits/gfp mask */
@@ -899,6 +903,9 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	unsigned int wasted_seen;	/* mapping->ra_wasted last looked at */
+	unsigned int shrink;		/* window is ra_pages >> shrink */
 };
 
 /*
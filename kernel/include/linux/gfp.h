@@ -342,4 +342,13 @@ extern gfp_t gfp_allowed_mask;
 extern void set_gfp_allowed_mask(gfp_t mask);
 extern gfp_t clear_gfp_allowed_mask(gfp_t mask);
 
+#ifdef CONFIG_CMA_MIGRATE
+/* The range must lie within a single zone. */
+extern int alloc_contig_range(unsigned long start, unsigned long end,
+			      unsigned migratetype);
+extern void free_contig_range(unsigned long pfn, unsigned long nr_pages);
+
+extern void init_cma_reserved_pageblock(struct page *page);
+#endif
+
 #endif /* __LINUX_GFP_H */
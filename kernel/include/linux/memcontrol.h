@@ -130,6 +130,8 @@ void mem_cgroup_update_file_mapped(struct page *page, int val);
 unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 						gfp_t gfp_mask, int nid,
 						int zid);
+void mem_cgroup_vmpressure(struct mem_cgroup *mem, gfp_t gfp_mask,
+			   unsigned long scanned, unsigned long reclaimed);
 #else /* CONFIG_CGROUP_MEM_RES_CTLR */
 struct mem_cgroup;
 
@@ -309,6 +311,12 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 	return 0;
 }
 
+static inline void mem_cgroup_vmpressure(struct mem_cgroup *mem,
+					 gfp_t gfp_mask, unsigned long scanned,
+					 unsigned long reclaimed)
+{
+}
+
 #endif /* CONFIG_CGROUP_MEM_CONT */
 
 #endif /* _LINUX_MEMCONTROL_H */
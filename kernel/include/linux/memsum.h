@@ -0,0 +1,50 @@
+#ifndef _LINUX_MEMSUM_H
+#define _LINUX_MEMSUM_H
+
+/*
+ * Binary memory summaries, read from /proc/<pid>/memsum and /proc/memsum.
+ * See Documentation/vm/memsum.txt.
+ */
+
+#include <linux/types.h>
+
+#define MEMSUM_VERSION	1
+
+/* Mapping types a process's memory is summed up by */
+enum {
+	MEMSUM_ANON,		/* anonymous: heap, stacks, ... */
+	MEMSUM_FILE,		/* private file mappings: code, data */
+	MEMSUM_SHARED,		/* shared: ashmem, tmpfs, files */
+	MEMSUM_NR_TYPES
+};
+
+/* All sizes are in bytes, the fields mean the same as in smaps */
+struct memsum_type {
+	__u64 size;
+	__u64 rss;
+	__u64 pss;
+	__u64 swap;
+	__u64 shared_clean;
+	__u64 shared_dirty;
+	__u64 private_clean;
+	__u64 private_dirty;
+};
+
+/* /proc/<pid>/memsum */
+struct memsum {
+	__u32 version;
+	__u32 nr_types;
+	struct memsum_type type[MEMSUM_NR_TYPES];
+};
+
+/* /proc/memsum: one record per process, the file position is a pid */
+struct memsum_proc {
+	__u32 pid;
+	__s32 oom_adj;
+	__u64 rss_anon;
+	__u64 rss_file;
+	__u64 swap;
+	__u64 pss;
+};
+
+#endif /* _LINUX_MEMSUM_H */
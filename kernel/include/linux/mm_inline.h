@@ -19,9 +19,172 @@ static inline int page_is_file_cache(struct page *page)
 	return !PageSwapBacked(page);
 }
 
+#ifdef CONFIG_LRU_GEN
+extern int lru_gen_mode;
+
+/*
+ * lru_gen_enabled - are evictable pages kept in generations?
+ *
+ * Chosen once at boot with lru_gen=, see Documentation/vm/multigen_lru.txt.
+ */
+static inline bool lru_gen_enabled(void)
+{
+	return lru_gen_mode;
+}
+
+static inline int lru_gen_from_seq(unsigned long seq)
+{
+	return seq % MAX_NR_GENS;
+}
+
+/*
+ * page_lru_gen - the generation of a page, or -1 if the page is not on
+ * a generation list.  The generation is stored in page->flags plus one,
+ * so that freshly initialised pages read as -1.
+ */
+static inline int page_lru_gen(struct page *page)
+{
+	return ((page->flags & LRU_GEN_MASK) >> LRU_GEN_PGOFF) - 1;
+}
+
+static inline void set_page_lru_gen(struct page *page, int gen)
+{
+	unsigned long old_flags, new_flags;
+
+	/* the other bits of page->flags are changed with atomic bitops */
+	do {
+		old_flags = ACCESS_ONCE(page->flags);
+		new_flags = (old_flags & ~LRU_GEN_MASK) |
+			    ((gen + 1UL) << LRU_GEN_PGOFF);
+	} while (cmpxchg(&page->flags, old_flags, new_flags) != old_flags);
+}
+
+static inline bool lru_gen_is_active(struct zone *zone, int gen)
+{
+	unsigned long max_seq = zone->lrugen.max_seq;
+
+	return gen == lru_gen_from_seq(max_seq) ||
+	       gen == lru_gen_from_seq(max_seq - 1);
+}
+
+static inline void
+lru_gen_update_size(struct zone *zone, int gen, int file, long delta)
+{
+	enum lru_list l = file * LRU_FILE;
+
+	if (lru_gen_is_active(zone, gen))
+		l += LRU_ACTIVE;
+	zone->lrugen.nr_pages[gen][file] += delta;
+	__mod_zone_page_state(zone, NR_LRU_BASE + l, delta);
+}
+
+/*
+ * Active pages go into the youngest generation.  Everything else goes
+ * into the second oldest one, so that it gets a little time to be used
+ * before it is evicted, unless that one is already accounted active.
+ */
+static inline void
+lru_gen_add_page(struct zone *zone, struct page *page, bool active)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	int file = page_is_file_cache(page);
+	unsigned long seq;
+	int gen;
+
+	VM_BUG_ON(page_lru_gen(page) != -1);
+
+	if (active)
+		seq = lrugen->max_seq;
+	else if (lrugen->min_seq[file] + MIN_NR_GENS >= lrugen->max_seq)
+		seq = lrugen->min_seq[file];
+	else
+		seq = lrugen->min_seq[file] + 1;
+
+	gen = lru_gen_from_seq(seq);
+	ClearPageActive(page);
+	set_page_lru_gen(page, gen);
+	lru_gen_update_size(zone, gen, file, 1);
+	list_add(&page->lru, &lrugen->lists[gen][file]);
+}
+
+/*
+ * If @keep_active, a page taken out of one of the two youngest
+ * generations keeps PG_active, so that putting it back on the LRU
+ * keeps it young.
+ */
+static inline void
+lru_gen_del_page(struct zone *zone, struct page *page, bool keep_active)
+{
+	int gen = page_lru_gen(page);
+	int file = page_is_file_cache(page);
+
+	VM_BUG_ON(gen < 0);
+
+	if (keep_active && lru_gen_is_active(zone, gen))
+		SetPageActive(page);
+	set_page_lru_gen(page, -1);
+	lru_gen_update_size(zone, gen, file, -1);
+	list_del(&page->lru);
+}
+
+/*
+ * Move an inactive page to the tail of the oldest generation of its
+ * type.  Returns false if the page is active and was left alone.
+ */
+static inline bool lru_gen_rotate_page(struct zone *zone, struct page *page)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	int file = page_is_file_cache(page);
+	int gen = page_lru_gen(page);
+	int oldest = lru_gen_from_seq(lrugen->min_seq[file]);
+
+	VM_BUG_ON(gen < 0);
+
+	if (lru_gen_is_active(zone, gen))
+		return false;
+
+	if (gen != oldest) {
+		lru_gen_update_size(zone, gen, file, -1);
+		set_page_lru_gen(page, oldest);
+		lru_gen_update_size(zone, oldest, file, 1);
+	}
+	list_move_tail(&page->lru, &lrugen->lists[oldest][file]);
+	return true;
+}
+#else
+static inline bool lru_gen_enabled(void)
+{
+	return false;
+}
+
+static inline int page_lru_gen(struct page *page)
+{
+	return -1;
+}
+
+static inline void
+lru_gen_add_page(struct zone *zone, struct page *page, bool active)
+{
+}
+
+static inline void
+lru_gen_del_page(struct zone *zone, struct page *page, bool keep_active)
+{
+}
+
+static inline bool lru_gen_rotate_page(struct zone *zone, struct page *page)
+{
+	return false;
+}
+#endif /* CONFIG_LRU_GEN */
+
 static inline void
 add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list l)
 {
+	if (lru_gen_enabled() && !is_unevictable_lru(l)) {
+		lru_gen_add_page(zone, page, is_active_lru(l));
+		return;
+	}
 	list_add(&page->lru, &zone->lru[l].list);
 	__inc_zone_state(zone, NR_LRU_BASE + l);
 	mem_cgroup_add_lru_list(page, l);
@@ -30,6 +193,10 @@ add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list l)
 static inline void
 del_page_from_lru_list(struct zone *zone, struct page *page, enum lru_list l)
 {
+	if (page_lru_gen(page) >= 0) {
+		lru_gen_del_page(zone, page, true);
+		return;
+	}
 	list_del(&page->lru);
 	__dec_zone_state(zone, NR_LRU_BASE + l);
 	mem_cgroup_del_lru_list(page, l);
@@ -55,6 +222,10 @@ del_page_from_lru(struct zone *zone, struct page *page)
 {
 	enum lru_list l;
 
+	if (page_lru_gen(page) >= 0) {
+		lru_gen_del_page(zone, page, false);
+		return;
+	}
 	list_del(&page->lru);
 	if (PageUnevictable(page)) {
 		__ClearPageUnevictable(page);
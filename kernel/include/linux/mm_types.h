@@ -177,6 +177,10 @@ struct vm_area_struct {
 	void * vm_private_data;		/* was vm_pte (shared mem) */
 	unsigned long vm_truncate_count;/* truncate_count or restart_addr */
 
+#ifdef CONFIG_SWAP
+	atomic_long_t swap_readahead_info; /* last fault, window and hits */
+#endif
+
 #ifndef CONFIG_MMU
 	struct vm_region *vm_region;	/* NOMMU mapping region */
 #endif
@@ -222,7 +226,7 @@ struct mm_rss_stat {
 struct mm_struct {
 	struct vm_area_struct * mmap;		/* list of VMAs */
 	struct rb_root mm_rb;
-	struct vm_area_struct * mmap_cache;	/* last find_vma result */
+	u32 vmacache_seqnum;			/* per-thread vmacache */
 #ifdef CONFIG_MMU
 	unsigned long (*get_unmapped_area) (struct file *filp,
 				unsigned long addr, unsigned long len,
@@ -307,6 +311,16 @@ struct mm_struct {
 	struct file *exe_file;
 	unsigned long num_exe_file_vmas;
 #endif
+#ifdef CONFIG_PROC_PAGE_MONITOR
+	/*
+	 * PSS from the last page table walk for /proc/memsum, the rss
+	 * counters it was taken at and when (0 if never).  Protected by
+	 * page_table_lock.
+	 */
+	unsigned long memsum_time;
+	unsigned long memsum_rss_stat[NR_MM_COUNTERS];
+	u64 memsum_pss;
+#endif
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
@@ -40,8 +40,21 @@
 #define MIGRATE_MOVABLE       2
 #define MIGRATE_PCPTYPES      3 /* the number of types on the pcp lists */
 #define MIGRATE_RESERVE       3
+#ifdef CONFIG_CMA_MIGRATE
+/*
+ * Pageblocks lent by CMA regions.  Only movable allocations fall back to
+ * them, and they never change type, so cma_alloc() can always migrate
+ * their pages away again.
+ */
+#define MIGRATE_CMA           4
+#define MIGRATE_ISOLATE       5 /* can't allocate from here */
+#define MIGRATE_TYPES         6
+#define is_migrate_cma(migratetype) unlikely((migratetype) == MIGRATE_CMA)
+#else
 #define MIGRATE_ISOLATE       4 /* can't allocate from here */
 #define MIGRATE_TYPES         5
+#define is_migrate_cma(migratetype) false
+#endif
 
 #define for_each_migratetype_order(order, type) \
 	for (order = 0; order < MAX_ORDER; order++) \
@@ -104,6 +117,10 @@ enum zone_stat_item {
 	NR_ISOLATED_ANON,	/* Temporary isolated pages from anon lru */
 	NR_ISOLATED_FILE,	/* Temporary isolated pages from file lru */
 	NR_SHMEM,		/* shmem pages (included tmpfs/GEM pages) */
+	WORKINGSET_REFAULT,	/* evicted file pages read back in */
+	WORKINGSET_ACTIVATE,	/* refaults that were activated */
+	WORKINGSET_SHADOWS,	/* shadow entries of evicted pages */
+	NR_FREE_CMA_PAGES,	/* free pages in lent CMA pageblocks */
 #ifdef CONFIG_NUMA
 	NUMA_HIT,		/* allocated in intended node */
 	NUMA_MISS,		/* allocated in non intended node */
@@ -166,6 +183,20 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * Blocks of order 1 up to PCP_MAX_ORDER are cached per cpu as well, on
+ * lists of their own so that a list only ever holds a single order.
+ */
+#define PCP_MAX_ORDER		PAGE_ALLOC_COSTLY_ORDER
+
+struct per_cpu_pages_order {
+	int count;		/* number of blocks in the lists */
+	int high;		/* high watermark in blocks, 0 disables */
+	int batch;		/* chunk size for buddy add/remove, in blocks */
+
+	struct list_head lists[MIGRATE_PCPTYPES];
+};
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
@@ -173,6 +204,9 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* orders[i] caches blocks of order i + 1 */
+	struct per_cpu_pages_order orders[PCP_MAX_ORDER];
 };
 
 struct per_cpu_pageset {
@@ -277,6 +311,31 @@ struct zone_reclaim_stat {
 	unsigned long		nr_saved_scan[NR_LRU_LISTS];
 };
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * With the multi-generational LRU, evictable pages are not kept on the
+ * active and inactive lists but sorted into generations.  A page is
+ * promoted to the youngest generation when it is found accessed, either
+ * through mark_page_accessed() or because the aging walk found a young
+ * pte mapping it; reclaim evicts from the oldest generation.
+ *
+ * Generations are numbered by an ever increasing sequence number: anon
+ * and file pages share max_seq, the youngest generation, but have their
+ * own min_seq.  The two youngest generations are accounted as active in
+ * the NR_*_ANON and NR_*_FILE statistics, the older ones as inactive.
+ */
+#define MIN_NR_GENS		2
+#define MAX_NR_GENS		4
+
+struct lru_gen_struct {
+	unsigned long		max_seq;
+	unsigned long		min_seq[2];	/* [0] anon, [1] file */
+	struct list_head	lists[MAX_NR_GENS][2];
+	long			nr_pages[MAX_NR_GENS][2];
+	unsigned long		timestamps[MAX_NR_GENS];	/* jiffies */
+};
+#endif
+
 struct zone {
 	/* Fields commonly accessed by the page allocator */
 
@@ -347,6 +406,12 @@ struct zone {
 	} lru[NR_LRU_LISTS];
 
 	struct zone_reclaim_stat reclaim_stat;
+#ifdef CONFIG_LRU_GEN
+	struct lru_gen_struct	lrugen;
+#endif
+
+	/* Evictions and activations on the file LRU, see mm/workingset.c */
+	atomic_long_t		inactive_age;
 
 	unsigned long		pages_scanned;	   /* since last reclaim */
 	unsigned long		flags;		   /* zone flags, see below */
@@ -650,6 +715,11 @@ typedef struct pglist_data {
 	wait_queue_head_t kswapd_wait;
 	struct task_struct *kswapd;
 	int kswapd_max_order;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	int kcompactd_max_order;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
@@ -218,8 +218,22 @@ static inline struct page *page_cache_alloc_cold(struct address_space *x)
 	return __page_cache_alloc(mapping_gfp_mask(x)|__GFP_COLD);
 }
 
+/*
+ * Note the first use of a page cache page, for readahead accounting.
+ */
+static inline void page_cache_ra_used(struct page *page)
+{
+	if (PageRaUnused(page) && TestClearPageRaUnused(page))
+		count_vm_event(READAHEAD_USED);
+}
+
 typedef int filler_t(void *, struct page *);
 
+pgoff_t page_cache_next_hole(struct address_space *mapping,
+			     pgoff_t index, unsigned long max_scan);
+pgoff_t page_cache_prev_hole(struct address_space *mapping,
+			     pgoff_t index, unsigned long max_scan);
+
 extern struct page * find_get_page(struct address_space *mapping,
 				pgoff_t index);
 extern struct page * find_lock_page(struct address_space *mapping,
@@ -434,7 +448,9 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				pgoff_t index, gfp_t gfp_mask);
 extern void remove_from_page_cache(struct page *page);
-extern void __remove_from_page_cache(struct page *page);
+extern void __remove_from_page_cache(struct page *page, void *shadow);
+int page_cache_tree_insert(struct address_space *mapping, pgoff_t index,
+			   struct page *page, void **shadowp);
 
 /*
  * Like add_to_page_cache_locked, but used to add newly allocated pages:
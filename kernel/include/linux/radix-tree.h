@@ -38,6 +38,15 @@
 #define RADIX_TREE_INDIRECT_PTR	1
 #define RADIX_TREE_RETRY ((void *)-1UL)
 
+/*
+ * A bit of the item pointer below the indirect bit is free for users to
+ * store values that are not pointers: the page cache keeps such
+ * "exceptional" entries in the slots of evicted pages.  Test for
+ * RADIX_TREE_RETRY before testing for an exceptional entry.
+ */
+#define RADIX_TREE_EXCEPTIONAL_ENTRY	2
+#define RADIX_TREE_EXCEPTIONAL_SHIFT	2
+
 static inline void *radix_tree_ptr_to_indirect(void *ptr)
 {
 	return (void *)((unsigned long)ptr | RADIX_TREE_INDIRECT_PTR);
@@ -53,6 +62,11 @@ static inline int radix_tree_is_indirect_ptr(void *ptr)
 	return (int)((unsigned long)ptr & RADIX_TREE_INDIRECT_PTR);
 }
 
+static inline int radix_tree_exceptional_entry(void *arg)
+{
+	return (int)((unsigned long)arg & RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
 /*** radix-tree API starts here ***/
 
 #define RADIX_TREE_MAX_TAGS 2
@@ -171,7 +185,8 @@ radix_tree_gang_lookup(struct radix_tree_root *root, void **results,
 			unsigned long first_index, unsigned int max_items);
 unsigned int
 radix_tree_gang_lookup_slot(struct radix_tree_root *root, void ***results,
-			unsigned long first_index, unsigned int max_items);
+			unsigned long *indices, unsigned long first_index,
+			unsigned int max_items);
 unsigned long radix_tree_next_hole(struct radix_tree_root *root,
 				unsigned long index, unsigned long max_scan);
 unsigned long radix_tree_prev_hole(struct radix_tree_root *root,
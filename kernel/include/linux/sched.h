@@ -142,6 +142,42 @@ extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
+/*
+ * Per-cpu scheduler telemetry, for policies (cpu hotplug, cpufreq) that
+ * need more than the load average without looking into the runqueues.
+ */
+#define SCHED_NR_RUNNING_BUCKETS	8
+
+struct sched_cpu_telemetry {
+	/* ticks seen with i tasks runnable, the last bucket counts more */
+	unsigned long	nr_running_hist[SCHED_NR_RUNNING_BUCKETS];
+	unsigned long	migrations_in;
+	unsigned long	migrations_out;
+	unsigned long	idle_balance_count;
+	unsigned long	idle_balance_pulled;
+	/* percentage of recent time spent running RT tasks */
+	unsigned int	rt_occupancy;
+	/* energy aware wakeups packed onto this cpu / left to the balancer */
+	unsigned long	energy_packed;
+	unsigned long	energy_spread;
+};
+
+extern void sched_get_cpu_telemetry(int cpu, struct sched_cpu_telemetry *t);
+
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+/*
+ * Per-cpu description used by energy aware task placement.  Only the
+ * ratios matter: power and wakeup cost must use the same units.
+ */
+struct sched_energy_model {
+	unsigned long	capacity;	/* compute capacity, SCHED_LOAD_SCALE = max */
+	unsigned long	busy_power;	/* power drawn when fully busy */
+	unsigned long	wakeup_cost;	/* energy spent leaving idle */
+};
+
+extern void sched_set_energy_model(int cpu, const struct sched_energy_model *em);
+#endif
+
 
 extern void calc_global_load(void);
 
@@ -723,6 +759,19 @@ struct sched_info {
 };
 #endif /* defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT) */
 
+#ifdef CONFIG_WAKEUP_LATENCY_HIST
+/*
+ * Bucket i counts wakeup-to-run latencies below 2^i microseconds; the
+ * last bucket counts everything above.
+ */
+#define WAKEUP_LAT_HIST_BUCKETS	16
+
+struct wakeup_lat_hist {
+	unsigned long long	stamp;	/* when we were last woken up */
+	unsigned int		count[WAKEUP_LAT_HIST_BUCKETS];
+};
+#endif
+
 #ifdef CONFIG_TASK_DELAY_ACCT
 struct task_delay_info {
 	spinlock_t	lock;
@@ -1134,6 +1183,13 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+	/* share of a cpu used between two wakeups, SCHED_LOAD_SCALE = all */
+	unsigned long		util_avg;
+	u64			util_wake_stamp;
+	u64			util_wake_exec;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
@@ -1165,6 +1221,11 @@ struct sched_rt_entity {
 
 struct rcu_node;
 
+/* Per-thread cache of recent find_vma() results, see mm/vmacache.c */
+#define VMACACHE_BITS 2
+#define VMACACHE_SIZE (1U << VMACACHE_BITS)
+#define VMACACHE_MASK (VMACACHE_SIZE - 1)
+
 struct task_struct {
 	volatile long state;	/* -1 unrunnable, 0 runnable, >0 stopped */
 	void *stack;
@@ -1217,11 +1278,17 @@ struct task_struct {
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 	struct sched_info sched_info;
 #endif
+#ifdef CONFIG_WAKEUP_LATENCY_HIST
+	struct wakeup_lat_hist wakeup_lat;
+#endif
 
 	struct list_head tasks;
 	struct plist_node pushable_tasks;
 
 	struct mm_struct *mm, *active_mm;
+	/* per-thread vma caching */
+	u32 vmacache_seqnum;
+	struct vm_area_struct *vmacache[VMACACHE_SIZE];
 #if defined(SPLIT_RSS_COUNTING)
 	struct task_rss_stat	rss_stat;
 #endif
@@ -1900,6 +1967,15 @@ int sched_rt_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
 		loff_t *ppos);
 
+#ifdef CONFIG_CFS_BANDWIDTH
+extern unsigned int sysctl_sched_cfs_bandwidth_slice;
+#endif
+
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+extern unsigned int sysctl_sched_energy_aware;
+extern unsigned int sysctl_sched_energy_fit_pct;
+#endif
+
 extern unsigned int sysctl_sched_compat_yield;
 
 #ifdef CONFIG_RT_MUTEXES
@@ -2559,8 +2635,6 @@ static inline unsigned long rlimit_max(unsigned int limit)
 	return task_rlimit_max(current, limit);
 }
 
-extern unsigned int d_hotplug_lock;
-extern unsigned int force_hotplug;
 #endif /* __KERNEL__ */
 
 #endif
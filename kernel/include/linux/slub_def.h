@@ -32,12 +32,31 @@ enum stat_item {
 	DEACTIVATE_TO_TAIL,	/* Cpu slab was moved to the tail of partials */
 	DEACTIVATE_REMOTE_FREES,/* Slab contained remotely freed objects */
 	ORDER_FALLBACK,		/* Number of times fallback was necessary */
+	CMPXCHG_CPU_FAIL,	/* Failure of cmpxchg on the cpu freelist */
+	CPU_PARTIAL_ALLOC,	/* Cpu slab acquired from cpu partial list */
+	CPU_PARTIAL_FREE,	/* Freeing moves slab to cpu partial list */
+	CPU_PARTIAL_NODE,	/* Cpu partial list refilled from node list */
+	CPU_PARTIAL_DRAIN,	/* Cpu partial list returned to node list */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+	union {
+		struct {
+			void **freelist;	/* Pointer to first free
+						   per cpu object */
+			unsigned long tid;	/* Bumped on every change
+						   of freelist */
+		};
+		u64 freelist_tid;	/* Both, for cmpxchg64_local() */
+	};
+#else
 	void **freelist;	/* Pointer to first free per cpu object */
+#endif
 	struct page *page;	/* The slab from which we are allocating */
 	int node;		/* The node of the page (or -1 for debug) */
+	int nr_partial;		/* Number of slabs on partial */
+	struct list_head partial;	/* Frozen partial slabs of this cpu */
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
@@ -84,6 +103,7 @@ struct kmem_cache {
 	int inuse;		/* Offset to metadata */
 	int align;		/* Alignment */
 	unsigned long min_partial;
+	int cpu_partial;	/* Max partial slabs kept per cpu */
 	const char *name;	/* Name (only for display!) */
 	struct list_head list;	/* List of slab caches */
 #ifdef CONFIG_SLUB_DEBUG
@@ -144,6 +144,11 @@ struct vcm_mmu;
  *			callback; called under spinlock with IRQs disabled
  *			- cannot sleep; required unless @activate and
  *			@deactivate are both provided.
+ * @flush:	called once after a binding has been activated or
+ *		deactivated with @activate_page or @deactivate_page, so
+ *		that TLB maintenance is done once per binding rather than
+ *		once per page; called under spinlock with IRQs disabled -
+ *		cannot sleep; optional.
  */
 struct vcm_mmu_driver {
 	const unsigned char	*orders;
@@ -155,6 +160,7 @@ struct vcm_mmu_driver {
 			     unsigned order, void *vcm);
 	int (*deactivate_page)(dma_addr_t vaddr, dma_addr_t paddr,
 			       unsigned order, void *vcm);
+	void (*flush)(struct vcm *vcm);
 };
 
 /**
@@ -330,9 +336,12 @@ vcm_phys_alloc(resource_size_t size, unsigned flags,
  * @priv:	private data for the callbacks.
  *
  * This function walks through @phys trying to mach largest possible
- * page size donated by @orders.  For each such page @callback is
- * called.  If @callback returns negative number the function calls
- * @recover for each page @callback was called successfully.
+ * page size donated by @orders.  Parts of @phys which are physically
+ * adjacent are treated as one run so that, for instance, sixteen
+ * adjacent 64KiB parts may be mapped with a single 1MiB page.  For
+ * each such page @callback is called.  If @callback returns negative
+ * number the function calls @recover for each page @callback was
+ * called successfully.
  *
  * So, for instance, if we have a physical memory which consist of
  * 1Mib part and 8KiB part and @orders is { 8, 0 } (which means 1MiB
@@ -22,6 +22,24 @@
 struct vcm_driver;
 struct vcm_phys;
 
+/**
+ * struct vcm_stats - mapping statistics of a VCM context.
+ * @binds:	number of bindings mapped so far.
+ * @pages:	number of PAGE_SIZE pages those bindings consisted of.
+ * @entries:	number of mappings (of any page size the MMU supports)
+ *		used to map those pages; the closer to @binds the
+ *		better.
+ * @map_ns:	total time spent mapping bindings in nanoseconds.
+ * @unmap_ns:	total time spent unmapping bindings in nanoseconds.
+ */
+struct vcm_stats {
+	unsigned long		binds;
+	unsigned long		pages;
+	unsigned long		entries;
+	u64			map_ns;
+	u64			unmap_ns;
+};
+
 /**
  * struct vcm - A virtually contiguous memory context.
  * @start:	the smallest possible address available in this context.
@@ -30,6 +48,7 @@ struct vcm_phys;
  * @activations:	How many times context was activated; internal,
  *			read only for MMU drivers.
  * @driver:	driver handling this driver; internal.
+ * @stats:	mapping statistics; internal, read only for MMU drivers.
  *
  * This structure represents a context of virtually contiguous memory
  * managed by a MMU pointed by the @mmu pointer.  This is the main
@@ -44,6 +63,7 @@ struct vcm {
 	resource_size_t		size;
 	atomic_t		activations;
 	const struct vcm_driver	*driver;
+	struct vcm_stats	stats;
 };
 
 /**
@@ -29,9 +29,12 @@
 #define FOR_ALL_ZONES(xx) DMA_ZONE(xx) DMA32_ZONE(xx) xx##_NORMAL HIGHMEM_ZONE(xx) , xx##_MOVABLE
 
 enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
+		SWAP_RA, SWAP_RA_HIT, SWAP_VMA_RA, SWAP_VMA_RA_HIT,
 		FOR_ALL_ZONES(PGALLOC),
 		PGFREE, PGACTIVATE, PGDEACTIVATE,
-		PGFAULT, PGMAJFAULT,
+		PGFAULT, PGMAJFAULT, FAULT_AROUND, FAULT_AROUND_MAPPED,
+		VMACACHE_FIND_CALLS, VMACACHE_FIND_HITS,
+		READAHEAD_PAGES, READAHEAD_USED, READAHEAD_WASTED,
 		FOR_ALL_ZONES(PGREFILL),
 		FOR_ALL_ZONES(PGSTEAL),
 		FOR_ALL_ZONES(PGSCAN_KSWAPD),
@@ -43,9 +46,16 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
 		KSWAPD_SKIP_CONGESTION_WAIT,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
+		VMAP_PURGE, VMAP_PURGE_PAGES, VMAP_FLUSH_RANGE, VMAP_FLUSH_ALL,
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		COMPACTDEFERRED, COMPACTSKIPFRAG, COMPACTSKIPWMARK,
+		COMPACTSKIPWRITEBACK, COMPACTSKIPLOCKED, COMPACTSKIPISOLATED,
+		KCOMPACTDWAKE,
+#endif
+#ifdef CONFIG_LRU_GEN
+		LRU_GEN_AGING, LRU_GEN_YOUNG,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -0,0 +1,91 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cma
+
+#if !defined(_TRACE_CMA_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CMA_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+#include <linux/cma.h>
+
+/*
+ * These record every allocation and free per region, in the order the
+ * allocator saw them, so that tools/cma/cma-replay can play the same
+ * sequence against other allocators.
+ */
+
+DECLARE_EVENT_CLASS(cma_chunk,
+
+	TP_PROTO(struct cma_region *reg, dma_addr_t start, size_t size,
+		 dma_addr_t alignment),
+
+	TP_ARGS(reg, start, size, alignment),
+
+	TP_STRUCT__entry(
+		__string(	region,		reg->name ?: "(private)")
+		__field(	unsigned long long,	start		)
+		__field(	unsigned long,		size		)
+		__field(	unsigned long long,	alignment	)
+	),
+
+	TP_fast_assign(
+		__assign_str(region, reg->name ?: "(private)");
+		__entry->start		= start;
+		__entry->size		= size;
+		__entry->alignment	= alignment;
+	),
+
+	TP_printk("region=%s start=%#llx size=%lu align=%#llx",
+		__get_str(region), __entry->start, __entry->size,
+		__entry->alignment)
+);
+
+/**
+ * cma_alloc - a chunk was allocated from a region
+ * @reg:	the region
+ * @start:	bus address of the chunk
+ * @size:	size of the chunk, page aligned
+ * @alignment:	alignment that was asked for, at least a page
+ */
+DEFINE_EVENT(cma_chunk, cma_alloc,
+
+	TP_PROTO(struct cma_region *reg, dma_addr_t start, size_t size,
+		 dma_addr_t alignment),
+
+	TP_ARGS(reg, start, size, alignment)
+);
+
+/**
+ * cma_alloc_failed - the allocator of a region found no room for a chunk
+ * @reg:	the region
+ * @start:	always zero
+ * @size:	size asked for, page aligned
+ * @alignment:	alignment asked for, at least a page
+ */
+DEFINE_EVENT(cma_chunk, cma_alloc_failed,
+
+	TP_PROTO(struct cma_region *reg, dma_addr_t start, size_t size,
+		 dma_addr_t alignment),
+
+	TP_ARGS(reg, start, size, alignment)
+);
+
+/**
+ * cma_free - a chunk was given back to its region
+ * @reg:	the region
+ * @start:	bus address of the chunk
+ * @size:	size of the chunk
+ * @alignment:	always zero
+ */
+DEFINE_EVENT(cma_chunk, cma_free,
+
+	TP_PROTO(struct cma_region *reg, dma_addr_t start, size_t size,
+		 dma_addr_t alignment),
+
+	TP_ARGS(reg, start, size, alignment)
+);
+
+#endif /* _TRACE_CMA_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,48 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM filemap
+
+#if !defined(_TRACE_FILEMAP_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_FILEMAP_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+#include <linux/fs.h>
+
+/**
+ * mm_filemap_access - pages of a file are read or faulted in
+ * @file:	the file being accessed
+ * @index:	first page accessed
+ * @nr:		number of pages accessed
+ *
+ * Emitted for every read() of a regular file and for every page fault on
+ * a file mapping, whether the pages were cached or not.
+ */
+TRACE_EVENT(mm_filemap_access,
+
+	TP_PROTO(struct file *file, pgoff_t index, unsigned long nr),
+
+	TP_ARGS(file, index, nr),
+
+	TP_STRUCT__entry(
+		__field(	dev_t,		dev		)
+		__field(	unsigned long,	ino		)
+		__field(	pgoff_t,	index		)
+		__field(	unsigned long,	nr		)
+	),
+
+	TP_fast_assign(
+		__entry->dev	= file->f_mapping->host->i_sb->s_dev;
+		__entry->ino	= file->f_mapping->host->i_ino;
+		__entry->index	= index;
+		__entry->nr	= nr;
+	),
+
+	TP_printk("dev %d:%d ino %lx index %lu nr %lu",
+		MAJOR(__entry->dev), MINOR(__entry->dev),
+		__entry->ino, __entry->index, __entry->nr)
+);
+
+#endif /* _TRACE_FILEMAP_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -65,6 +65,7 @@
 #include <linux/perf_event.h>
 #include <linux/posix-timers.h>
 #include <linux/user-return-notifier.h>
+#include <linux/vmacache.h>
 
 #include <asm/pgtable.h>
 #include <asm/pgalloc.h>
@@ -332,7 +333,7 @@ static int dup_mmap(struct mm_struct *mm, struct mm_struct *oldmm)
 
 	mm->locked_vm = 0;
 	mm->mmap = NULL;
-	mm->mmap_cache = NULL;
+	mm->vmacache_seqnum = 0;
 	mm->free_area_cache = oldmm->mmap_base;
 	mm->cached_hole_size = ~0UL;
 	mm->map_count = 0;
@@ -500,6 +501,9 @@ static struct mm_struct * mm_init(struct mm_struct * mm, struct task_struct *p)
 	mm->core_state = NULL;
 	mm->nr_ptes = 0;
 	memset(&mm->rss_stat, 0, sizeof(mm->rss_stat));
+#ifdef CONFIG_PROC_PAGE_MONITOR
+	mm->memsum_time = 0;
+#endif
 	spin_lock_init(&mm->page_table_lock);
 	mm->free_area_cache = TASK_UNMAPPED_BASE;
 	mm->cached_hole_size = ~0UL;
@@ -733,6 +737,8 @@ static int copy_mm(unsigned long clone_flags, struct task_struct * tsk)
 
 	tsk->mm = NULL;
 	tsk->active_mm = NULL;
+	/* initialize the new vmacache entries */
+	vmacache_flush(tsk);
 
 	/*
 	 * Are we cloning a kernel thread?
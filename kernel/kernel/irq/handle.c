@@ -20,6 +20,7 @@
 #include <linux/rculist.h>
 #include <linux/hash.h>
 #include <linux/radix-tree.h>
+#include <linux/cpuidle.h>
 #include <trace/events/irq.h>
 
 #include <mach/sec_debug.h>
@@ -372,6 +373,8 @@ irqreturn_t handle_IRQ_event(unsigned int irq, struct irqaction *action)
 	irqreturn_t ret, retval = IRQ_NONE;
 	unsigned int status = 0;
 
+	cpuidle_note_irq(irq);
+
 	do {
 		sec_debug_irq_sched_log(irq, (void *)action->handler, 1);
 		trace_irq_handler_entry(irq, action);
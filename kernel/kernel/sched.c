@@ -231,6 +231,102 @@ static void destroy_rt_bandwidth(struct rt_bandwidth *rt_b)
 }
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+struct cfs_bandwidth {
+	/* nests inside the rq lock: */
+	raw_spinlock_t		lock;
+	ktime_t			period;
+	u64			quota;
+	/* runtime left in the global pool for this period */
+	u64			runtime;
+	struct hrtimer		period_timer;
+	int			timer_active;
+	int			idle;
+
+	/* statistics */
+	int			nr_periods;
+	int			nr_throttled;
+	u64			throttled_time;
+};
+
+/*
+ * Amount of runtime (in us) a cfs_rq pulls from its group's pool at once.
+ * Smaller slices track the quota more exactly, larger ones take the pool
+ * lock less often.
+ */
+unsigned int sysctl_sched_cfs_bandwidth_slice = 5000UL;
+
+static inline u64 default_cfs_period(void)
+{
+	return 100000000ULL;
+}
+
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun);
+
+static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
+{
+	struct cfs_bandwidth *cfs_b =
+		container_of(timer, struct cfs_bandwidth, period_timer);
+	ktime_t now;
+	int overrun;
+	int idle = 0;
+
+	for (;;) {
+		now = hrtimer_cb_get_time(timer);
+		overrun = hrtimer_forward(timer, now, cfs_b->period);
+
+		if (!overrun)
+			break;
+
+		idle = do_sched_cfs_period_timer(cfs_b, overrun);
+	}
+
+	/*
+	 * Nobody asked for runtime during the last period: stop the timer,
+	 * the next request for runtime restarts it.
+	 */
+	raw_spin_lock(&cfs_b->lock);
+	if (idle && cfs_b->idle)
+		cfs_b->timer_active = 0;
+	else
+		idle = 0;
+	raw_spin_unlock(&cfs_b->lock);
+
+	return idle ? HRTIMER_NORESTART : HRTIMER_RESTART;
+}
+
+static void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	raw_spin_lock_init(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(default_cfs_period());
+	cfs_b->quota = RUNTIME_INF;
+	cfs_b->runtime = 0;
+
+	hrtimer_init(&cfs_b->period_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cfs_b->period_timer.function = sched_cfs_period_timer;
+}
+
+/*
+ * Must be called with cfs_b->lock held. A stopped timer means no period
+ * is running, so a fresh one starts with a full pool.
+ */
+static void start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	if (cfs_b->timer_active)
+		return;
+
+	cfs_b->timer_active = 1;
+	cfs_b->runtime = cfs_b->quota;
+	__hrtimer_start_range_ns(&cfs_b->period_timer, cfs_b->period, 0,
+			HRTIMER_MODE_REL, 0);
+}
+
+static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	hrtimer_cancel(&cfs_b->period_timer);
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 /*
  * sched_domains_mutex serializes calls to arch_init_sched_domains,
  * detach_destroy_domains and partition_sched_domains.
@@ -255,6 +351,9 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+#ifdef CONFIG_CFS_BANDWIDTH
+	struct cfs_bandwidth cfs_bandwidth;
+#endif
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -314,7 +413,7 @@ struct task_group init_task_group;
 /* CFS-related fields in a runqueue */
 struct cfs_rq {
 	struct load_weight load;
-	unsigned long nr_running;
+	unsigned long nr_running, h_nr_running;
 
 	u64 exec_clock;
 	u64 min_vruntime;
@@ -371,6 +470,18 @@ struct cfs_rq {
 	 */
 	unsigned long rq_weight;
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	/*
+	 * Runtime left from the last slice taken from tg->cfs_bandwidth.
+	 * Once it is used up and the pool is empty, the cfs_rq is throttled:
+	 * its entity is taken off the parent until the next period.
+	 */
+	int runtime_enabled;
+	s64 runtime_remaining;
+
+	int throttled;
+	u64 throttled_timestamp;
+#endif
 #endif
 };
 
@@ -498,6 +609,8 @@ struct rq {
 
 	atomic_t nr_iowait;
 
+	struct sched_cpu_telemetry telemetry;
+
 #ifdef CONFIG_SMP
 	struct root_domain *rd;
 	struct sched_domain *sd;
@@ -522,6 +635,12 @@ struct rq {
 	u64 avg_idle;
 #endif
 
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+	/* decaying average of busy ticks, SCHED_LOAD_SCALE = always busy */
+	unsigned long util;
+	unsigned long util_stamp;
+#endif
+
 	/* calc_load related fields */
 	unsigned long calc_load_update;
 	long calc_load_active;
@@ -1843,6 +1962,7 @@ static const struct sched_class rt_sched_class;
    for (class = sched_class_highest; class; class = class->next)
 
 #include "sched_stats.h"
+#include "sched_telemetry.h"
 
 static void inc_nr_running(struct rq *rq)
 {
@@ -1894,7 +2014,6 @@ static void activate_task(struct rq *rq, struct task_struct *p, int flags)
 		rq->nr_uninterruptible--;
 
 	enqueue_task(rq, p, flags);
-	inc_nr_running(rq);
 }
 
 /*
@@ -1906,7 +2025,6 @@ static void deactivate_task(struct rq *rq, struct task_struct *p, int flags)
 		rq->nr_uninterruptible++;
 
 	dequeue_task(rq, p, flags);
-	dec_nr_running(rq);
 }
 
 #include "sched_idletask.c"
@@ -2028,6 +2146,7 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 
 	if (task_cpu(p) != new_cpu) {
 		p->se.nr_migrations++;
+		sched_telemetry_migrate(task_cpu(p), new_cpu);
 		perf_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS, 1, 1, NULL, 0);
 	}
 
@@ -2443,9 +2562,18 @@ static void __sched_fork(struct task_struct *p)
 	p->se.prev_sum_exec_runtime	= 0;
 	p->se.nr_migrations		= 0;
 
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+	/* assume a new task is big until it has shown otherwise */
+	p->se.util_avg			= SCHED_LOAD_SCALE;
+	p->se.util_wake_stamp		= 0;
+	p->se.util_wake_exec		= 0;
+#endif
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
+#ifdef CONFIG_WAKEUP_LATENCY_HIST
+	memset(&p->wakeup_lat, 0, sizeof(p->wakeup_lat));
+#endif
 
 	INIT_LIST_HEAD(&p->rt.run_list);
 	p->se.on_rq = 0;
@@ -3523,6 +3651,8 @@ void scheduler_tick(void)
 	raw_spin_lock(&rq->lock);
 	update_rq_clock(rq);
 	update_cpu_load_active(rq);
+	sched_telemetry_tick(rq);
+	update_rq_util(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
 	raw_spin_unlock(&rq->lock);
 
@@ -3658,7 +3788,7 @@ pick_next_task(struct rq *rq)
 	 * Optimization: we know that if all tasks are in
 	 * the fair class we can call that function directly:
 	 */
-	if (likely(rq->nr_running == rq->cfs.nr_running)) {
+	if (likely(rq->nr_running == rq->cfs.h_nr_running)) {
 		p = fair_sched_class.pick_next_task(rq);
 		if (likely(p))
 			return p;
@@ -7688,6 +7818,10 @@ void __init sched_init(void)
 			global_rt_period(), global_rt_runtime());
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	init_cfs_bandwidth(&init_task_group.cfs_bandwidth);
+#endif
+
 #ifdef CONFIG_CGROUP_SCHED
 	list_add(&init_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&init_task_group.children);
@@ -7985,6 +8119,10 @@ static void free_fair_sched_group(struct task_group *tg)
 {
 	int i;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	destroy_cfs_bandwidth(&tg->cfs_bandwidth);
+#endif
+
 	for_each_possible_cpu(i) {
 		if (tg->cfs_rq)
 			kfree(tg->cfs_rq[i]);
@@ -8004,6 +8142,10 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 	struct rq *rq;
 	int i;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	init_cfs_bandwidth(&tg->cfs_bandwidth);
+#endif
+
 	tg->cfs_rq = kzalloc(sizeof(cfs_rq) * nr_cpu_ids, GFP_KERNEL);
 	if (!tg->cfs_rq)
 		goto err;
@@ -8738,6 +8880,110 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) tg->shares;
 }
+
+#ifdef CONFIG_CFS_BANDWIDTH
+static DEFINE_MUTEX(cfs_constraints_mutex);
+
+/* a period shorter than 1ms makes the timer overhead dominate */
+static const u64 min_cfs_quota_period = 1 * NSEC_PER_MSEC;
+static const u64 max_cfs_quota_period = 1 * NSEC_PER_SEC;
+
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+{
+	struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
+	int i;
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	if (quota < min_cfs_quota_period || period < min_cfs_quota_period)
+		return -EINVAL;
+
+	if (period > max_cfs_quota_period)
+		return -EINVAL;
+
+	mutex_lock(&cfs_constraints_mutex);
+	raw_spin_lock_irq(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(period);
+	cfs_b->quota = quota;
+	cfs_b->runtime = quota;
+	raw_spin_unlock_irq(&cfs_b->lock);
+
+	for_each_possible_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = rq_of(cfs_rq);
+
+		raw_spin_lock_irq(&rq->lock);
+		cfs_rq->runtime_enabled = quota != RUNTIME_INF;
+		cfs_rq->runtime_remaining = 0;
+		if (cfs_rq_throttled(cfs_rq))
+			unthrottle_cfs_rq(cfs_rq);
+		raw_spin_unlock_irq(&rq->lock);
+	}
+	mutex_unlock(&cfs_constraints_mutex);
+
+	return 0;
+}
+
+static int cpu_cfs_quota_write_s64(struct cgroup *cgrp, struct cftype *cftype,
+				   s64 cfs_quota_us)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	u64 quota, period;
+
+	period = ktime_to_ns(tg->cfs_bandwidth.period);
+	if (cfs_quota_us < 0)
+		quota = RUNTIME_INF;
+	else
+		quota = (u64)cfs_quota_us * NSEC_PER_USEC;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static s64 cpu_cfs_quota_read_s64(struct cgroup *cgrp, struct cftype *cft)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	u64 quota_us;
+
+	if (tg->cfs_bandwidth.quota == RUNTIME_INF)
+		return -1;
+
+	quota_us = tg->cfs_bandwidth.quota;
+	do_div(quota_us, NSEC_PER_USEC);
+	return quota_us;
+}
+
+static int cpu_cfs_period_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				    u64 cfs_period_us)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	return tg_set_cfs_bandwidth(tg, cfs_period_us * NSEC_PER_USEC,
+				    tg->cfs_bandwidth.quota);
+}
+
+static u64 cpu_cfs_period_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	u64 period_us;
+
+	period_us = ktime_to_ns(tg->cfs_bandwidth.period);
+	do_div(period_us, NSEC_PER_USEC);
+	return period_us;
+}
+
+static int cpu_stats_show(struct cgroup *cgrp, struct cftype *cft,
+			  struct cgroup_map_cb *cb)
+{
+	struct cfs_bandwidth *cfs_b = &cgroup_tg(cgrp)->cfs_bandwidth;
+
+	cb->fill(cb, "nr_periods", cfs_b->nr_periods);
+	cb->fill(cb, "nr_throttled", cfs_b->nr_throttled);
+	cb->fill(cb, "throttled_time", cfs_b->throttled_time);
+
+	return 0;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -8772,6 +9018,22 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_shares_write_u64,
 	},
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	{
+		.name = "cfs_quota_us",
+		.read_s64 = cpu_cfs_quota_read_s64,
+		.write_s64 = cpu_cfs_quota_write_s64,
+	},
+	{
+		.name = "cfs_period_us",
+		.read_u64 = cpu_cfs_period_read_u64,
+		.write_u64 = cpu_cfs_period_write_u64,
+	},
+	{
+		.name = "stat",
+		.read_map = cpu_stats_show,
+	},
+#endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
 		.name = "rt_runtime_us",
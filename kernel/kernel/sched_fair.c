@@ -516,6 +516,97 @@ __update_curr(struct cfs_rq *cfs_rq, struct sched_entity *curr,
 	update_min_vruntime(cfs_rq);
 }
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static inline u64 sched_cfs_bandwidth_slice(void)
+{
+	return (u64)sysctl_sched_cfs_bandwidth_slice * NSEC_PER_USEC;
+}
+
+static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
+{
+	return &tg->cfs_bandwidth;
+}
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return cfs_rq->throttled;
+}
+
+/* is cfs_rq, or any cfs_rq above it, throttled? */
+static int throttled_hierarchy(struct cfs_rq *cfs_rq)
+{
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq_of(cfs_rq))];
+
+	if (cfs_rq_throttled(cfs_rq))
+		return 1;
+
+	for_each_sched_entity(se) {
+		if (cfs_rq_throttled(cfs_rq_of(se)))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Top up cfs_rq->runtime_remaining to one slice from the group's pool,
+ * or with whatever is left in it.
+ */
+static void assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	u64 amount = 0, min_amount;
+
+	min_amount = sched_cfs_bandwidth_slice() - cfs_rq->runtime_remaining;
+
+	raw_spin_lock(&cfs_b->lock);
+	if (cfs_b->quota == RUNTIME_INF)
+		amount = min_amount;
+	else {
+		start_cfs_bandwidth(cfs_b);
+		cfs_b->idle = 0;
+
+		amount = min(cfs_b->runtime, min_amount);
+		cfs_b->runtime -= amount;
+	}
+	raw_spin_unlock(&cfs_b->lock);
+
+	cfs_rq->runtime_remaining += amount;
+}
+
+static void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+				   unsigned long delta_exec)
+{
+	if (!cfs_rq->runtime_enabled)
+		return;
+
+	cfs_rq->runtime_remaining -= delta_exec;
+	if (likely(cfs_rq->runtime_remaining > 0))
+		return;
+
+	/*
+	 * Out of local runtime: refill from the pool, or reschedule so
+	 * that put_prev_entity() throttles us.
+	 */
+	assign_cfs_rq_runtime(cfs_rq);
+	if (cfs_rq->runtime_remaining <= 0 && cfs_rq->curr)
+		resched_task(rq_of(cfs_rq)->curr);
+}
+#else
+static inline void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+					  unsigned long delta_exec) {}
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline int throttled_hierarchy(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 static void update_curr(struct cfs_rq *cfs_rq)
 {
 	struct sched_entity *curr = cfs_rq->curr;
@@ -536,6 +627,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 
 	__update_curr(cfs_rq, curr, delta_exec);
 	curr->exec_start = now;
+	account_cfs_rq_runtime(cfs_rq, delta_exec);
 
 	if (entity_is_task(curr)) {
 		struct task_struct *curtask = task_of(curr);
@@ -929,6 +1021,152 @@ static struct sched_entity *pick_next_entity(struct cfs_rq *cfs_rq)
 	return se;
 }
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq)];
+	unsigned long task_delta = cfs_rq->h_nr_running;
+	int dequeue = 1;
+
+	/*
+	 * Take our entity off the parent, and every ancestor that is left
+	 * empty by that, just as dequeue_task_fair() does for a task.  Our
+	 * tasks no longer count as runnable anywhere above us, nor on the
+	 * rq, unless an ancestor was throttled already.
+	 */
+	for_each_sched_entity(se) {
+		struct cfs_rq *qcfs_rq = cfs_rq_of(se);
+
+		if (!se->on_rq)
+			break;
+
+		if (dequeue)
+			dequeue_entity(qcfs_rq, se, DEQUEUE_SLEEP);
+		qcfs_rq->h_nr_running -= task_delta;
+
+		if (qcfs_rq->load.weight)
+			dequeue = 0;
+	}
+
+	if (!se)
+		rq->nr_running -= task_delta;
+
+	cfs_rq->throttled = 1;
+	cfs_rq->throttled_timestamp = rq->clock;
+
+	raw_spin_lock(&cfs_b->lock);
+	cfs_b->nr_throttled++;
+	raw_spin_unlock(&cfs_b->lock);
+}
+
+static void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq)];
+	unsigned long task_delta;
+	int enqueue = 1;
+
+	update_rq_clock(rq);
+
+	cfs_rq->throttled = 0;
+	raw_spin_lock(&cfs_b->lock);
+	cfs_b->throttled_time += rq->clock - cfs_rq->throttled_timestamp;
+	raw_spin_unlock(&cfs_b->lock);
+
+	if (!cfs_rq->load.weight)
+		return;
+
+	task_delta = cfs_rq->h_nr_running;
+	for_each_sched_entity(se) {
+		if (se->on_rq)
+			enqueue = 0;
+
+		cfs_rq = cfs_rq_of(se);
+		if (enqueue)
+			enqueue_entity(cfs_rq, se, ENQUEUE_WAKEUP);
+		cfs_rq->h_nr_running += task_delta;
+
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	if (!se)
+		rq->nr_running += task_delta;
+
+	/* an idle cpu needs a kick to notice the returning entities */
+	if (rq->curr == rq->idle && rq->cfs.nr_running)
+		resched_task(rq->curr);
+}
+
+/*
+ * Throttle a cfs_rq that ran out of runtime once its current entity has
+ * been put back, so that nothing of it is running.
+ */
+static void check_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	if (!cfs_rq->runtime_enabled || cfs_rq->runtime_remaining > 0)
+		return;
+
+	if (cfs_rq_throttled(cfs_rq))
+		return;
+
+	/* the pool may have been refilled since we asked */
+	assign_cfs_rq_runtime(cfs_rq);
+	if (cfs_rq->runtime_remaining > 0)
+		return;
+
+	throttle_cfs_rq(cfs_rq);
+}
+
+/*
+ * Refill the pool of a group at the start of each period and hand it out
+ * to the throttled cfs_rqs. Returns 1 when the group did not ask for
+ * runtime during the last period and none of its cfs_rqs is throttled.
+ */
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
+{
+	struct task_group *tg =
+		container_of(cfs_b, struct task_group, cfs_bandwidth);
+	int i, idle, throttled = 0;
+
+	raw_spin_lock(&cfs_b->lock);
+	if (cfs_b->quota == RUNTIME_INF) {
+		/* The limit was lifted: let the timer stop */
+		cfs_b->idle = 1;
+		raw_spin_unlock(&cfs_b->lock);
+		return 1;
+	}
+
+	cfs_b->nr_periods += overrun;
+	cfs_b->runtime = cfs_b->quota;
+	idle = cfs_b->idle;
+	cfs_b->idle = 1;
+	raw_spin_unlock(&cfs_b->lock);
+
+	for_each_online_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = rq_of(cfs_rq);
+
+		raw_spin_lock(&rq->lock);
+		if (cfs_rq_throttled(cfs_rq)) {
+			assign_cfs_rq_runtime(cfs_rq);
+			if (cfs_rq->runtime_remaining > 0)
+				unthrottle_cfs_rq(cfs_rq);
+			else
+				throttled = 1;
+		}
+		raw_spin_unlock(&rq->lock);
+	}
+
+	return idle && !throttled;
+}
+#else
+static inline void check_cfs_rq_runtime(struct cfs_rq *cfs_rq) {}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 {
 	/*
@@ -938,6 +1176,9 @@ static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 	if (prev->on_rq)
 		update_curr(cfs_rq);
 
+	/* throttle cfs_rqs exceeding runtime */
+	check_cfs_rq_runtime(cfs_rq);
+
 	check_spread(cfs_rq, prev);
 	if (prev->on_rq) {
 		update_stats_wait_start(cfs_rq, prev);
@@ -1036,6 +1277,117 @@ static inline void hrtick_update(struct rq *rq)
 }
 #endif
 
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+/*
+ * Energy aware placement of small tasks:
+ *
+ * Pack waking tasks onto an already busy cpu when their utilization
+ * fits into its spare capacity, instead of waking an idle one.
+ * (default: on, fit: 80% of the cpu capacity)
+ */
+unsigned int sysctl_sched_energy_aware = 1;
+unsigned int sysctl_sched_energy_fit_pct = 80;
+
+static DEFINE_PER_CPU(struct sched_energy_model, sched_energy_model) = {
+	.capacity	= SCHED_LOAD_SCALE,
+	.busy_power	= SCHED_LOAD_SCALE,
+	.wakeup_cost	= SCHED_LOAD_SCALE / 8,
+};
+
+/**
+ * sched_set_energy_model - describe the capacity and power of a cpu
+ * @cpu: the cpu to describe
+ * @em: its capacity, busy power and idle exit cost
+ *
+ * Meant to be called by platform code at boot; all cpus are assumed
+ * identical otherwise.
+ */
+void sched_set_energy_model(int cpu, const struct sched_energy_model *em)
+{
+	per_cpu(sched_energy_model, cpu) = *em;
+}
+EXPORT_SYMBOL_GPL(sched_set_energy_model);
+
+/*
+ * The busy average decays by 1/8 per tick.  A tickless idle cpu does not
+ * update it, so account the ticks it slept through when we next look.
+ */
+static unsigned long decay_rq_util(unsigned long util, unsigned long ticks)
+{
+	if (ticks >= 64)
+		return 0;
+
+	while (ticks-- && util)
+		util -= (util + 7) >> 3;
+
+	return util;
+}
+
+static void update_rq_util(struct rq *rq)
+{
+	unsigned long now = jiffies;
+
+	/*
+	 * Nothing reads it while the placement is off; once it is back on,
+	 * the stale stamp decays what is left of the old average.
+	 */
+	if (!sysctl_sched_energy_aware)
+		return;
+
+	if (now - rq->util_stamp > 1)
+		rq->util = decay_rq_util(rq->util, now - rq->util_stamp - 1);
+	rq->util_stamp = now;
+
+	rq->util -= rq->util >> 3;
+	if (rq->curr != rq->idle)
+		rq->util += SCHED_LOAD_SCALE >> 3;
+}
+
+static unsigned long cpu_util(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long util = ACCESS_ONCE(rq->util);
+	unsigned long stamp = ACCESS_ONCE(rq->util_stamp);
+
+	if (jiffies - stamp > 1)
+		util = decay_rq_util(util, jiffies - stamp - 1);
+
+	return util;
+}
+
+/*
+ * Called when p wakes up: fold the share of cpu time it used since its
+ * last wakeup into its running average.
+ */
+static void update_task_util(struct rq *rq, struct task_struct *p)
+{
+	struct sched_entity *se = &p->se;
+	u64 now = rq->clock;
+	u64 period, run;
+
+	if (se->util_wake_stamp && now > se->util_wake_stamp) {
+		period = now - se->util_wake_stamp;
+		run = se->sum_exec_runtime - se->util_wake_exec;
+		if (run > period)
+			run = period;
+
+		run = div64_u64(run * SCHED_LOAD_SCALE, period);
+		se->util_avg = (3 * se->util_avg + run) >> 2;
+	}
+
+	se->util_wake_stamp = now;
+	se->util_wake_exec = se->sum_exec_runtime;
+}
+#else /* !CONFIG_SCHED_ENERGY_AWARE */
+static inline void update_rq_util(struct rq *rq)
+{
+}
+
+static inline void update_task_util(struct rq *rq, struct task_struct *p)
+{
+}
+#endif /* CONFIG_SCHED_ENERGY_AWARE */
+
 /*
  * The enqueue_task method is called before nr_running is
  * increased. Here we update the fair scheduling stats and
@@ -1047,14 +1399,36 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+	if (flags & ENQUEUE_WAKEUP)
+		update_task_util(rq, p);
+
 	for_each_sched_entity(se) {
 		if (se->on_rq)
 			break;
 		cfs_rq = cfs_rq_of(se);
 		enqueue_entity(cfs_rq, se, flags);
+		/*
+		 * a throttled cfs_rq is off the tree until unthrottled, its
+		 * h_nr_running is raised in the loop below
+		 */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+		cfs_rq->h_nr_running++;
 		flags = ENQUEUE_WAKEUP;
 	}
 
+	/* count the task in the ancestors up to a throttled one */
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		cfs_rq->h_nr_running++;
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	/* tasks below a throttled cfs_rq do not count as runnable */
+	if (!se)
+		inc_nr_running(rq);
+
 	hrtick_update(rq);
 }
 
@@ -1071,12 +1445,28 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
+		/* taken off by throttling, see enqueue_task_fair() */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+		cfs_rq->h_nr_running--;
 		/* Don't dequeue parent if it has other entities besides us */
-		if (cfs_rq->load.weight)
+		if (cfs_rq->load.weight) {
+			se = parent_entity(se);
 			break;
+		}
 		flags |= DEQUEUE_SLEEP;
 	}
 
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		cfs_rq->h_nr_running--;
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	if (!se)
+		dec_nr_running(rq);
+
 	hrtick_update(rq);
 }
 
@@ -1433,6 +1823,56 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	return target;
 }
 
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+/*
+ * Find the cpu where running p costs the least energy, considering only
+ * cpus that have room for it.  Waking an idle cpu costs its wakeup
+ * energy on top of the run cost, so a busy cpu that fits wins over an
+ * idle one of the same kind.  Returns -1 when p does not fit anywhere,
+ * and the regular throughput placement should decide.
+ */
+static int select_energy_cpu(struct task_struct *p, int cpu, int prev_cpu)
+{
+	unsigned long task_util = p->se.util_avg;
+	unsigned long best_energy = ULONG_MAX;
+	int best_cpu = -1;
+	int i;
+
+	for_each_cpu_and(i, &p->cpus_allowed, cpu_active_mask) {
+		struct sched_energy_model *em = &per_cpu(sched_energy_model, i);
+		unsigned long util = cpu_util(i);
+		unsigned long energy;
+
+		/* p's own contribution is still in its previous cpu */
+		if (i == prev_cpu)
+			util -= min(util, task_util);
+
+		if ((util + task_util) * 100 >
+		    em->capacity * sysctl_sched_energy_fit_pct)
+			continue;
+
+		energy = task_util * em->busy_power / em->capacity;
+		/* the waking cpu is awake already, whatever it runs */
+		if (i != cpu && idle_cpu(i))
+			energy += em->wakeup_cost;
+
+		/* on a tie stay cache hot */
+		if (energy < best_energy ||
+		    (energy == best_energy && i == prev_cpu)) {
+			best_energy = energy;
+			best_cpu = i;
+		}
+	}
+
+	if (best_cpu >= 0)
+		cpu_rq(best_cpu)->telemetry.energy_packed++;
+	else
+		cpu_rq(cpu)->telemetry.energy_spread++;
+
+	return best_cpu;
+}
+#endif /* CONFIG_SCHED_ENERGY_AWARE */
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -1461,6 +1901,15 @@ select_task_rq_fair(struct rq *rq, struct task_struct *p, int sd_flag, int wake_
 		new_cpu = prev_cpu;
 	}
 
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+	if ((sd_flag & SD_BALANCE_WAKE) && sysctl_sched_energy_aware) {
+		int energy_cpu = select_energy_cpu(p, cpu, prev_cpu);
+
+		if (energy_cpu >= 0)
+			return energy_cpu;
+	}
+#endif
+
 	for_each_domain(cpu, tmp) {
 		if (!(tmp->flags & SD_LOAD_BALANCE))
 			continue;
@@ -1664,6 +2113,10 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	if (unlikely(se == pse))
 		return;
 
+	/* p will not run before its group is unthrottled */
+	if (unlikely(throttled_hierarchy(cfs_rq_of(pse))))
+		return;
+
 	if (sched_feat(NEXT_BUDDY) && scale && !(wake_flags & WF_FORK))
 		set_next_buddy(pse);
 
@@ -1941,6 +2394,10 @@ load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 		if (!busiest_cfs_rq->task_weight)
 			continue;
 
+		/* its tasks cannot run here or there before the next period */
+		if (throttled_hierarchy(busiest_cfs_rq))
+			continue;
+
 		rem_load = (u64)rem_load_move * busiest_weight;
 		rem_load = div_u64(rem_load, busiest_h_load + 1);
 
@@ -3025,6 +3482,7 @@ static void idle_balance(int this_cpu, struct rq *this_rq)
 	}
 
 	raw_spin_lock(&this_rq->lock);
+	sched_telemetry_idle_balance(this_rq, pulled_task);
 
 	if (pulled_task || time_after(jiffies, this_rq->next_balance)) {
 		/*
@@ -0,0 +1,106 @@
+/*
+ * kernel/sched_telemetry.h
+ *
+ * Cheap per-cpu scheduler counters for cpu hotplug and cpufreq policies.
+ *
+ * The counters are plain per-runqueue integers updated from paths that
+ * already own the runqueue: the tick, set_task_cpu() and idle_balance().
+ * Migration counts on the destination cpu are updated without its lock
+ * and may occasionally lose an increment; they are statistics, not state.
+ */
+
+static inline void sched_telemetry_tick(struct rq *rq)
+{
+	unsigned long nr = rq->nr_running;
+
+	if (nr >= SCHED_NR_RUNNING_BUCKETS)
+		nr = SCHED_NR_RUNNING_BUCKETS - 1;
+	rq->telemetry.nr_running_hist[nr]++;
+}
+
+static inline void sched_telemetry_migrate(int old_cpu, int new_cpu)
+{
+	cpu_rq(old_cpu)->telemetry.migrations_out++;
+	cpu_rq(new_cpu)->telemetry.migrations_in++;
+}
+
+static inline void sched_telemetry_idle_balance(struct rq *rq, int pulled)
+{
+	rq->telemetry.idle_balance_count++;
+	if (pulled)
+		rq->telemetry.idle_balance_pulled++;
+}
+
+/**
+ * sched_get_cpu_telemetry - snapshot the scheduler telemetry of a cpu
+ * @cpu: the cpu to query
+ * @t: where to store the snapshot
+ *
+ * The snapshot is taken without the runqueue lock, so the fields are not
+ * guaranteed to be mutually consistent.
+ */
+void sched_get_cpu_telemetry(int cpu, struct sched_cpu_telemetry *t)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	*t = rq->telemetry;
+	t->rt_occupancy = 0;
+
+#ifdef CONFIG_SMP
+	{
+		u64 total = sched_avg_period() + (rq->clock - rq->age_stamp);
+		u64 rt_avg = min(ACCESS_ONCE(rq->rt_avg), total);
+
+		if (total)
+			t->rt_occupancy = div64_u64(rt_avg * 100, total);
+	}
+#endif
+}
+EXPORT_SYMBOL_GPL(sched_get_cpu_telemetry);
+
+#ifdef CONFIG_DEBUG_FS
+static int sched_telemetry_show(struct seq_file *m, void *v)
+{
+	struct sched_cpu_telemetry t;
+	int cpu, i;
+
+	for_each_online_cpu(cpu) {
+		sched_get_cpu_telemetry(cpu, &t);
+
+		seq_printf(m, "cpu%d nr_running", cpu);
+		for (i = 0; i < SCHED_NR_RUNNING_BUCKETS; i++)
+			seq_printf(m, " %lu", t.nr_running_hist[i]);
+		seq_printf(m, "\n");
+		seq_printf(m, "cpu%d migrations_in %lu migrations_out %lu\n",
+			   cpu, t.migrations_in, t.migrations_out);
+		seq_printf(m, "cpu%d idle_balance %lu pulled %lu\n",
+			   cpu, t.idle_balance_count, t.idle_balance_pulled);
+		seq_printf(m, "cpu%d rt_occupancy %u\n", cpu, t.rt_occupancy);
+		seq_printf(m, "cpu%d energy_packed %lu energy_spread %lu\n",
+			   cpu, t.energy_packed, t.energy_spread);
+	}
+
+	return 0;
+}
+
+static int sched_telemetry_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_telemetry_show, NULL);
+}
+
+static const struct file_operations sched_telemetry_fops = {
+	.open		= sched_telemetry_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static __init int sched_init_telemetry(void)
+{
+	debugfs_create_file("sched_telemetry", 0444, NULL, NULL,
+			&sched_telemetry_fops);
+
+	return 0;
+}
+late_initcall(sched_init_telemetry);
+#endif
@@ -0,0 +1,327 @@
+/*
+ * Per-task wakeup latency histograms
+ *
+ * Unlike the wakeup tracer, which only remembers the worst latency of
+ * the highest priority task, this keeps a small log2 histogram of the
+ * wakeup-to-run latency of every task, plus a system wide one per cpu.
+ * It hooks the sched_wakeup and sched_switch tracepoints only, so it can
+ * be left enabled on production builds.
+ *
+ * The per-task counters are only written by the cpu that switches the
+ * task in, with its runqueue lock held, so they need no locking of
+ * their own.
+ */
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
+#include <linux/uaccess.h>
+#include <linux/percpu.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+
+#include <trace/events/sched.h>
+
+static DEFINE_PER_CPU(unsigned long[WAKEUP_LAT_HIST_BUCKETS], wakeup_lat_global);
+static DEFINE_MUTEX(wakeup_hist_mutex);
+static int wakeup_hist_enabled;
+static int wakeup_hist_boot_enabled __initdata;
+
+static void
+probe_wakeup_hist_wakeup(void *ignore, struct task_struct *p, int success)
+{
+	if (!success)
+		return;
+
+	/* p is already placed on the cpu it is going to run on */
+	p->wakeup_lat.stamp = cpu_clock(task_cpu(p));
+}
+
+static void
+probe_wakeup_hist_switch(void *ignore, struct task_struct *prev,
+			 struct task_struct *next)
+{
+	struct wakeup_lat_hist *hist = &next->wakeup_lat;
+	int cpu = smp_processor_id();
+	unsigned long long delta;
+	int bucket;
+
+	/*
+	 * Keep the stamp of a task preempted right after its wakeup: it
+	 * has not run yet.  Tasks switched in without a wakeup (preempted
+	 * tasks being resumed) carry no stamp.
+	 */
+	if (!hist->stamp)
+		return;
+
+	delta = cpu_clock(cpu);
+	/* the task may have been migrated since, cpu clocks can drift */
+	if ((long long)(delta - hist->stamp) < 0)
+		delta = 0;
+	else
+		delta = (delta - hist->stamp) >> 10;	/* ~usecs */
+	hist->stamp = 0;
+
+	bucket = fls64(delta);
+	if (bucket >= WAKEUP_LAT_HIST_BUCKETS)
+		bucket = WAKEUP_LAT_HIST_BUCKETS - 1;
+
+	hist->count[bucket]++;
+	per_cpu(wakeup_lat_global, cpu)[bucket]++;
+}
+
+static int wakeup_hist_register(void)
+{
+	int ret;
+
+	ret = register_trace_sched_wakeup(probe_wakeup_hist_wakeup, NULL);
+	if (ret) {
+		pr_info("wakeup latency hist: Couldn't activate tracepoint"
+			" probe to kernel_sched_wakeup\n");
+		return ret;
+	}
+
+	ret = register_trace_sched_wakeup_new(probe_wakeup_hist_wakeup, NULL);
+	if (ret) {
+		pr_info("wakeup latency hist: Couldn't activate tracepoint"
+			" probe to kernel_sched_wakeup_new\n");
+		goto fail_deprobe;
+	}
+
+	ret = register_trace_sched_switch(probe_wakeup_hist_switch, NULL);
+	if (ret) {
+		pr_info("wakeup latency hist: Couldn't activate tracepoint"
+			" probe to kernel_sched_switch\n");
+		goto fail_deprobe_wake_new;
+	}
+
+	return 0;
+
+fail_deprobe_wake_new:
+	unregister_trace_sched_wakeup_new(probe_wakeup_hist_wakeup, NULL);
+fail_deprobe:
+	unregister_trace_sched_wakeup(probe_wakeup_hist_wakeup, NULL);
+	return ret;
+}
+
+static void wakeup_hist_unregister(void)
+{
+	unregister_trace_sched_switch(probe_wakeup_hist_switch, NULL);
+	unregister_trace_sched_wakeup_new(probe_wakeup_hist_wakeup, NULL);
+	unregister_trace_sched_wakeup(probe_wakeup_hist_wakeup, NULL);
+}
+
+static int wakeup_hist_set_enabled(int enable)
+{
+	int ret = 0;
+
+	mutex_lock(&wakeup_hist_mutex);
+	if (enable == wakeup_hist_enabled)
+		goto out;
+
+	if (enable) {
+		struct task_struct *g, *p;
+
+		/* forget stamps left over from a previous session */
+		read_lock(&tasklist_lock);
+		do_each_thread(g, p) {
+			p->wakeup_lat.stamp = 0;
+		} while_each_thread(g, p);
+		read_unlock(&tasklist_lock);
+
+		ret = wakeup_hist_register();
+	} else {
+		wakeup_hist_unregister();
+		/* make sure no probe is still running before we report off */
+		tracepoint_synchronize_unregister();
+	}
+	if (!ret)
+		wakeup_hist_enabled = enable;
+out:
+	mutex_unlock(&wakeup_hist_mutex);
+
+	return ret;
+}
+
+static void wakeup_hist_reset(void)
+{
+	struct task_struct *g, *p;
+	int cpu;
+
+	/* racy against running probes, which only costs a few samples */
+	read_lock(&tasklist_lock);
+	do_each_thread(g, p) {
+		memset(p->wakeup_lat.count, 0, sizeof(p->wakeup_lat.count));
+	} while_each_thread(g, p);
+	read_unlock(&tasklist_lock);
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(wakeup_lat_global, cpu), 0,
+		       sizeof(per_cpu(wakeup_lat_global, cpu)));
+}
+
+static void wakeup_hist_print_header(struct seq_file *m, const char *first)
+{
+	int i;
+
+	seq_printf(m, "%s", first);
+	for (i = 0; i < WAKEUP_LAT_HIST_BUCKETS - 1; i++)
+		seq_printf(m, " <%uus", 1U << i);
+	seq_printf(m, " >=%uus\n", 1U << (WAKEUP_LAT_HIST_BUCKETS - 2));
+}
+
+static int wakeup_hist_tasks_show(struct seq_file *m, void *v)
+{
+	struct task_struct *g, *p;
+	unsigned int total;
+	int i;
+
+	wakeup_hist_print_header(m, "pid comm");
+
+	read_lock(&tasklist_lock);
+	do_each_thread(g, p) {
+		total = 0;
+		for (i = 0; i < WAKEUP_LAT_HIST_BUCKETS; i++)
+			total += p->wakeup_lat.count[i];
+		if (!total)
+			continue;
+
+		seq_printf(m, "%d %s", p->pid, p->comm);
+		for (i = 0; i < WAKEUP_LAT_HIST_BUCKETS; i++)
+			seq_printf(m, " %u", p->wakeup_lat.count[i]);
+		seq_printf(m, "\n");
+	} while_each_thread(g, p);
+	read_unlock(&tasklist_lock);
+
+	return 0;
+}
+
+static int wakeup_hist_global_show(struct seq_file *m, void *v)
+{
+	int cpu, i;
+
+	wakeup_hist_print_header(m, "cpu");
+
+	for_each_online_cpu(cpu) {
+		seq_printf(m, "cpu%d", cpu);
+		for (i = 0; i < WAKEUP_LAT_HIST_BUCKETS; i++)
+			seq_printf(m, " %lu", per_cpu(wakeup_lat_global, cpu)[i]);
+		seq_printf(m, "\n");
+	}
+
+	return 0;
+}
+
+static int wakeup_hist_tasks_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, wakeup_hist_tasks_show, NULL);
+}
+
+static int wakeup_hist_global_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, wakeup_hist_global_show, NULL);
+}
+
+static const struct file_operations wakeup_hist_tasks_fops = {
+	.open		= wakeup_hist_tasks_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations wakeup_hist_global_fops = {
+	.open		= wakeup_hist_global_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static ssize_t
+wakeup_hist_enable_read(struct file *filp, char __user *ubuf,
+			size_t cnt, loff_t *ppos)
+{
+	char buf[4];
+	int r;
+
+	r = snprintf(buf, sizeof(buf), "%d\n", wakeup_hist_enabled);
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static ssize_t
+wakeup_hist_enable_write(struct file *filp, const char __user *ubuf,
+			 size_t cnt, loff_t *ppos)
+{
+	unsigned long val;
+	char buf[8];
+	int ret;
+
+	if (cnt >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, cnt))
+		return -EFAULT;
+
+	buf[cnt] = 0;
+
+	ret = strict_strtoul(buf, 10, &val);
+	if (ret < 0)
+		return ret;
+
+	ret = wakeup_hist_set_enabled(!!val);
+	if (ret)
+		return ret;
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static const struct file_operations wakeup_hist_enable_fops = {
+	.read		= wakeup_hist_enable_read,
+	.write		= wakeup_hist_enable_write,
+};
+
+static ssize_t
+wakeup_hist_reset_write(struct file *filp, const char __user *ubuf,
+			size_t cnt, loff_t *ppos)
+{
+	wakeup_hist_reset();
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static const struct file_operations wakeup_hist_reset_fops = {
+	.write		= wakeup_hist_reset_write,
+};
+
+static int __init wakeup_hist_boot_setup(char *str)
+{
+	wakeup_hist_boot_enabled = 1;
+	return 1;
+}
+__setup("wakeup_latency_hist", wakeup_hist_boot_setup);
+
+static __init int wakeup_hist_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_dir("wakeup_latency", NULL);
+	if (!d) {
+		pr_warning("Could not create debugfs directory "
+			   "'wakeup_latency'\n");
+		return 0;
+	}
+
+	debugfs_create_file("enable", 0644, d, NULL, &wakeup_hist_enable_fops);
+	debugfs_create_file("reset", 0200, d, NULL, &wakeup_hist_reset_fops);
+	debugfs_create_file("tasks", 0444, d, NULL, &wakeup_hist_tasks_fops);
+	debugfs_create_file("global", 0444, d, NULL, &wakeup_hist_global_fops);
+
+	if (wakeup_hist_boot_enabled)
+		wakeup_hist_set_enabled(1);
+
+	return 0;
+}
+late_initcall(wakeup_hist_init);
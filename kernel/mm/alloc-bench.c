@@ -0,0 +1,207 @@
+/*
+ * mm/alloc-bench.c
+ *
+ * Allocator microbenchmark: times allocating and freeing blocks of each
+ * order the per-cpu lists cache, and kmalloc objects of a range of
+ * sizes, on one cpu and then on all online cpus at once, and prints the
+ * results when the module is loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+
+#define MAX_BATCH	256
+
+static unsigned int loops = 100000;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Blocks allocated and freed per cpu and test");
+
+static unsigned int batch = 16;
+module_param(batch, uint, 0444);
+MODULE_PARM_DESC(batch, "Blocks held at once before they are freed");
+
+static bool test_pages = true;
+module_param_named(pages, test_pages, bool, 0444);
+MODULE_PARM_DESC(pages, "Run the page allocator tests");
+
+static bool test_kmalloc = true;
+module_param_named(kmalloc, test_kmalloc, bool, 0444);
+MODULE_PARM_DESC(kmalloc, "Run the kmalloc tests");
+
+static const unsigned int kmalloc_sizes[] = { 8, 32, 128, 512, 2048 };
+
+struct bench_thread {
+	struct task_struct *task;
+	unsigned int arg;	/* order or size */
+	u64 ns;
+	unsigned long failed;
+};
+
+static struct bench_thread *threads;
+static DECLARE_COMPLETION(bench_start);
+static DECLARE_COMPLETION(bench_done);
+static atomic_t bench_running;
+
+
+static int bench_pages(void *data)
+{
+	struct bench_thread *t = data;
+	struct page *pages[MAX_BATCH];
+	unsigned int i, n;
+	ktime_t start;
+
+	wait_for_completion(&bench_start);
+
+	start = ktime_get();
+	for (n = 0; n < loops; n += batch) {
+		for (i = 0; i < batch; i++) {
+			pages[i] = alloc_pages(GFP_KERNEL | __GFP_NOWARN,
+					       t->arg);
+			if (!pages[i])
+				t->failed++;
+		}
+		for (i = 0; i < batch; i++)
+			if (pages[i])
+				__free_pages(pages[i], t->arg);
+		cond_resched();
+	}
+	t->ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (atomic_dec_and_test(&bench_running))
+		complete(&bench_done);
+	return 0;
+}
+
+static int bench_kmalloc(void *data)
+{
+	struct bench_thread *t = data;
+	void *objs[MAX_BATCH];
+	unsigned int i, n;
+	ktime_t start;
+
+	wait_for_completion(&bench_start);
+
+	start = ktime_get();
+	for (n = 0; n < loops; n += batch) {
+		for (i = 0; i < batch; i++) {
+			objs[i] = kmalloc(t->arg, GFP_KERNEL);
+			if (!objs[i])
+				t->failed++;
+		}
+		for (i = 0; i < batch; i++)
+			kfree(objs[i]);
+		cond_resched();
+	}
+	t->ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (atomic_dec_and_test(&bench_running))
+		complete(&bench_done);
+	return 0;
+}
+
+/*
+ * Run fn on nr_cpus of the online cpus at the same time and print the
+ * average cost of an allocation and free and the overall throughput.
+ */
+static void run_bench(const char *what, int (*fn)(void *),
+		      unsigned int arg, int nr_cpus)
+{
+	u64 ns = 0;
+	unsigned long failed = 0;
+	int cpu, nr = 0;
+
+	INIT_COMPLETION(bench_start);
+	INIT_COMPLETION(bench_done);
+	atomic_set(&bench_running, 1);
+
+	for_each_online_cpu(cpu) {
+		struct bench_thread *t = &threads[cpu];
+
+		if (nr == nr_cpus)
+			break;
+		memset(t, 0, sizeof(*t));
+		t->arg = arg;
+		t->task = kthread_create(fn, t, "alloc_bench/%d", cpu);
+		if (IS_ERR(t->task)) {
+			t->task = NULL;
+			continue;
+		}
+		kthread_bind(t->task, cpu);
+		atomic_inc(&bench_running);
+		wake_up_process(t->task);
+		nr++;
+	}
+
+	complete_all(&bench_start);
+	if (!atomic_dec_and_test(&bench_running))
+		wait_for_completion(&bench_done);
+
+	for_each_online_cpu(cpu) {
+		struct bench_thread *t = &threads[cpu];
+
+		if (!t->task)
+			continue;
+		ns += t->ns;
+		failed += t->failed;
+		t->task = NULL;
+	}
+	if (!nr || !ns)
+		return;
+
+	printk(KERN_INFO "alloc-bench: %s %u, %d cpus: %llu ns per alloc+free, "
+	       "%llu k/s, %lu failed\n", what, arg, nr,
+	       div_u64(ns, (u64)nr * loops),
+	       div_u64((u64)nr * nr * loops * NSEC_PER_MSEC, ns), failed);
+}
+
+static void __init run_benches(const char *what, int (*fn)(void *),
+			       unsigned int arg)
+{
+	run_bench(what, fn, arg, 1);
+	if (num_online_cpus() > 1)
+		run_bench(what, fn, arg, num_online_cpus());
+}
+
+static int __init alloc_bench_init(void)
+{
+	unsigned int order, i;
+
+	if (!loops || !batch || batch > MAX_BATCH)
+		return -EINVAL;
+	loops = roundup(loops, batch);
+
+	threads = kcalloc(nr_cpu_ids, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	get_online_cpus();
+	for (order = 0; test_pages && order <= PCP_MAX_ORDER; order++)
+		run_benches("order", bench_pages, order);
+	for (i = 0; test_kmalloc && i < ARRAY_SIZE(kmalloc_sizes); i++)
+		run_benches("kmalloc", bench_kmalloc, kmalloc_sizes[i]);
+	put_online_cpus();
+
+	kfree(threads);
+	return 0;
+}
+module_init(alloc_bench_init);
+
+static void __exit alloc_bench_exit(void)
+{
+}
+module_exit(alloc_bench_exit);
+
+MODULE_LICENSE("GPL");
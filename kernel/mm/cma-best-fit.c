@@ -20,6 +20,8 @@
 
 #include <linux/cma.h>         /* CMA structures */
 
+#include "cma-best-fit.h"
+
 
 /************************* Data Types *************************/
 
@@ -28,11 +30,6 @@ struct cma_bf_item {
 	struct rb_node by_size;
 };
 
-struct cma_bf_private {
-	struct rb_root by_start_root;
-	struct rb_root by_size_root;
-};
-
 
 /************************* Prototypes *************************/
 
@@ -50,17 +47,18 @@ static void __cma_bf_hole_erase_by_start(struct cma_bf_item *item);
 /**
  * __cma_bf_hole_take - takes a chunk of memory out of a hole.
  * @hole:	hole to take chunk from
+ * @start:	chunk's starting address, aligned to @alignment
  * @size:	chunk's size
  * @alignment:	chunk's starting address alignment (must be power of two)
  *
- * Takes a @size bytes large chunk from hole @hole which must be able
- * to hold the chunk.  The "must be able" includes also alignment
- * constraint.
+ * Takes a @size bytes large chunk starting at @start from hole @hole
+ * which must be able to hold the chunk.
  *
  * Returns allocated item or NULL on error (if kmalloc() failed).
  */
 static struct cma_bf_item *__must_check
-__cma_bf_hole_take(struct cma_bf_item *hole, size_t size, dma_addr_t alignment);
+__cma_bf_hole_take(struct cma_bf_item *hole, dma_addr_t start, size_t size,
+		   dma_addr_t alignment);
 
 /**
  * __cma_bf_hole_merge_maybe - tries to merge hole with neighbours.
@@ -73,20 +71,13 @@ static void __cma_bf_hole_merge_maybe(struct cma_bf_item *item);
 
 /************************* Device API *************************/
 
-int cma_bf_init(struct cma_region *reg)
+int __cma_bf_init(struct cma_region *reg, struct cma_bf_private *prv)
 {
-	struct cma_bf_private *prv;
 	struct cma_bf_item *item;
 
-	prv = kzalloc(sizeof *prv, GFP_KERNEL);
-	if (unlikely(!prv))
-		return -ENOMEM;
-
 	item = kzalloc(sizeof *item, GFP_KERNEL);
-	if (unlikely(!item)) {
-		kfree(prv);
+	if (unlikely(!item))
 		return -ENOMEM;
-	}
 
 	item->ch.start = reg->start;
 	item->ch.size  = reg->size;
@@ -99,7 +90,7 @@ int cma_bf_init(struct cma_region *reg)
 	return 0;
 }
 
-void cma_bf_cleanup(struct cma_region *reg)
+void __cma_bf_cleanup(struct cma_region *reg)
 {
 	struct cma_bf_private *prv = reg->private_data;
 	struct cma_bf_item *item =
@@ -111,6 +102,28 @@ void cma_bf_cleanup(struct cma_region *reg)
 		item->ch.by_start.rb_left || item->ch.by_start.rb_right);
 
 	kfree(item);
+}
+
+int cma_bf_init(struct cma_region *reg)
+{
+	struct cma_bf_private *prv;
+	int ret;
+
+	prv = kzalloc(sizeof *prv, GFP_KERNEL);
+	if (unlikely(!prv))
+		return -ENOMEM;
+
+	ret = __cma_bf_init(reg, prv);
+	if (unlikely(ret))
+		kfree(prv);
+	return ret;
+}
+
+void cma_bf_cleanup(struct cma_region *reg)
+{
+	struct cma_bf_private *prv = reg->private_data;
+
+	__cma_bf_cleanup(reg);
 	kfree(prv);
 }
 
@@ -141,11 +154,12 @@ struct cma_chunk *cma_bf_alloc(struct cma_region *reg,
 		dma_addr_t start = ALIGN(item->ch.start, alignment);
 		dma_addr_t end   = item->ch.start + item->ch.size;
 		if (start < end && end - start >= size) {
-			item = __cma_bf_hole_take(item, size, alignment);
+			item = __cma_bf_hole_take(item, start, size,
+						  alignment);
 			return likely(item) ? &item->ch : NULL;
 		}
 
-		node = rb_next(node);
+		node = rb_next(&item->by_size);
 		if (!node)
 			return NULL;
 
@@ -153,6 +167,34 @@ struct cma_chunk *cma_bf_alloc(struct cma_region *reg,
 	}
 }
 
+/*
+ * Like cma_bf_alloc() but takes the chunk from the end of the highest
+ * hole that can hold it rather than from the smallest one.
+ */
+struct cma_chunk *cma_bf_alloc_top(struct cma_region *reg,
+				   size_t size, dma_addr_t alignment)
+{
+	struct cma_bf_private *prv = reg->private_data;
+	struct rb_node *node;
+
+	for (node = rb_last(&prv->by_start_root); node; node = rb_prev(node)) {
+		struct cma_bf_item *item =
+			rb_entry(node, struct cma_bf_item, ch.by_start);
+		dma_addr_t start;
+
+		if (item->ch.size < size)
+			continue;
+		start = (item->ch.start + item->ch.size - size) &
+			~(alignment - 1);
+		if (start < item->ch.start)
+			continue;
+
+		item = __cma_bf_hole_take(item, start, size, alignment);
+		return likely(item) ? &item->ch : NULL;
+	}
+	return NULL;
+}
+
 void cma_bf_free(struct cma_chunk *chunk)
 {
 	struct cma_bf_item *item = container_of(chunk, struct cma_bf_item, ch);
@@ -243,7 +285,8 @@ static void __cma_bf_hole_erase_by_start(struct cma_bf_item *item)
 /************************* More Tree Manipulation *************************/
 
 static struct cma_bf_item *__must_check
-__cma_bf_hole_take(struct cma_bf_item *hole, size_t size, size_t alignment)
+__cma_bf_hole_take(struct cma_bf_item *hole, dma_addr_t start, size_t size,
+		   dma_addr_t alignment)
 {
 	struct cma_bf_item *item;
 
@@ -268,7 +311,7 @@ __cma_bf_hole_take(struct cma_bf_item *hole, size_t size, size_t alignment)
 	if (unlikely(!item))
 		return NULL;
 
-	item->ch.start = ALIGN(hole->ch.start, alignment);
+	item->ch.start = start;
 	item->ch.size  = size;
 
 	/* Case 3, in the middle */
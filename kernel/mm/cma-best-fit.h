@@ -0,0 +1,44 @@
+/*
+ * Contiguous Memory Allocator framework: Best Fit allocator internals
+ *
+ * Allocators built on top of the best-fit allocator embed struct
+ * cma_bf_private at the beginning of their own private data, so that
+ * reg->private_data can be used by both.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License or (at your optional) any later version of the license.
+ */
+
+#ifndef __MM_CMA_BEST_FIT_H
+#define __MM_CMA_BEST_FIT_H
+
+#include <linux/rbtree.h>
+#include <linux/types.h>
+
+struct cma_region;
+struct cma_chunk;
+
+struct cma_bf_private {
+	struct rb_root by_start_root;
+	struct rb_root by_size_root;
+};
+
+/*
+ * __cma_bf_init() sets up @prv to manage the whole of @reg and stores
+ * it in reg->private_data; __cma_bf_cleanup() undoes it, except for
+ * freeing @prv itself.
+ */
+int __cma_bf_init(struct cma_region *reg, struct cma_bf_private *prv);
+void __cma_bf_cleanup(struct cma_region *reg);
+
+int cma_bf_init(struct cma_region *reg);
+void cma_bf_cleanup(struct cma_region *reg);
+struct cma_chunk *cma_bf_alloc(struct cma_region *reg,
+			       size_t size, dma_addr_t alignment);
+struct cma_chunk *cma_bf_alloc_top(struct cma_region *reg,
+				   size_t size, dma_addr_t alignment);
+void cma_bf_free(struct cma_chunk *chunk);
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Contiguous Memory Allocator framework: Size Class allocator
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License or (at your optional) any later version of the license.
+ */
+
+/*
+ * Devices sharing a region tend to allocate buffers of a handful of
+ * sizes over and over again: camera preview frames of one size,
+ * decoder buffers of another.  With the best-fit allocator alone those
+ * end up interleaved with each other and with odd sized allocations,
+ * and a freed buffer is soon cut up by a smaller one.
+ *
+ * This allocator remembers the sizes of chunks being freed as size
+ * classes.  Chunks of a known class are packed from the top of the
+ * region downwards, everything else is allocated best-fit from the
+ * bottom, so a freed buffer tends to leave a hole next to buffers of
+ * its own size, which the next buffer of that size fits exactly.
+ *
+ * Keeping freed chunks in per-class pools for reuse was tried as well,
+ * but pinning those holes made fragmentation worse than not pooling at
+ * all on synthetic camera and video decoder sequences.
+ */
+
+#define pr_fmt(fmt) "cma: sc: " fmt
+
+#ifdef CONFIG_CMA_DEBUG
+#  define DEBUG
+#endif
+
+#include <linux/errno.h>       /* Error numbers */
+#include <linux/slab.h>        /* kmalloc() */
+
+#include <linux/cma.h>         /* CMA structures */
+
+#include "cma-best-fit.h"
+
+
+/************************* Data Types *************************/
+
+/* Number of different sizes remembered per region. */
+#define CMA_SC_CLASSES	8
+
+struct cma_sc_class {
+	size_t size;
+	unsigned long last_used;
+};
+
+struct cma_sc_private {
+	struct cma_bf_private bf;	/* must be first */
+	struct cma_sc_class classes[CMA_SC_CLASSES];
+	unsigned nr_classes;
+	unsigned long clock;
+};
+
+
+/************************* Size Classes *************************/
+
+static struct cma_sc_class *__cma_sc_class_find(struct cma_sc_private *prv,
+						size_t size)
+{
+	unsigned i;
+
+	for (i = 0; i < prv->nr_classes; ++i)
+		if (prv->classes[i].size == size) {
+			prv->classes[i].last_used = ++prv->clock;
+			return prv->classes + i;
+		}
+	return NULL;
+}
+
+/* Adds a class, replacing the least recently used one if all are taken. */
+static void __cma_sc_class_add(struct cma_sc_private *prv, size_t size)
+{
+	struct cma_sc_class *cls = prv->classes;
+	unsigned i;
+
+	if (prv->nr_classes < CMA_SC_CLASSES) {
+		cls += prv->nr_classes++;
+	} else {
+		for (i = 1; i < CMA_SC_CLASSES; ++i)
+			if (prv->classes[i].last_used < cls->last_used)
+				cls = prv->classes + i;
+	}
+
+	pr_debug("new size class %p\n", (void *)size);
+	cls->size = size;
+	cls->last_used = ++prv->clock;
+}
+
+
+/************************* Device API *************************/
+
+static int cma_sc_init(struct cma_region *reg)
+{
+	struct cma_sc_private *prv;
+	int ret;
+
+	prv = kzalloc(sizeof *prv, GFP_KERNEL);
+	if (unlikely(!prv))
+		return -ENOMEM;
+
+	ret = __cma_bf_init(reg, &prv->bf);
+	if (unlikely(ret))
+		kfree(prv);
+	return ret;
+}
+
+static void cma_sc_cleanup(struct cma_region *reg)
+{
+	struct cma_sc_private *prv = reg->private_data;
+
+	__cma_bf_cleanup(reg);
+	kfree(prv);
+}
+
+static struct cma_chunk *cma_sc_alloc(struct cma_region *reg,
+				      size_t size, dma_addr_t alignment)
+{
+	struct cma_sc_private *prv = reg->private_data;
+
+	if (__cma_sc_class_find(prv, size))
+		return cma_bf_alloc_top(reg, size, alignment);
+	return cma_bf_alloc(reg, size, alignment);
+}
+
+static void cma_sc_free(struct cma_chunk *chunk)
+{
+	struct cma_sc_private *prv = chunk->reg->private_data;
+
+	if (!__cma_sc_class_find(prv, chunk->size))
+		__cma_sc_class_add(prv, chunk->size);
+	cma_bf_free(chunk);
+}
+
+
+/************************* Register *************************/
+static int cma_sc_module_init(void)
+{
+	static struct cma_allocator alloc = {
+		.name    = "sc",
+		.init    = cma_sc_init,
+		.cleanup = cma_sc_cleanup,
+		.alloc   = cma_sc_alloc,
+		.free    = cma_sc_free,
+	};
+	return cma_allocator_register(&alloc);
+}
+module_init(cma_sc_module_init);
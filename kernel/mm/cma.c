@@ -25,18 +25,25 @@
 #ifdef CONFIG_HAVE_MEMBLOCK
 #  include <linux/memblock.h>  /* memblock*() */
 #endif
+#include <linux/debugfs.h>     /* debugfs_create_file() */
 #include <linux/device.h>      /* struct device, dev_name() */
 #include <linux/errno.h>       /* Error numbers */
 #include <linux/err.h>         /* IS_ERR, PTR_ERR, etc. */
+#include <linux/hrtimer.h>     /* ktime_get() */
 #include <linux/mm.h>          /* PAGE_ALIGN() */
 #include <linux/module.h>      /* EXPORT_SYMBOL_GPL() */
 #include <linux/mutex.h>       /* mutex */
+#include <linux/seq_file.h>    /* seq_printf() */
 #include <linux/slab.h>        /* kmalloc() */
 #include <linux/string.h>      /* str*() */
+#include <linux/uaccess.h>     /* copy_from_user() */
 
 #include <linux/cma.h>
 #include <linux/vmalloc.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/cma.h>
+
 /*
  * Protects cma_regions, cma_allocators, cma_map, cma_map_length,
  * cma_kobj, cma_sysfs_regions and cma_chunks_by_start.
@@ -269,6 +276,7 @@ int __init __must_check cma_early_region_register(struct cma_region *reg)
 /************************* Regions & Allocators *************************/
 
 static void __cma_sysfs_region_add(struct cma_region *reg);
+static void __cma_region_lend(struct cma_region *reg);
 
 static int __cma_region_attach_alloc(struct cma_region *reg);
 static void __maybe_unused __cma_region_detach_alloc(struct cma_region *reg);
@@ -425,9 +433,9 @@ int cma_allocator_register(struct cma_allocator *alloc)
 	cma_foreach_region(reg) {
 		if (reg->alloc)
 			continue;
-		if (reg->alloc_name
+		if (!(reg->alloc_name
 		  ? alloc->name && !strcmp(alloc->name, reg->alloc_name)
-		  : (!reg->used && first))
+		  : (!reg->used && first)))
 			continue;
 
 		reg->alloc = alloc;
@@ -595,8 +603,11 @@ static int __init cma_init(void)
 		 * cma_early_region_register() it's caller's
 		 * responsibility to do something about it.
 		 */
-		if (reg->reserved && cma_region_register(reg) < 0)
-			/* ignore error */;
+		if (!reg->reserved || cma_region_register(reg) < 0)
+			/* ignore error */
+			continue;
+		if (reg->lend)
+			__cma_region_lend(reg);
 	}
 
 	INIT_LIST_HEAD(&cma_early_regions);
@@ -936,6 +947,170 @@ static void __cma_sysfs_region_add(struct cma_region *reg)
 #endif
 
 
+/************************* Lending *************************/
+
+#if defined CONFIG_CMA_MIGRATE
+
+/*
+ * Lent memory has to be aligned so that free pages of other migrate
+ * types never merge with it; the unaligned ends of a region stay
+ * reserved.
+ */
+#define CMA_LEND_ALIGN	max_t(unsigned long, MAX_ORDER_NR_PAGES, \
+			      pageblock_nr_pages)
+
+#define CMA_RECLAIM_TRIES	3
+
+static void __init __cma_region_lend(struct cma_region *reg)
+{
+	unsigned long start = ALIGN(PFN_UP(reg->start), CMA_LEND_ALIGN);
+	unsigned long end = PFN_DOWN(reg->start + reg->size) &
+				~(CMA_LEND_ALIGN - 1);
+	unsigned long pfn;
+	struct zone *zone;
+
+	if (start >= end) {
+		pr_info("%s: too small to lend\n", reg->name ?: "(private)");
+		return;
+	}
+
+	zone = page_zone(pfn_to_page(start));
+	for (pfn = start; pfn < end; pfn += pageblock_nr_pages)
+		if (!pfn_valid(pfn) || page_zone(pfn_to_page(pfn)) != zone) {
+			pr_warn("%s: spans zones, not lent\n",
+				reg->name ?: "(private)");
+			return;
+		}
+
+	for (pfn = start; pfn < end; pfn += pageblock_nr_pages)
+		init_cma_reserved_pageblock(pfn_to_page(pfn));
+
+	reg->lent_start = start;
+	reg->lent_end = end;
+	pr_info("%s: lent %lu KiB to the page allocator\n",
+		reg->name ?: "(private)", (end - start) << (PAGE_SHIFT - 10));
+}
+
+/* Find the part of a chunk that lies in lent memory. */
+static bool __cma_chunk_lent(struct cma_chunk *chunk,
+			     unsigned long *start, unsigned long *end)
+{
+	struct cma_region *reg = chunk->reg;
+
+	*start = max_t(unsigned long, PFN_DOWN(chunk->start), reg->lent_start);
+	*end = min_t(unsigned long, PFN_UP(chunk->start + chunk->size),
+		     reg->lent_end);
+	return *start < *end;
+}
+
+/*
+ * Take the lent memory under a new chunk back from the page allocator,
+ * migrating the pages that use it.  This is what makes allocations from
+ * lending regions slower, so the time it takes is accounted.
+ */
+static int __cma_chunk_reclaim(struct cma_chunk *chunk)
+{
+	struct cma_region *reg = chunk->reg;
+	unsigned long start, end, us;
+	int tries = CMA_RECLAIM_TRIES;
+	ktime_t t;
+	int ret;
+
+	if (!__cma_chunk_lent(chunk, &start, &end))
+		return 0;
+
+	t = ktime_get();
+	do {
+		ret = alloc_contig_range(start, end, MIGRATE_CMA);
+	} while (ret < 0 && --tries);
+	us = ktime_to_us(ktime_sub(ktime_get(), t));
+
+	++reg->reclaims;
+	reg->reclaim_us += us;
+	if (us > reg->reclaim_max_us)
+		reg->reclaim_max_us = us;
+	if (ret < 0) {
+		++reg->reclaim_fails;
+		pr_debug("%s: unable to take back %p@%p\n",
+			 reg->name ?: "(private)",
+			 (void *)chunk->size, (void *)chunk->start);
+		return ret;
+	}
+	reg->migrated += ret;
+	return 0;
+}
+
+/* Lend the memory of a chunk being freed again. */
+static void __cma_chunk_return(struct cma_chunk *chunk)
+{
+	unsigned long start, end;
+
+	if (__cma_chunk_lent(chunk, &start, &end))
+		free_contig_range(start, end - start);
+}
+
+#if defined CONFIG_DEBUG_FS
+
+static int cma_lend_show(struct seq_file *m, void *v)
+{
+	struct cma_region *reg;
+
+	mutex_lock(&cma_mutex);
+	cma_foreach_region(reg) {
+		if (reg->lent_start >= reg->lent_end)
+			continue;
+		seq_printf(m, "%s lent_kb %lu reclaims %lu failed %lu "
+			   "migrated %lu total_us %lu max_us %lu\n",
+			   reg->name ?: "(private)",
+			   (reg->lent_end - reg->lent_start) <<
+				(PAGE_SHIFT - 10),
+			   reg->reclaims, reg->reclaim_fails, reg->migrated,
+			   reg->reclaim_us, reg->reclaim_max_us);
+	}
+	mutex_unlock(&cma_mutex);
+
+	return 0;
+}
+
+static int cma_lend_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cma_lend_show, NULL);
+}
+
+static const struct file_operations cma_lend_fops = {
+	.open		= cma_lend_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init cma_lend_debugfs_init(void)
+{
+	debugfs_create_file("cma_lend", 0444, NULL, NULL, &cma_lend_fops);
+	return 0;
+}
+late_initcall(cma_lend_debugfs_init);
+
+#endif
+
+#else
+
+/* Without CONFIG_CMA_MIGRATE regions simply keep their memory. */
+static inline void __cma_region_lend(struct cma_region *reg)
+{
+}
+
+static inline int __cma_chunk_reclaim(struct cma_chunk *chunk)
+{
+	return 0;
+}
+
+static inline void __cma_chunk_return(struct cma_chunk *chunk) { }
+
+#endif
+
+
+
 /************************* Chunks *************************/
 
 /* All chunks sorted by start address. */
@@ -994,11 +1169,17 @@ static int __must_check __cma_chunk_insert(struct cma_chunk *chunk)
 
 static void __cma_chunk_free(struct cma_chunk *chunk)
 {
+	/* The allocator may free the chunk object. */
+	struct cma_region *reg = chunk->reg;
+	size_t size = chunk->size;
+
 	rb_erase(&chunk->by_start, &cma_chunks_by_start);
 
-	chunk->reg->alloc->free(chunk);
-	--chunk->reg->users;
-	chunk->reg->free_space += chunk->size;
+	trace_cma_free(reg, chunk->start, size, 0);
+	__cma_chunk_return(chunk);
+	reg->alloc->free(chunk);
+	--reg->users;
+	reg->free_space += size;
 }
 
 
@@ -1020,8 +1201,13 @@ __cma_alloc_from_region(struct cma_region *reg,
 		 (void *)size, (void *)alignment,
 		 reg ? reg->name ?: "(private)" : "(null)");
 
-	if (!reg || reg->free_space < size)
+	if (!reg)
+		return -ENOMEM;
+
+	if (reg->free_space < size) {
+		trace_cma_alloc_failed(reg, 0, size, alignment);
 		return -ENOMEM;
+	}
 
 	if (!reg->alloc) {
 		if (!reg->used)
@@ -1031,8 +1217,10 @@ __cma_alloc_from_region(struct cma_region *reg,
 	}
 
 	chunk = reg->alloc->alloc(reg, size, alignment);
-	if (!chunk)
+	if (!chunk) {
+		trace_cma_alloc_failed(reg, 0, size, alignment);
 		return -ENOMEM;
+	}
 
 	if (unlikely(__cma_chunk_insert(chunk) < 0)) {
 		/* We should *never* be here. */
@@ -1042,8 +1230,15 @@ __cma_alloc_from_region(struct cma_region *reg,
 	}
 
 	chunk->reg = reg;
+	if (__cma_chunk_reclaim(chunk) < 0) {
+		rb_erase(&chunk->by_start, &cma_chunks_by_start);
+		reg->alloc->free(chunk);
+		return -EBUSY;
+	}
+
 	++reg->users;
 	reg->free_space -= chunk->size;
+	trace_cma_alloc(reg, chunk->start, chunk->size, alignment);
 	pr_debug("allocated at %p\n", (void *)chunk->start);
 	return chunk->start;
 }
@@ -1232,6 +1427,322 @@ int cma_free(dma_addr_t addr)
 EXPORT_SYMBOL_GPL(cma_free);
 
 
+/************************* Replay *************************/
+
+#if defined CONFIG_CMA_REPLAY
+
+/*
+ * Plays a sequence of allocations and frees, as recorded by the cma
+ * tracepoints, against an allocator on a scratch copy of a region.
+ * Allocators only manage addresses, so neither the region's memory
+ * nor its chunks are touched.  Commands written to
+ * /sys/kernel/debug/cma_replay, one per line:
+ *
+ *	region <name>		start a new sequence for that region
+ *	a <id> <size> <align>	allocate a chunk and call it <id>, the
+ *				alignment in hex
+ *	f <id>			free chunk <id>
+ *	run <allocator>		play the sequence and record the result
+ *
+ * Reading the file shows the result of each run.
+ */
+
+#define CMA_REPLAY_MAX_OPS	65536
+#define CMA_REPLAY_MAX_IDS	1024
+#define CMA_REPLAY_RUNS		8
+
+struct cma_replay_op {
+	unsigned short id;
+	unsigned short alloc;
+	size_t size;
+	dma_addr_t alignment;
+};
+
+struct cma_replay_run {
+	char alloc_name[16];
+	unsigned failed, failed_fit;
+	unsigned long us;
+	size_t peak, free, largest;
+};
+
+/* Protects everything below. */
+static DEFINE_MUTEX(cma_replay_mutex);
+static char cma_replay_region[16];
+static dma_addr_t cma_replay_start;
+static size_t cma_replay_size;
+static struct cma_replay_op *cma_replay_ops;
+static unsigned cma_replay_nr_ops;
+static struct cma_replay_run cma_replay_runs[CMA_REPLAY_RUNS];
+static unsigned cma_replay_nr_runs;
+
+/* Largest chunk the allocator can still hand out, found by bisection. */
+static size_t __cma_replay_largest(struct cma_region *reg)
+{
+	size_t lo = 0, hi = reg->free_space >> PAGE_SHIFT;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi + 1) / 2;
+		struct cma_chunk *chunk =
+			reg->alloc->alloc(reg, mid << PAGE_SHIFT, PAGE_SIZE);
+
+		if (chunk) {
+			chunk->reg = reg;
+			reg->alloc->free(chunk);
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	return lo << PAGE_SHIFT;
+}
+
+static int __cma_replay_run(const char *name)
+{
+	struct cma_replay_run *run;
+	struct cma_allocator *alloc;
+	struct cma_chunk **chunks;
+	struct cma_region reg;
+	size_t size, used = 0;
+	unsigned i;
+	ktime_t t;
+	int ret;
+
+	if (!cma_replay_nr_ops)
+		return -EINVAL;
+	if (cma_replay_nr_runs == CMA_REPLAY_RUNS)
+		return -ENOSPC;
+
+	mutex_lock(&cma_mutex);
+	alloc = __cma_allocator_find(name);
+	mutex_unlock(&cma_mutex);
+	if (!alloc)
+		return -ENOENT;
+
+	chunks = kcalloc(CMA_REPLAY_MAX_IDS, sizeof *chunks, GFP_KERNEL);
+	if (!chunks)
+		return -ENOMEM;
+
+	memset(&reg, 0, sizeof reg);
+	reg.start = cma_replay_start;
+	reg.size = cma_replay_size;
+	reg.free_space = reg.size;
+	reg.alloc = alloc;
+	ret = alloc->init ? alloc->init(&reg) : 0;
+	if (ret)
+		goto done;
+
+	run = cma_replay_runs + cma_replay_nr_runs++;
+	memset(run, 0, sizeof *run);
+	strlcpy(run->alloc_name, name, sizeof run->alloc_name);
+
+	t = ktime_get();
+	for (i = 0; i < cma_replay_nr_ops; ++i) {
+		struct cma_replay_op *op = cma_replay_ops + i;
+		struct cma_chunk *chunk = chunks[op->id];
+
+		if (!op->alloc) {
+			if (!chunk)
+				continue;
+			chunks[op->id] = NULL;
+			size = chunk->size;
+			alloc->free(chunk);
+			reg.free_space += size;
+			used -= size;
+			continue;
+		}
+
+		if (chunk)
+			continue;
+		chunk = reg.free_space >= op->size
+			? alloc->alloc(&reg, op->size, op->alignment)
+			: NULL;
+		if (!chunk) {
+			++run->failed;
+			if (reg.free_space >= op->size)
+				++run->failed_fit;
+			continue;
+		}
+
+		chunk->reg = &reg;
+		chunks[op->id] = chunk;
+		reg.free_space -= chunk->size;
+		used += chunk->size;
+		if (used > run->peak)
+			run->peak = used;
+	}
+	run->us = ktime_to_us(ktime_sub(ktime_get(), t));
+	run->free = reg.free_space;
+	run->largest = __cma_replay_largest(&reg);
+
+	for (i = 0; i < CMA_REPLAY_MAX_IDS; ++i)
+		if (chunks[i])
+			alloc->free(chunks[i]);
+	if (alloc->cleanup)
+		alloc->cleanup(&reg);
+
+done:
+	kfree(chunks);
+	return ret;
+}
+
+static int __cma_replay_set_region(const char *name)
+{
+	struct cma_region *reg;
+	int ret = -ENOENT;
+
+	if (!cma_replay_ops) {
+		cma_replay_ops = vmalloc(CMA_REPLAY_MAX_OPS *
+					 sizeof *cma_replay_ops);
+		if (!cma_replay_ops)
+			return -ENOMEM;
+	}
+
+	mutex_lock(&cma_mutex);
+	cma_foreach_region(reg)
+		if (reg->name && !strcmp(reg->name, name)) {
+			strlcpy(cma_replay_region, name,
+				sizeof cma_replay_region);
+			cma_replay_start = reg->start;
+			cma_replay_size = reg->size;
+			cma_replay_nr_ops = 0;
+			cma_replay_nr_runs = 0;
+			ret = 0;
+			break;
+		}
+	mutex_unlock(&cma_mutex);
+
+	return ret;
+}
+
+static int __cma_replay_command(char *line)
+{
+	unsigned long long alignment;
+	struct cma_replay_op *op;
+	unsigned long size;
+	char name[16];
+	unsigned id;
+
+	if (!*line || *line == '#')
+		return 0;
+	if (sscanf(line, "region %15s", name) == 1)
+		return __cma_replay_set_region(name);
+	if (!cma_replay_size)
+		return -EINVAL;
+	if (sscanf(line, "run %15s", name) == 1)
+		return __cma_replay_run(name);
+
+	if (cma_replay_nr_ops == CMA_REPLAY_MAX_OPS)
+		return -ENOSPC;
+	op = cma_replay_ops + cma_replay_nr_ops;
+
+	if (sscanf(line, "a %u %lu %llx", &id, &size, &alignment) == 3) {
+		if (!size || alignment & (alignment - 1))
+			return -EINVAL;
+		op->alloc = 1;
+		op->size = PAGE_ALIGN(size);
+		op->alignment = max(alignment, (unsigned long long)PAGE_SIZE);
+	} else if (sscanf(line, "f %u", &id) == 1) {
+		op->alloc = 0;
+	} else {
+		return -EINVAL;
+	}
+
+	if (id >= CMA_REPLAY_MAX_IDS)
+		return -ERANGE;
+	op->id = id;
+	++cma_replay_nr_ops;
+	return 0;
+}
+
+/*
+ * Only complete lines are consumed, the writer is expected to write the
+ * rest again.  A buffer without any newline is taken as one last line.
+ */
+static ssize_t cma_replay_write(struct file *file, const char __user *ubuf,
+				size_t cnt, loff_t *ppos)
+{
+	char *buf, *line, *end;
+	size_t len = min_t(size_t, cnt, PAGE_SIZE - 1);
+	int ret = 0;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	if (copy_from_user(buf, ubuf, len)) {
+		kfree(buf);
+		return -EFAULT;
+	}
+	buf[len] = 0;
+
+	mutex_lock(&cma_replay_mutex);
+	if (!strchr(buf, '\n')) {
+		ret = __cma_replay_command(strstrip(buf));
+	} else {
+		len = 0;
+		for (line = buf; (end = strchr(line, '\n')); line = end + 1) {
+			*end = 0;
+			ret = __cma_replay_command(strstrip(line));
+			if (ret)
+				break;
+			len = end + 1 - buf;
+		}
+	}
+	mutex_unlock(&cma_replay_mutex);
+	kfree(buf);
+
+	if (ret && !len)
+		return ret;
+	*ppos += len;
+	return len;
+}
+
+static int cma_replay_show(struct seq_file *m, void *v)
+{
+	struct cma_replay_run *run;
+
+	mutex_lock(&cma_replay_mutex);
+	if (cma_replay_size)
+		seq_printf(m, "region %s size_kb %lu ops %u\n",
+			   cma_replay_region,
+			   (unsigned long)(cma_replay_size >> 10),
+			   cma_replay_nr_ops);
+	for (run = cma_replay_runs;
+	     run < cma_replay_runs + cma_replay_nr_runs; ++run)
+		seq_printf(m, "%s failed %u failed_fit %u time_us %lu "
+			   "peak_kb %lu free_kb %lu largest_kb %lu\n",
+			   run->alloc_name, run->failed, run->failed_fit,
+			   run->us, (unsigned long)(run->peak >> 10),
+			   (unsigned long)(run->free >> 10),
+			   (unsigned long)(run->largest >> 10));
+	mutex_unlock(&cma_replay_mutex);
+
+	return 0;
+}
+
+static int cma_replay_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cma_replay_show, NULL);
+}
+
+static const struct file_operations cma_replay_fops = {
+	.open		= cma_replay_open,
+	.read		= seq_read,
+	.write		= cma_replay_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init cma_replay_debugfs_init(void)
+{
+	debugfs_create_file("cma_replay", 0644, NULL, NULL, &cma_replay_fops);
+	return 0;
+}
+late_initcall(cma_replay_debugfs_init);
+
+#endif
+
+
 /************************* Miscellaneous *************************/
 
 static int __cma_region_attach_alloc(struct cma_region *reg)
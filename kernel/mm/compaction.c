@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 /*
@@ -38,6 +40,7 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+	bool sync;			/* false: never wait on locked pages or IO */
 };
 
 static unsigned long release_freepages(struct list_head *freelist)
@@ -226,6 +229,21 @@ static bool too_many_isolated(struct zone *zone)
 	return isolated > (inactive + active) / 2;
 }
 
+/*
+ * A dirty pagecache page can only be migrated without writing it back
+ * if its filesystem provides a migratepage method. Called under the
+ * lru_lock, so the mapping can be looked at but may be stale.
+ */
+static bool async_migrate_dirty_ok(struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+
+	if (PageAnon(page) || !mapping)
+		return true;
+
+	return mapping->a_ops->migratepage != NULL;
+}
+
 /*
  * Isolate all pages that can be migrated from the block pointed to by
  * the migrate scanner within compact_control.
@@ -251,9 +269,16 @@ static unsigned long isolate_migratepages(struct zone *zone,
 	/*
 	 * Ensure that there are not too many pages isolated from the LRU
 	 * list by either parallel reclaimers or compaction. If there are,
-	 * delay for some time until fewer pages are isolated
+	 * delay for some time until fewer pages are isolated. Asynchronous
+	 * compaction gives up on this block instead of waiting.
 	 */
 	while (unlikely(too_many_isolated(zone))) {
+		if (!cc->sync) {
+			count_vm_event(COMPACTSKIPISOLATED);
+			cc->migrate_pfn = end_pfn;
+			return 0;
+		}
+
 		congestion_wait(BLK_RW_ASYNC, HZ/10);
 
 		if (fatal_signal_pending(current))
@@ -272,6 +297,22 @@ static unsigned long isolate_migratepages(struct zone *zone,
 		if (PageBuddy(page))
 			continue;
 
+		/*
+		 * Asynchronous compaction would only fail to migrate pages
+		 * that are locked or need IO, so don't isolate them at all.
+		 */
+		if (!cc->sync && PageLRU(page)) {
+			if (PageWriteback(page) || (PageDirty(page) &&
+			    !async_migrate_dirty_ok(page))) {
+				count_vm_event(COMPACTSKIPWRITEBACK);
+				continue;
+			}
+			if (PageLocked(page)) {
+				count_vm_event(COMPACTSKIPLOCKED);
+				continue;
+			}
+		}
+
 		/* Try isolate the page */
 		if (__isolate_lru_page(page, ISOLATE_BOTH, 0) != 0)
 			continue;
@@ -394,7 +435,7 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 
 		nr_migrate = cc->nr_migratepages;
 		migrate_pages(&cc->migratepages, compaction_alloc,
-						(unsigned long)cc, 0);
+						(unsigned long)cc, 0, cc->sync);
 		update_nr_listpages(cc);
 		nr_remaining = cc->nr_migratepages;
 
@@ -419,7 +460,8 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 }
 
 static unsigned long compact_zone_order(struct zone *zone,
-						int order, gfp_t gfp_mask)
+						int order, gfp_t gfp_mask,
+						bool sync)
 {
 	struct compact_control cc = {
 		.nr_freepages = 0,
@@ -427,6 +469,7 @@ static unsigned long compact_zone_order(struct zone *zone,
 		.order = order,
 		.migratetype = allocflags_to_migratetype(gfp_mask),
 		.zone = zone,
+		.sync = sync,
 	};
 	INIT_LIST_HEAD(&cc.freepages);
 	INIT_LIST_HEAD(&cc.migratepages);
@@ -442,11 +485,13 @@ int sysctl_extfrag_threshold = 500;
  * @order: The order of the current allocation
  * @gfp_mask: The GFP mask of the current allocation
  * @nodemask: The allowed nodes to allocate from
+ * @sync: Whether migration may wait on locked pages and writeback
  *
  * This is the main entry point for direct page compaction.
  */
 unsigned long try_to_compact_pages(struct zonelist *zonelist,
-			int order, gfp_t gfp_mask, nodemask_t *nodemask)
+			int order, gfp_t gfp_mask, nodemask_t *nodemask,
+			bool sync)
 {
 	enum zone_type high_zoneidx = gfp_zone(gfp_mask);
 	int may_enter_fs = gfp_mask & __GFP_FS;
@@ -457,11 +502,14 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	int rc = COMPACT_SKIPPED;
 
 	/*
-	 * Check whether it is worth even starting compaction. The order check is
-	 * made because an assumption is made that the page allocator can satisfy
-	 * the "cheaper" orders without taking special steps
+	 * Check whether it is worth even starting compaction. Synchronous
+	 * compaction is too expensive for the "cheaper" orders, which the
+	 * page allocator can usually satisfy by reclaim, but asynchronous
+	 * compaction does not block and is worth trying for any order.
 	 */
-	if (order <= PAGE_ALLOC_COSTLY_ORDER || !may_enter_fs || !may_perform_io)
+	if (!order || !may_enter_fs || !may_perform_io)
+		return rc;
+	if (sync && order <= PAGE_ALLOC_COSTLY_ORDER)
 		return rc;
 
 	count_vm_event(COMPACTSTALL);
@@ -479,8 +527,10 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 		 * footprint is higher
 		 */
 		watermark = low_wmark_pages(zone) + (2UL << order);
-		if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		if (!zone_watermark_ok(zone, 0, watermark, 0, 0)) {
+			count_vm_event(COMPACTSKIPWMARK);
 			continue;
+		}
 
 		/*
 		 * fragmentation index determines if allocation failures are
@@ -494,15 +544,17 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 		 * Only compact if a failure would be due to fragmentation.
 		 */
 		fragindex = fragmentation_index(zone, order);
-		if (fragindex >= 0 && fragindex <= sysctl_extfrag_threshold)
+		if (fragindex >= 0 && fragindex <= sysctl_extfrag_threshold) {
+			count_vm_event(COMPACTSKIPFRAG);
 			continue;
+		}
 
 		if (fragindex == -1 && zone_watermark_ok(zone, order, watermark, 0, 0)) {
 			rc = COMPACT_PARTIAL;
 			break;
 		}
 
-		status = compact_zone_order(zone, order, gfp_mask);
+		status = compact_zone_order(zone, order, gfp_mask, sync);
 		rc = max(status, rc);
 
 		if (zone_watermark_ok(zone, order, watermark, 0, 0))
@@ -532,6 +584,7 @@ static int compact_node(int nid)
 			.nr_freepages = 0,
 			.nr_migratepages = 0,
 			.order = -1,
+			.sync = true,
 		};
 
 		zone = &pgdat->node_zones[zoneid];
@@ -583,6 +636,156 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * Background compaction: kswapd restores the order-0 watermarks but
+ * reclaim alone does little for external fragmentation. Once it is done
+ * with a high-order request, it wakes the node's kcompactd which
+ * compacts, asynchronously, the zones where an allocation of that order
+ * would fail because of fragmentation rather than lack of memory.
+ */
+static bool kcompactd_zone_suitable(struct zone *zone, int order)
+{
+	unsigned long watermark = low_wmark_pages(zone);
+	int fragindex;
+
+	if (!populated_zone(zone))
+		return false;
+
+	/* The high-order page is there already */
+	if (zone_watermark_ok(zone, order, watermark, 0, 0))
+		return false;
+
+	/* Not enough order-0 pages to migrate into */
+	if (!zone_watermark_ok(zone, 0, watermark + (2UL << order), 0, 0))
+		return false;
+
+	fragindex = fragmentation_index(zone, order);
+	return fragindex < 0 || fragindex > sysctl_extfrag_threshold;
+}
+
+static bool kcompactd_node_suitable(pg_data_t *pgdat, int order)
+{
+	int zoneid;
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++)
+		if (kcompactd_zone_suitable(&pgdat->node_zones[zoneid], order))
+			return true;
+
+	return false;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat, int order)
+{
+	int zoneid;
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_UNMOVABLE,
+			.zone = zone,
+			.sync = false,
+		};
+		int status;
+
+		if (!kcompactd_zone_suitable(zone, order))
+			continue;
+
+		if (compaction_deferred(zone)) {
+			count_vm_event(COMPACTDEFERRED);
+			continue;
+		}
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		status = compact_zone(zone, &cc);
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0)) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+		} else if (status == COMPACT_COMPLETE) {
+			/* A full pass did not help, back off like direct compaction */
+			defer_compaction(zone);
+		}
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+	}
+}
+
+/**
+ * wakeup_kcompactd - Ask for background compaction of a node
+ * @pgdat: The node kswapd has just balanced
+ * @order: The order kswapd was reclaiming for
+ *
+ * Does nothing unless an allocation of @order in one of the node's zones
+ * would fail because of fragmentation.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+	if (!order || !pgdat->kcompactd)
+		return;
+
+	if (!kcompactd_node_suitable(pgdat, order))
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	count_vm_event(KCOMPACTDWAKE);
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	int order;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pgdat->kcompactd_wait,
+				pgdat->kcompactd_max_order ||
+				kthread_should_stop());
+
+		order = pgdat->kcompactd_max_order;
+		pgdat->kcompactd_max_order = 0;
+		if (order)
+			kcompactd_do_work(pgdat, order);
+	}
+
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		pgdat->kcompactd = kthread_run(kcompactd, pgdat,
+						"kcompactd%d", nid);
+		if (IS_ERR(pgdat->kcompactd)) {
+			printk(KERN_ERR "Failed to start kcompactd on node %d\n",
+				nid);
+			pgdat->kcompactd = NULL;
+		}
+	}
+
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
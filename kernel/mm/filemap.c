@@ -36,6 +36,9 @@
 #include <linux/mm_inline.h> /* for page_is_file_cache() */
 #include "internal.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/filemap.h>
+
 /*
  * FIXME: remove all knowledge of the buffer layer from the core VM
  */
@@ -84,6 +87,9 @@
  *    ->sb_lock			(fs/fs-writeback.c)
  *    ->mapping->tree_lock	(__sync_single_inode)
  *
+ *  ->mapping->tree_lock
+ *    ->shadow_lock		(workingset_store, workingset_forget)
+ *
  *  ->i_mmap_lock
  *    ->anon_vma.lock		(vma_adjust)
  *
@@ -114,12 +120,22 @@
  * Remove a page from the page cache and free it. Caller has to make
  * sure the page is locked and that nobody else uses it - or that usage
  * is safe.  The caller must hold the mapping's tree_lock.
+ *
+ * If @shadow is not NULL, it is left in the page's slot for refault
+ * detection, see mm/workingset.c.
  */
-void __remove_from_page_cache(struct page *page)
+void __remove_from_page_cache(struct page *page, void *shadow)
 {
 	struct address_space *mapping = page->mapping;
 
-	radix_tree_delete(&mapping->page_tree, page->index);
+	if (shadow) {
+		void **slot;
+
+		slot = radix_tree_lookup_slot(&mapping->page_tree, page->index);
+		radix_tree_replace_slot(slot, shadow);
+		workingset_store(mapping);
+	} else
+		radix_tree_delete(&mapping->page_tree, page->index);
 	page->mapping = NULL;
 	mapping->nrpages--;
 	__dec_zone_page_state(page, NR_FILE_PAGES);
@@ -147,7 +163,7 @@ void remove_from_page_cache(struct page *page)
 	BUG_ON(!PageLocked(page));
 
 	spin_lock_irq(&mapping->tree_lock);
-	__remove_from_page_cache(page);
+	__remove_from_page_cache(page, NULL);
 	spin_unlock_irq(&mapping->tree_lock);
 	mem_cgroup_uncharge_cache_page(page);
 }
@@ -385,17 +401,43 @@ int filemap_write_and_wait_range(struct address_space *mapping,
 EXPORT_SYMBOL(filemap_write_and_wait_range);
 
 /**
- * add_to_page_cache_locked - add a locked page to the pagecache
- * @page:	page to add
- * @mapping:	the page's address_space
- * @offset:	page index
- * @gfp_mask:	page allocation mode
- *
- * This function is used to add a page to the pagecache. It must be locked.
- * This function does not add the page to the LRU.  The caller must do that.
+ * page_cache_tree_insert - insert a page into the page cache radix tree
+ * @mapping:	the address_space to insert into
+ * @index:	page index
+ * @page:	the page
+ * @shadowp:	where to return the replaced shadow entry, or NULL
+ *
+ * Like radix_tree_insert(), except that the shadow entry of a page
+ * previously evicted from @index is replaced rather than treated as an
+ * existing page.  The caller must hold the mapping's tree_lock and have
+ * preloaded the radix tree.
  */
-int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
-		pgoff_t offset, gfp_t gfp_mask)
+int page_cache_tree_insert(struct address_space *mapping, pgoff_t index,
+			   struct page *page, void **shadowp)
+{
+	void **slot;
+	void *p;
+
+	slot = radix_tree_lookup_slot(&mapping->page_tree, index);
+	if (!slot)
+		return radix_tree_insert(&mapping->page_tree, index, page);
+
+	p = radix_tree_deref_slot(slot);
+	if (!radix_tree_exceptional_entry(p))
+		return -EEXIST;
+
+	radix_tree_replace_slot(slot, page);
+	workingset_forget(mapping, p);
+	if (shadowp)
+		*shadowp = p;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(page_cache_tree_insert);
+
+static int __add_to_page_cache_locked(struct page *page,
+				      struct address_space *mapping,
+				      pgoff_t offset, gfp_t gfp_mask,
+				      void **shadowp)
 {
 	int error;
 
@@ -413,7 +455,7 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 		page->index = offset;
 
 		spin_lock_irq(&mapping->tree_lock);
-		error = radix_tree_insert(&mapping->page_tree, offset, page);
+		error = page_cache_tree_insert(mapping, offset, page, shadowp);
 		if (likely(!error)) {
 			mapping->nrpages++;
 			__inc_zone_page_state(page, NR_FILE_PAGES);
@@ -432,11 +474,29 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 out:
 	return error;
 }
+
+/**
+ * add_to_page_cache_locked - add a locked page to the pagecache
+ * @page:	page to add
+ * @mapping:	the page's address_space
+ * @offset:	page index
+ * @gfp_mask:	page allocation mode
+ *
+ * This function is used to add a page to the pagecache. It must be locked.
+ * This function does not add the page to the LRU.  The caller must do that.
+ */
+int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
+		pgoff_t offset, gfp_t gfp_mask)
+{
+	return __add_to_page_cache_locked(page, mapping, offset,
+					  gfp_mask, NULL);
+}
 EXPORT_SYMBOL(add_to_page_cache_locked);
 
 int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				pgoff_t offset, gfp_t gfp_mask)
 {
+	void *shadow = NULL;
 	int ret;
 
 	/*
@@ -448,14 +508,28 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 	if (mapping_cap_swap_backed(mapping))
 		SetPageSwapBacked(page);
 
-	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
-	if (ret == 0) {
-		if (page_is_file_cache(page))
-			lru_cache_add_file(page);
-		else
-			lru_cache_add_anon(page);
+	__set_page_locked(page);
+	ret = __add_to_page_cache_locked(page, mapping, offset,
+					 gfp_mask, &shadow);
+	if (unlikely(ret)) {
+		__clear_page_locked(page);
+		return ret;
 	}
-	return ret;
+
+	if (page_is_file_cache(page)) {
+		/*
+		 * The page was evicted recently enough that it would
+		 * still be cached with a larger inactive list: it is
+		 * part of the workingset, start it on the active list.
+		 */
+		if (shadow && workingset_refault(shadow)) {
+			workingset_activation(page);
+			lru_cache_add_lru(page, LRU_ACTIVE_FILE);
+		} else
+			lru_cache_add_file(page);
+	} else
+		lru_cache_add_anon(page);
+	return 0;
 }
 EXPORT_SYMBOL_GPL(add_to_page_cache_lru);
 
@@ -612,6 +686,64 @@ void __lock_page_nosync(struct page *page)
 							TASK_UNINTERRUPTIBLE);
 }
 
+/**
+ * page_cache_next_hole - find the next hole (not-present entry)
+ * @mapping: mapping
+ * @index: index
+ * @max_scan: maximum range to search
+ *
+ * Like radix_tree_next_hole() on the page cache radix tree, except that
+ * shadow entries of evicted pages count as holes.  May be called under
+ * rcu_read_lock.
+ */
+pgoff_t page_cache_next_hole(struct address_space *mapping,
+			     pgoff_t index, unsigned long max_scan)
+{
+	unsigned long i;
+
+	for (i = 0; i < max_scan; i++) {
+		void *page = radix_tree_lookup(&mapping->page_tree, index);
+
+		if (!page || radix_tree_exceptional_entry(page))
+			break;
+		index++;
+		if (index == 0)
+			break;
+	}
+
+	return index;
+}
+EXPORT_SYMBOL(page_cache_next_hole);
+
+/**
+ * page_cache_prev_hole - find the prev hole (not-present entry)
+ * @mapping: mapping
+ * @index: index
+ * @max_scan: maximum range to search
+ *
+ * Like radix_tree_prev_hole() on the page cache radix tree, except that
+ * shadow entries of evicted pages count as holes.  May be called under
+ * rcu_read_lock.
+ */
+pgoff_t page_cache_prev_hole(struct address_space *mapping,
+			     pgoff_t index, unsigned long max_scan)
+{
+	unsigned long i;
+
+	for (i = 0; i < max_scan; i++) {
+		void *page = radix_tree_lookup(&mapping->page_tree, index);
+
+		if (!page || radix_tree_exceptional_entry(page))
+			break;
+		index--;
+		if (index == ULONG_MAX)
+			break;
+	}
+
+	return index;
+}
+EXPORT_SYMBOL(page_cache_prev_hole);
+
 /**
  * find_get_page - find and get a page reference
  * @mapping: the address_space to search
@@ -634,6 +766,12 @@ repeat:
 		if (unlikely(!page || page == RADIX_TREE_RETRY))
 			goto repeat;
 
+		/* A shadow entry of a recently evicted page */
+		if (radix_tree_exceptional_entry(page)) {
+			page = NULL;
+			goto out;
+		}
+
 		if (!page_cache_get_speculative(page))
 			goto repeat;
 
@@ -647,6 +785,7 @@ repeat:
 			goto repeat;
 		}
 	}
+out:
 	rcu_read_unlock();
 
 	return page;
@@ -749,39 +888,64 @@ EXPORT_SYMBOL(find_or_create_page);
 unsigned find_get_pages(struct address_space *mapping, pgoff_t start,
 			    unsigned int nr_pages, struct page **pages)
 {
+	unsigned long indices[PAGEVEC_SIZE];
+	void **slots[PAGEVEC_SIZE];
 	unsigned int i;
 	unsigned int ret;
 	unsigned int nr_found;
+	pgoff_t index;
 
 	rcu_read_lock();
 restart:
-	nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
-				(void ***)pages, start, nr_pages);
 	ret = 0;
-	for (i = 0; i < nr_found; i++) {
-		struct page *page;
+	index = start;
+	/*
+	 * Look up the slots a pagevec at a time, so that runs of shadow
+	 * entries can be skipped without returning 0 to callers that
+	 * would take it for the end of the mapping.
+	 */
+	while (ret < nr_pages) {
+		unsigned int nr = min_t(unsigned int, nr_pages - ret,
+					PAGEVEC_SIZE);
+
+		nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
+					slots, indices, index, nr);
+		if (!nr_found)
+			break;
+
+		for (i = 0; i < nr_found; i++) {
+			struct page *page;
 repeat:
-		page = radix_tree_deref_slot((void **)pages[i]);
-		if (unlikely(!page))
-			continue;
-		/*
-		 * this can only trigger if nr_found == 1, making livelock
-		 * a non issue.
-		 */
-		if (unlikely(page == RADIX_TREE_RETRY))
-			goto restart;
+			page = radix_tree_deref_slot(slots[i]);
+			if (unlikely(!page))
+				continue;
+			/*
+			 * this can only trigger if nr_found == 1 on the
+			 * first lookup, making livelock a non issue.
+			 */
+			if (unlikely(page == RADIX_TREE_RETRY))
+				goto restart;
 
-		if (!page_cache_get_speculative(page))
-			goto repeat;
+			/* A shadow entry of a recently evicted page */
+			if (radix_tree_exceptional_entry(page))
+				continue;
 
-		/* Has the page moved? */
-		if (unlikely(page != *((void **)pages[i]))) {
-			page_cache_release(page);
-			goto repeat;
+			if (!page_cache_get_speculative(page))
+				goto repeat;
+
+			/* Has the page moved? */
+			if (unlikely(page != *slots[i])) {
+				page_cache_release(page);
+				goto repeat;
+			}
+
+			pages[ret] = page;
+			ret++;
 		}
 
-		pages[ret] = page;
-		ret++;
+		index = indices[nr_found - 1] + 1;
+		if (!index)
+			break;	/* wraparound */
 	}
 	rcu_read_unlock();
 	return ret;
@@ -809,7 +973,7 @@ unsigned find_get_pages_contig(struct address_space *mapping, pgoff_t index,
 	rcu_read_lock();
 restart:
 	nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
-				(void ***)pages, index, nr_pages);
+				(void ***)pages, NULL, index, nr_pages);
 	ret = 0;
 	for (i = 0; i < nr_found; i++) {
 		struct page *page;
@@ -824,6 +988,10 @@ repeat:
 		if (unlikely(page == RADIX_TREE_RETRY))
 			goto restart;
 
+		/* A shadow entry is a hole as far as we are concerned */
+		if (radix_tree_exceptional_entry(page))
+			break;
+
 		if (page->mapping == NULL || page->index != index)
 			break;
 
@@ -988,6 +1156,8 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 	last_index = (*ppos + desc->count + PAGE_CACHE_SIZE-1) >> PAGE_CACHE_SHIFT;
 	offset = *ppos & ~PAGE_CACHE_MASK;
 
+	trace_mm_filemap_access(filp, index, last_index - index);
+
 	for (;;) {
 		struct page *page;
 		pgoff_t end_index;
@@ -1010,6 +1180,7 @@ find_page:
 					ra, filp, page,
 					index, last_index - index);
 		}
+		page_cache_ra_used(page);
 		if (!PageUptodate(page)) {
 			if (inode->i_blkbits == PAGE_CACHE_SHIFT ||
 					!mapping->a_ops->is_partially_uptodate)
@@ -1470,7 +1641,7 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	/*
 	 * mmap read-around
 	 */
-	ra_pages = max_sane_readahead(ra->ra_pages);
+	ra_pages = ra_max_pages(mapping, ra);
 	if (ra_pages) {
 		ra->start = max_t(long, 0, offset - ra_pages/2);
 		ra->size = ra_pages;
@@ -1529,6 +1700,8 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (offset >= size)
 		return VM_FAULT_SIGBUS;
 
+	trace_mm_filemap_access(file, offset, 1);
+
 	/*
 	 * Do we have something in the page cache already?
 	 */
@@ -1576,6 +1749,7 @@ retry_find:
 		return VM_FAULT_SIGBUS;
 	}
 
+	page_cache_ra_used(page);
 	ra->prev_pos = (loff_t)offset << PAGE_CACHE_SHIFT;
 	vmf->page = page;
 	return ret | VM_FAULT_LOCKED;
@@ -1629,8 +1803,116 @@ page_not_uptodate:
 }
 EXPORT_SYMBOL(filemap_fault);
 
+/**
+ * filemap_map_pages - map page cache pages around a read fault
+ * @vma:	vma in which the fault was taken
+ * @vmf:	the range to map, from vmf->pgoff to vmf->max_pgoff
+ *
+ * Maps the pages of the range that are in the page cache, uptodate and
+ * not locked into the empty ptes starting at vmf->pte, which the caller
+ * holds the lock of.  Nothing is read in and nothing blocks; pages that
+ * are not ready are simply left to be faulted in on their own.
+ */
+void filemap_map_pages(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct file *file = vma->vm_file;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	unsigned long address = (unsigned long)vmf->virtual_address;
+	unsigned long indices[PAGEVEC_SIZE];
+	void **slots[PAGEVEC_SIZE];
+	pgoff_t index = vmf->pgoff;
+	unsigned long mapped = 0;
+	unsigned int nr_found;
+	unsigned int i;
+	pgoff_t size;
+	pte_t *pte;
+
+	rcu_read_lock();
+	while (index <= vmf->max_pgoff) {
+		unsigned int nr = min_t(unsigned long,
+					vmf->max_pgoff - index + 1,
+					PAGEVEC_SIZE);
+
+		nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
+					slots, indices, index, nr);
+		if (!nr_found)
+			break;
+
+		for (i = 0; i < nr_found; i++) {
+			struct page *page;
+
+			if (indices[i] > vmf->max_pgoff)
+				break;
+repeat:
+			page = radix_tree_deref_slot(slots[i]);
+			if (unlikely(!page))
+				continue;
+			if (unlikely(page == RADIX_TREE_RETRY))
+				goto out;
+			/* A shadow entry of a recently evicted page */
+			if (radix_tree_exceptional_entry(page))
+				continue;
+
+			if (!page_cache_get_speculative(page))
+				goto repeat;
+
+			/* Has the page moved? */
+			if (unlikely(page != *slots[i])) {
+				page_cache_release(page);
+				goto repeat;
+			}
+
+			/* leave readahead triggers to filemap_fault() */
+			if (!PageUptodate(page) || PageReadahead(page) ||
+			    PageHWPoison(page))
+				goto skip;
+			if (!trylock_page(page))
+				goto skip;
+
+			if (page->mapping != mapping || !PageUptodate(page))
+				goto unlock;
+
+			size = (i_size_read(inode) + PAGE_CACHE_SIZE - 1) >>
+				PAGE_CACHE_SHIFT;
+			if (page->index >= size)
+				goto unlock;
+
+			pte = vmf->pte + page->index - vmf->pgoff;
+			if (!pte_none(*pte))
+				goto unlock;
+
+			if (file->f_ra.mmap_miss > 0)
+				file->f_ra.mmap_miss--;
+			page_cache_ra_used(page);
+			trace_mm_filemap_access(file, page->index, 1);
+			/* the page reference now belongs to the pte */
+			do_set_pte(vma, address +
+				   ((page->index - vmf->pgoff) << PAGE_SHIFT),
+				   page, pte);
+			unlock_page(page);
+			mapped++;
+			continue;
+unlock:
+			unlock_page(page);
+skip:
+			page_cache_release(page);
+		}
+
+		index = indices[nr_found - 1] + 1;
+		if (!index)
+			break;	/* wraparound */
+	}
+out:
+	rcu_read_unlock();
+
+	count_vm_events(FAULT_AROUND_MAPPED, mapped);
+}
+EXPORT_SYMBOL(filemap_map_pages);
+
 const struct vm_operations_struct generic_file_vm_ops = {
 	.fault		= filemap_fault,
+	.map_pages	= filemap_map_pages,
 };
 
 /* This is used for a general mmap of a disk file */
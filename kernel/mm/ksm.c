@@ -83,12 +83,26 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @scanned: pages of this mm looked at so far in the current full scan
+ * @stable: how many of those were already merged
+ * @merged: how many pages of this mm have been newly merged
+ * @pages: pages looked at in the last completed scan of this mm
+ * @estimate: merges expected from this mm in its next scan
+ * @backoff: log2 of full scans to skip after one merging nothing
+ * @skip: full scans of this mm still to be skipped
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	unsigned long scanned;
+	unsigned long stable;
+	unsigned long merged;
+	unsigned long pages;
+	unsigned long estimate;
+	unsigned char backoff;
+	unsigned char skip;
 };
 
 /**
@@ -185,6 +199,35 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/*
+ * Whether ksmd adapts to how much it merges: mms whose last scan merged
+ * nothing are skipped for up to 2^KSM_MAX_BACKOFF - 1 full scans, and the
+ * scan rate goes up to 2^KSM_MAX_SPEED times faster after a full scan
+ * merging at least KSM_HIGH_YIELD per mille of the unmerged pages looked
+ * at, or as much slower after one merging nothing.
+ */
+static unsigned int ksm_adaptive = 1;
+
+#define KSM_MAX_BACKOFF	4
+#define KSM_MAX_SPEED	2
+#define KSM_HIGH_YIELD	100
+
+/* log2 of ksmd's current speed up (if positive) or slow down */
+static int ksm_scan_speed;
+
+/* Unmerged pages looked at and pages merged in the current full scan */
+static unsigned long ksm_round_unmerged;
+static unsigned long ksm_round_merged;
+
+/* Per mille of unmerged pages merged during the last full scan */
+static unsigned long ksm_scan_yield;
+
+/* Sum of the mm_slots' estimates: pages the next full scan should merge */
+static unsigned long ksm_savings_estimate;
+
+/* Pages (as counted in their last scan) in mms skipped for backoff */
+static unsigned long ksm_pages_skipped;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -266,6 +309,7 @@ static inline struct mm_slot *alloc_mm_slot(void)
 
 static inline void free_mm_slot(struct mm_slot *mm_slot)
 {
+	ksm_savings_estimate -= mm_slot->estimate;
 	kmem_cache_free(mm_slot_cache, mm_slot);
 }
 
@@ -624,6 +668,14 @@ static int unmerge_ksm_pages(struct vm_area_struct *vma,
 }
 
 #ifdef CONFIG_SYSFS
+static void reset_mm_slot_stats(struct mm_slot *mm_slot)
+{
+	ksm_savings_estimate -= mm_slot->estimate;
+	mm_slot->scanned = mm_slot->stable = mm_slot->merged = 0;
+	mm_slot->pages = mm_slot->estimate = 0;
+	mm_slot->backoff = mm_slot->skip = 0;
+}
+
 /*
  * Only called through the sysfs control interface:
  */
@@ -655,6 +707,7 @@ static int unmerge_and_remove_all_rmap_items(void)
 		}
 
 		remove_trailing_rmap_items(mm_slot, &mm_slot->rmap_list);
+		reset_mm_slot_stats(mm_slot);
 
 		spin_lock(&ksm_mmlist_lock);
 		ksm_scan.mm_slot = list_entry(mm_slot->mm_list.next,
@@ -675,6 +728,8 @@ static int unmerge_and_remove_all_rmap_items(void)
 	}
 
 	ksm_scan.seqnr = 0;
+	ksm_round_unmerged = ksm_round_merged = 0;
+	ksm_scan_speed = 0;
 	return 0;
 
 error:
@@ -1139,6 +1194,25 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_shared++;
 }
 
+/*
+ * Credits a newly merged page to its mm; rmap_item need not belong to the
+ * mm being scanned when it was the unstable tree half of a merge.
+ */
+static void credit_merge(struct rmap_item *rmap_item)
+{
+	struct mm_slot *mm_slot = ksm_scan.mm_slot;
+
+	if (rmap_item->mm != mm_slot->mm) {
+		spin_lock(&ksm_mmlist_lock);
+		mm_slot = get_mm_slot(rmap_item->mm);
+		spin_unlock(&ksm_mmlist_lock);
+		if (!mm_slot)
+			return;
+	}
+	mm_slot->merged++;
+	ksm_round_merged++;
+}
+
 /*
  * cmp_and_merge_page - first see if page can be merged into the stable tree;
  * if not, compare checksum to previous and if it's the same, see if page can
@@ -1171,6 +1245,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			lock_page(kpage);
 			stable_tree_append(rmap_item, page_stable_node(kpage));
 			unlock_page(kpage);
+			credit_merge(rmap_item);
 		}
 		put_page(kpage);
 		return;
@@ -1210,6 +1285,11 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			}
 			unlock_page(kpage);
 
+			if (stable_node) {
+				credit_merge(tree_rmap_item);
+				credit_merge(rmap_item);
+			}
+
 			/*
 			 * If we fail to insert the page into the stable tree,
 			 * we will have 2 virtual addresses that are pointing
@@ -1252,6 +1332,83 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * Called when ksmd has finished looking at an mm: estimates what its next
+ * scan would merge and, if this one looked at unmerged pages but merged
+ * none of them, backs off from it.
+ */
+static void mm_slot_scanned(struct mm_slot *slot)
+{
+	unsigned long unmerged = slot->scanned - slot->stable;
+	unsigned long merged = min(slot->merged, unmerged);
+
+	ksm_round_unmerged += unmerged;
+
+	ksm_savings_estimate -= slot->estimate;
+	slot->estimate = 0;
+	if (unmerged)
+		slot->estimate = (unmerged - merged) *
+				 (merged * 1000 / unmerged) / 1000;
+	ksm_savings_estimate += slot->estimate;
+
+	/* An mm with nothing left to merge is cheap to scan: don't skip it */
+	if (slot->merged || !unmerged)
+		slot->backoff = 0;
+	else if (slot->backoff < KSM_MAX_BACKOFF)
+		slot->backoff++;
+	slot->skip = (1 << slot->backoff) - 1;
+
+	slot->pages = slot->scanned;
+	slot->scanned = slot->stable = slot->merged = 0;
+}
+
+/*
+ * Called as ksmd gets to an mm: returns 1 if it is to be skipped in this
+ * full scan.  Exiting mms are never skipped, ksmd must free their slots.
+ */
+static int mm_slot_skip(struct mm_slot *slot)
+{
+	struct rmap_item *rmap_item;
+
+	if (!ksm_adaptive || !slot->skip || ksm_test_exit(slot->mm))
+		return 0;
+
+	slot->skip--;
+	ksm_pages_skipped += slot->pages;
+
+	/*
+	 * Its rmap_items left in the unstable tree by the last full scan
+	 * would be too old for remove_rmap_item_from_tree() by the time
+	 * this mm is scanned again: take them out now, while they're not.
+	 */
+	for (rmap_item = slot->rmap_list; rmap_item;
+	     rmap_item = rmap_item->rmap_list)
+		if (rmap_item->address & UNSTABLE_FLAG)
+			remove_rmap_item_from_tree(rmap_item);
+	return 1;
+}
+
+/* Called at the end of each full scan to adjust ksmd's speed. */
+static void ksm_scan_done(void)
+{
+	ksm_scan_yield = 0;
+	if (ksm_round_unmerged)
+		ksm_scan_yield = ksm_round_merged * 1000 / ksm_round_unmerged;
+
+	if (!ksm_round_merged) {
+		if (ksm_scan_speed > -KSM_MAX_SPEED)
+			ksm_scan_speed--;
+	} else if (ksm_scan_yield >= KSM_HIGH_YIELD) {
+		if (ksm_scan_speed < KSM_MAX_SPEED)
+			ksm_scan_speed++;
+	} else if (ksm_scan_speed) {
+		ksm_scan_speed -= ksm_scan_speed > 0 ? 1 : -1;
+	}
+
+	ksm_round_unmerged = ksm_round_merged = 0;
+	ksm_scan.seqnr++;
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1273,6 +1430,18 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 next_mm:
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
+
+		if (mm_slot_skip(slot)) {
+			spin_lock(&ksm_mmlist_lock);
+			slot = list_entry(slot->mm_list.next,
+					  struct mm_slot, mm_list);
+			ksm_scan.mm_slot = slot;
+			spin_unlock(&ksm_mmlist_lock);
+			if (slot != &ksm_mm_head)
+				goto next_mm;
+			ksm_scan_done();
+			return NULL;
+		}
 	}
 
 	mm = slot->mm;
@@ -1324,6 +1493,7 @@ next_mm:
 	 * because there were no VM_MERGEABLE vmas with such addresses.
 	 */
 	remove_trailing_rmap_items(slot, ksm_scan.rmap_list);
+	mm_slot_scanned(slot);
 
 	spin_lock(&ksm_mmlist_lock);
 	ksm_scan.mm_slot = list_entry(slot->mm_list.next,
@@ -1356,7 +1526,7 @@ next_mm:
 	if (slot != &ksm_mm_head)
 		goto next_mm;
 
-	ksm_scan.seqnr++;
+	ksm_scan_done();
 	return NULL;
 }
 
@@ -1374,12 +1544,35 @@ static void ksm_do_scan(unsigned int scan_npages)
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
 			return;
+		ksm_scan.mm_slot->scanned++;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
 			cmp_and_merge_page(page, rmap_item);
+		else
+			ksm_scan.mm_slot->stable++;
 		put_page(page);
 	}
 }
 
+static unsigned int ksm_scan_pages(void)
+{
+	unsigned int pages = ksm_thread_pages_to_scan;
+
+	if (ksm_adaptive && ksm_scan_speed > 0 &&
+	    pages <= UINT_MAX >> ksm_scan_speed)
+		pages <<= ksm_scan_speed;
+	return pages;
+}
+
+static unsigned int ksm_scan_sleep(void)
+{
+	unsigned int msecs = ksm_thread_sleep_millisecs;
+
+	if (ksm_adaptive && ksm_scan_speed < 0 &&
+	    msecs <= UINT_MAX >> -ksm_scan_speed)
+		msecs <<= -ksm_scan_speed;
+	return msecs;
+}
+
 static int ksmd_should_run(void)
 {
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
@@ -1392,12 +1585,12 @@ static int ksm_scan_thread(void *nothing)
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
 		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_do_scan(ksm_scan_pages());
 		mutex_unlock(&ksm_thread_mutex);
 
 		if (ksmd_should_run()) {
 			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+				msecs_to_jiffies(ksm_scan_sleep()));
 		} else {
 			wait_event_interruptible(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1913,6 +2106,50 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t adaptive_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_adaptive);
+}
+
+static ssize_t adaptive_store(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      const char *buf, size_t count)
+{
+	unsigned long flags;
+	int err;
+
+	err = strict_strtoul(buf, 10, &flags);
+	if (err || flags > 1)
+		return -EINVAL;
+
+	ksm_adaptive = flags;
+
+	return count;
+}
+KSM_ATTR(adaptive);
+
+static ssize_t scan_yield_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_scan_yield);
+}
+KSM_ATTR_RO(scan_yield);
+
+static ssize_t savings_estimate_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_savings_estimate);
+}
+KSM_ATTR_RO(savings_estimate);
+
+static ssize_t pages_skipped_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_skipped);
+}
+KSM_ATTR_RO(pages_skipped);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -1922,6 +2159,10 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&adaptive_attr.attr,
+	&scan_yield_attr.attr,
+	&savings_estimate_attr.attr,
+	&pages_skipped_attr.attr,
 	NULL,
 };
 
@@ -86,6 +86,10 @@ enum mem_cgroup_stat_index {
 	MEM_CGROUP_STAT_PGPGIN_COUNT,	/* # of pages paged in */
 	MEM_CGROUP_STAT_PGPGOUT_COUNT,	/* # of pages paged out */
 	MEM_CGROUP_STAT_SWAPOUT, /* # of pages, swapped out */
+	MEM_CGROUP_STAT_PGSCAN,	/* # of pages scanned by reclaim */
+	MEM_CGROUP_STAT_PGSTEAL,	/* # of pages reclaimed */
+	MEM_CGROUP_STAT_RES_CHARGE,	/* # of res_counter charges */
+	MEM_CGROUP_STAT_RES_UNCHARGE,	/* # of res_counter uncharges */
 	MEM_CGROUP_EVENTS,	/* incremented at every  pagein/pageout */
 
 	MEM_CGROUP_STAT_NSTATS,
@@ -176,6 +180,13 @@ struct mem_cgroup_eventfd_list {
 	struct eventfd_ctx *eventfd;
 };
 
+/* for memory pressure */
+struct mem_cgroup_pressure_event {
+	struct list_head list;
+	struct eventfd_ctx *eventfd;
+	int level;
+};
+
 static void mem_cgroup_threshold(struct mem_cgroup *mem);
 static void mem_cgroup_oom_notify(struct mem_cgroup *mem);
 
@@ -244,6 +255,15 @@ struct mem_cgroup {
 	/* For oom notifier event fd */
 	struct list_head oom_notify;
 
+	/* reclaim efficiency since the last pressure check */
+	spinlock_t pressure_lock;
+	unsigned long pressure_scanned;
+	unsigned long pressure_reclaimed;
+	struct work_struct pressure_work;
+	/* For memory pressure notifier event fd */
+	struct mutex pressure_events_lock;
+	struct list_head pressure_events;
+
 	/*
 	 * Should we move charges of a task when a task is moved into this
 	 * mem_cgroup ? And what type of charges should we move ?
@@ -319,6 +339,7 @@ enum charge_type {
 #define _MEM			(0)
 #define _MEMSWAP		(1)
 #define _OOM_TYPE		(2)
+#define _PRESSURE_TYPE		(3)
 #define MEMFILE_PRIVATE(x, val)	(((x) << 16) | (val))
 #define MEMFILE_TYPE(val)	(((val) >> 16) & 0xffff)
 #define MEMFILE_ATTR(val)	((val) & 0xffff)
@@ -554,6 +575,18 @@ static void mem_cgroup_swap_statistics(struct mem_cgroup *mem,
 	this_cpu_add(mem->stat->count[MEM_CGROUP_STAT_SWAPOUT], val);
 }
 
+/*
+ * Counts operations on the shared res_counter, which the per-cpu stock and
+ * uncharge batching are there to avoid.
+ */
+static void mem_cgroup_res_statistics(struct mem_cgroup *mem, bool charge)
+{
+	if (charge)
+		this_cpu_inc(mem->stat->count[MEM_CGROUP_STAT_RES_CHARGE]);
+	else
+		this_cpu_inc(mem->stat->count[MEM_CGROUP_STAT_RES_UNCHARGE]);
+}
+
 static void mem_cgroup_charge_statistics(struct mem_cgroup *mem,
 					 struct page_cgroup *pc,
 					 bool charge)
@@ -1460,9 +1493,19 @@ done:
  * TODO: maybe necessary to use big numbers in big irons.
  */
 #define CHARGE_SIZE	(32 * PAGE_SIZE)
+
+/*
+ * With a memory cgroup per application, the tasks running on a cpu come
+ * from several cgroups in turn.  Keep a stock for a few of them so that
+ * switching between them does not return and recharge the stock each time.
+ */
+#define MEMCG_STOCK_SLOTS	4
+
 struct memcg_stock_pcp {
-	struct mem_cgroup *cached; /* this never be root cgroup */
-	int charge;
+	/* these never be root cgroup */
+	struct mem_cgroup *cached[MEMCG_STOCK_SLOTS];
+	int charge[MEMCG_STOCK_SLOTS];
+	int next;	/* slot to replace when all are in use */
 	struct work_struct work;
 };
 static DEFINE_PER_CPU(struct memcg_stock_pcp, memcg_stock);
@@ -1477,31 +1520,48 @@ static atomic_t memcg_drain_count;
 static bool consume_stock(struct mem_cgroup *mem)
 {
 	struct memcg_stock_pcp *stock;
-	bool ret = true;
+	bool ret = false;
+	int i;
 
 	stock = &get_cpu_var(memcg_stock);
-	if (mem == stock->cached && stock->charge)
-		stock->charge -= PAGE_SIZE;
-	else /* need to call res_counter_charge */
-		ret = false;
+	for (i = 0; i < MEMCG_STOCK_SLOTS; i++) {
+		if (mem == stock->cached[i] && stock->charge[i]) {
+			stock->charge[i] -= PAGE_SIZE;
+			ret = true;
+			break;
+		}
+	}
+	/* else need to call res_counter_charge */
 	put_cpu_var(memcg_stock);
 	return ret;
 }
 
 /*
- * Returns stocks cached in percpu to res_counter and reset cached information.
+ * Returns the charge stocked in one slot to res_counter and resets it.
  */
-static void drain_stock(struct memcg_stock_pcp *stock)
+static void drain_stock_slot(struct memcg_stock_pcp *stock, int i)
 {
-	struct mem_cgroup *old = stock->cached;
+	struct mem_cgroup *old = stock->cached[i];
 
-	if (stock->charge) {
-		res_counter_uncharge(&old->res, stock->charge);
+	if (stock->charge[i]) {
+		res_counter_uncharge(&old->res, stock->charge[i]);
 		if (do_swap_account)
-			res_counter_uncharge(&old->memsw, stock->charge);
+			res_counter_uncharge(&old->memsw, stock->charge[i]);
+		mem_cgroup_res_statistics(old, false);
 	}
-	stock->cached = NULL;
-	stock->charge = 0;
+	stock->cached[i] = NULL;
+	stock->charge[i] = 0;
+}
+
+/*
+ * Returns stocks cached in percpu to res_counter and reset cached information.
+ */
+static void drain_stock(struct memcg_stock_pcp *stock)
+{
+	int i;
+
+	for (i = 0; i < MEMCG_STOCK_SLOTS; i++)
+		drain_stock_slot(stock, i);
 }
 
 /*
@@ -1521,12 +1581,26 @@ static void drain_local_stock(struct work_struct *dummy)
 static void refill_stock(struct mem_cgroup *mem, int val)
 {
 	struct memcg_stock_pcp *stock = &get_cpu_var(memcg_stock);
+	int i, slot = -1;
 
-	if (stock->cached != mem) { /* reset if necessary */
-		drain_stock(stock);
-		stock->cached = mem;
+	for (i = 0; i < MEMCG_STOCK_SLOTS; i++) {
+		if (stock->cached[i] == mem) {
+			slot = i;
+			break;
+		}
+		if (slot < 0 && !stock->cached[i])
+			slot = i;
+	}
+	if (slot < 0) {
+		/* all slots in use, recycle them in turn */
+		slot = stock->next;
+		stock->next = (slot + 1) % MEMCG_STOCK_SLOTS;
 	}
-	stock->charge += val;
+	if (stock->cached[slot] != mem) { /* reset if necessary */
+		drain_stock_slot(stock, slot);
+		stock->cached[slot] = mem;
+	}
+	stock->charge[slot] += val;
 	put_cpu_var(memcg_stock);
 }
 
@@ -1630,6 +1704,7 @@ static int __mem_cgroup_try_charge(struct mm_struct *mm,
 		if (consume_stock(mem))
 			goto done;
 
+		mem_cgroup_res_statistics(mem, true);
 		ret = res_counter_charge(&mem->res, csize, &fail_res);
 		if (likely(!ret)) {
 			if (!do_swap_account)
@@ -1747,6 +1822,7 @@ static void __mem_cgroup_cancel_charge(struct mem_cgroup *mem,
 		res_counter_uncharge(&mem->res, PAGE_SIZE * count);
 		if (do_swap_account)
 			res_counter_uncharge(&mem->memsw, PAGE_SIZE * count);
+		mem_cgroup_res_statistics(mem, false);
 		VM_BUG_ON(test_bit(CSS_ROOT, &mem->css.flags));
 		WARN_ON_ONCE(count > INT_MAX);
 		__css_put(&mem->css, (int)count);
@@ -2206,7 +2282,8 @@ __do_uncharge(struct mem_cgroup *mem, const enum charge_type ctype)
 	if (!batch->memcg)
 		batch->memcg = mem;
 	/*
-	 * do_batch > 0 when unmapping pages or inode invalidate/truncate.
+	 * do_batch > 0 when unmapping pages, inode invalidate/truncate or
+	 * freeing reclaimed pages.
 	 * In those cases, all pages freed continously can be expected to be in
 	 * the same cgroup and we have chance to coalesce uncharges.
 	 * But we do uncharge one by one if this is killed by OOM(TIF_MEMDIE)
@@ -2232,6 +2309,7 @@ direct_uncharge:
 	res_counter_uncharge(&mem->res, PAGE_SIZE);
 	if (uncharge_memsw)
 		res_counter_uncharge(&mem->memsw, PAGE_SIZE);
+	mem_cgroup_res_statistics(mem, false);
 	if (unlikely(batch->memcg != mem))
 		memcg_oom_recover(mem);
 	return;
@@ -2332,7 +2410,8 @@ void mem_cgroup_uncharge_cache_page(struct page *page)
 }
 
 /*
- * Batch_start/batch_end is called in unmap_page_range/invlidate/trucate.
+ * Batch_start/batch_end is called in unmap_page_range/invlidate/trucate
+ * and around shrink_page_list().
  * In that cases, pages are freed continuously and we can expect pages
  * are in the same memcg. All these calls itself limits the number of
  * pages freed at once, then uncharge_start/end() is called properly.
@@ -2371,6 +2450,8 @@ void mem_cgroup_uncharge_end(void)
 		res_counter_uncharge(&batch->memcg->res, batch->bytes);
 	if (batch->memsw_bytes)
 		res_counter_uncharge(&batch->memcg->memsw, batch->memsw_bytes);
+	if (batch->bytes || batch->memsw_bytes)
+		mem_cgroup_res_statistics(batch->memcg, false);
 	memcg_oom_recover(batch->memcg);
 	/* forget this pointer (for sanity check) */
 	batch->memcg = NULL;
@@ -3286,6 +3367,10 @@ enum {
 	MCS_PGPGIN,
 	MCS_PGPGOUT,
 	MCS_SWAP,
+	MCS_PGSCAN,
+	MCS_PGSTEAL,
+	MCS_RES_CHARGE,
+	MCS_RES_UNCHARGE,
 	MCS_INACTIVE_ANON,
 	MCS_ACTIVE_ANON,
 	MCS_INACTIVE_FILE,
@@ -3308,6 +3393,10 @@ struct {
 	{"pgpgin", "total_pgpgin"},
 	{"pgpgout", "total_pgpgout"},
 	{"swap", "total_swap"},
+	{"pgscan", "total_pgscan"},
+	{"pgsteal", "total_pgsteal"},
+	{"res_charge", "total_res_charge"},
+	{"res_uncharge", "total_res_uncharge"},
 	{"inactive_anon", "total_inactive_anon"},
 	{"active_anon", "total_active_anon"},
 	{"inactive_file", "total_inactive_file"},
@@ -3336,6 +3425,14 @@ static int mem_cgroup_get_local_stat(struct mem_cgroup *mem, void *data)
 		val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_SWAPOUT);
 		s->stat[MCS_SWAP] += val * PAGE_SIZE;
 	}
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_PGSCAN);
+	s->stat[MCS_PGSCAN] += val;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_PGSTEAL);
+	s->stat[MCS_PGSTEAL] += val;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_RES_CHARGE);
+	s->stat[MCS_RES_CHARGE] += val;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_RES_UNCHARGE);
+	s->stat[MCS_RES_UNCHARGE] += val;
 
 	/* per zone stat */
 	val = mem_cgroup_get_local_zonestat(mem, LRU_INACTIVE_ANON);
@@ -3787,6 +3884,188 @@ static int mem_cgroup_oom_control_write(struct cgroup *cgrp,
 	return 0;
 }
 
+/*
+ * Memory pressure notification.
+ *
+ * Reclaim reports how many pages it scanned and reclaimed on behalf of a
+ * memcg (global reclaim is accounted to the root).  Once a window's worth
+ * of pages has been scanned, the ratio of reclaimed to scanned pages is
+ * turned into a pressure level and the listeners registered for that
+ * level or a lower one are signalled.  Userspace can then free memory
+ * before the lowmemorykiller or the OOM killer has to.
+ */
+enum {
+	MEM_CGROUP_PRESSURE_LOW,
+	MEM_CGROUP_PRESSURE_MEDIUM,
+	MEM_CGROUP_PRESSURE_CRITICAL,
+	MEM_CGROUP_PRESSURE_NR,
+};
+
+static const char * const mem_cgroup_pressure_names[] = {
+	[MEM_CGROUP_PRESSURE_LOW]	= "low",
+	[MEM_CGROUP_PRESSURE_MEDIUM]	= "medium",
+	[MEM_CGROUP_PRESSURE_CRITICAL]	= "critical",
+};
+
+/* pages to scan before the pressure level is evaluated */
+#define MEM_CGROUP_PRESSURE_WIN		(SWAP_CLUSTER_MAX * 16)
+/* percentage of scanned pages that could not be reclaimed */
+#define MEM_CGROUP_PRESSURE_MEDIUM_PCT	60
+#define MEM_CGROUP_PRESSURE_CRITICAL_PCT	95
+
+static int mem_cgroup_pressure_level(unsigned long scanned,
+				     unsigned long reclaimed)
+{
+	unsigned long pressure;
+
+	/* lumpy reclaim may free more than it scanned */
+	if (reclaimed >= scanned)
+		return MEM_CGROUP_PRESSURE_LOW;
+
+	pressure = 100 - reclaimed * 100 / scanned;
+	if (pressure >= MEM_CGROUP_PRESSURE_CRITICAL_PCT)
+		return MEM_CGROUP_PRESSURE_CRITICAL;
+	if (pressure >= MEM_CGROUP_PRESSURE_MEDIUM_PCT)
+		return MEM_CGROUP_PRESSURE_MEDIUM;
+	return MEM_CGROUP_PRESSURE_LOW;
+}
+
+static bool mem_cgroup_pressure_signal(struct mem_cgroup *mem, int level)
+{
+	struct mem_cgroup_pressure_event *ev;
+	bool signalled = false;
+
+	mutex_lock(&mem->pressure_events_lock);
+	list_for_each_entry(ev, &mem->pressure_events, list) {
+		if (level < ev->level)
+			continue;
+		eventfd_signal(ev->eventfd, 1);
+		signalled = true;
+	}
+	mutex_unlock(&mem->pressure_events_lock);
+
+	return signalled;
+}
+
+static void mem_cgroup_pressure_work(struct work_struct *work)
+{
+	struct mem_cgroup *mem;
+	struct cgroup *cgrp;
+	unsigned long scanned, reclaimed;
+	int level;
+
+	mem = container_of(work, struct mem_cgroup, pressure_work);
+
+	spin_lock(&mem->pressure_lock);
+	scanned = mem->pressure_scanned;
+	reclaimed = mem->pressure_reclaimed;
+	mem->pressure_scanned = 0;
+	mem->pressure_reclaimed = 0;
+	spin_unlock(&mem->pressure_lock);
+
+	if (!scanned)
+		return;
+	level = mem_cgroup_pressure_level(scanned, reclaimed);
+
+	/*
+	 * Pressure in a group is pressure on its ancestors as well; pass
+	 * it up until somebody is listening.
+	 */
+	cgrp = mem->css.cgroup;
+	while (!mem_cgroup_pressure_signal(mem, level) && cgrp->parent) {
+		cgrp = cgrp->parent;
+		mem = mem_cgroup_from_cont(cgrp);
+	}
+}
+
+/*
+ * Called by reclaim after scanning a zone on behalf of @mem (NULL for
+ * global reclaim), with the number of pages it isolated from the LRU
+ * lists and tried to reclaim as @scanned.  Cheap enough for every call: the level is evaluated
+ * from a work item once the window is full.
+ */
+void mem_cgroup_vmpressure(struct mem_cgroup *mem, gfp_t gfp_mask,
+			   unsigned long scanned, unsigned long reclaimed)
+{
+	if (mem_cgroup_disabled() || !scanned)
+		return;
+
+	/*
+	 * Only count allocations that could be satisfied by reclaiming
+	 * ordinary user memory; e.g. GFP_NOIO reclaim says little about
+	 * the memory available to userspace.
+	 */
+	if (!(gfp_mask & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS)))
+		return;
+
+	if (!mem)
+		mem = root_mem_cgroup;
+	if (!mem)
+		return;
+
+	this_cpu_add(mem->stat->count[MEM_CGROUP_STAT_PGSCAN], scanned);
+	this_cpu_add(mem->stat->count[MEM_CGROUP_STAT_PGSTEAL], reclaimed);
+
+	spin_lock(&mem->pressure_lock);
+	mem->pressure_scanned += scanned;
+	mem->pressure_reclaimed += reclaimed;
+	scanned = mem->pressure_scanned;
+	spin_unlock(&mem->pressure_lock);
+
+	if (scanned >= MEM_CGROUP_PRESSURE_WIN)
+		schedule_work(&mem->pressure_work);
+}
+
+static int mem_cgroup_pressure_register_event(struct cgroup *cgrp,
+	struct cftype *cft, struct eventfd_ctx *eventfd, const char *args)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	struct mem_cgroup_pressure_event *event;
+	int type = MEMFILE_TYPE(cft->private);
+	int level;
+
+	BUG_ON(type != _PRESSURE_TYPE);
+	for (level = 0; level < MEM_CGROUP_PRESSURE_NR; level++)
+		if (!strcmp(args, mem_cgroup_pressure_names[level]))
+			break;
+	if (level == MEM_CGROUP_PRESSURE_NR)
+		return -EINVAL;
+
+	event = kmalloc(sizeof(*event), GFP_KERNEL);
+	if (!event)
+		return -ENOMEM;
+
+	event->eventfd = eventfd;
+	event->level = level;
+
+	mutex_lock(&memcg->pressure_events_lock);
+	list_add(&event->list, &memcg->pressure_events);
+	mutex_unlock(&memcg->pressure_events_lock);
+
+	return 0;
+}
+
+static void mem_cgroup_pressure_unregister_event(struct cgroup *cgrp,
+	struct cftype *cft, struct eventfd_ctx *eventfd)
+{
+	struct mem_cgroup *mem = mem_cgroup_from_cont(cgrp);
+	struct mem_cgroup_pressure_event *ev, *tmp;
+	int type = MEMFILE_TYPE(cft->private);
+
+	BUG_ON(type != _PRESSURE_TYPE);
+
+	mutex_lock(&mem->pressure_events_lock);
+
+	list_for_each_entry_safe(ev, tmp, &mem->pressure_events, list) {
+		if (ev->eventfd == eventfd) {
+			list_del(&ev->list);
+			kfree(ev);
+		}
+	}
+
+	mutex_unlock(&mem->pressure_events_lock);
+}
+
 static struct cftype mem_cgroup_files[] = {
 	{
 		.name = "usage_in_bytes",
@@ -3850,6 +4129,12 @@ static struct cftype mem_cgroup_files[] = {
 		.unregister_event = mem_cgroup_oom_unregister_event,
 		.private = MEMFILE_PRIVATE(_OOM_TYPE, OOM_CONTROL),
 	},
+	{
+		.name = "pressure_level",
+		.register_event = mem_cgroup_pressure_register_event,
+		.unregister_event = mem_cgroup_pressure_unregister_event,
+		.private = MEMFILE_PRIVATE(_PRESSURE_TYPE, 0),
+	},
 };
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
@@ -4107,6 +4392,10 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	mem->last_scanned_child = 0;
 	spin_lock_init(&mem->reclaim_param_lock);
 	INIT_LIST_HEAD(&mem->oom_notify);
+	spin_lock_init(&mem->pressure_lock);
+	INIT_WORK(&mem->pressure_work, mem_cgroup_pressure_work);
+	mutex_init(&mem->pressure_events_lock);
+	INIT_LIST_HEAD(&mem->pressure_events);
 
 	if (parent)
 		mem->swappiness = get_swappiness(parent);
@@ -4133,6 +4422,8 @@ static void mem_cgroup_destroy(struct cgroup_subsys *ss,
 {
 	struct mem_cgroup *mem = mem_cgroup_from_cont(cont);
 
+	/* the work walks up the cgroup, which is about to go away */
+	cancel_work_sync(&mem->pressure_work);
 	mem_cgroup_put(mem);
 }
 
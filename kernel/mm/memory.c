@@ -57,6 +57,7 @@
 #include <linux/swapops.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
+#include <linux/debugfs.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -2648,11 +2649,11 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto out;
 	}
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
-	page = lookup_swap_cache(entry);
+	page = lookup_swap_cache(entry, vma, address);
 	if (!page) {
 		grab_swap_token(mm); /* Contend for token _before_ read-in */
-		page = swapin_readahead(entry,
-					GFP_HIGHUSER_MOVABLE, vma, address);
+		page = swap_vma_readahead(entry, GFP_HIGHUSER_MOVABLE,
+					  vma, address, pmd);
 		if (!page) {
 			/*
 			 * Back out if somebody else faulted in this pte
@@ -2892,6 +2893,129 @@ oom:
 	return VM_FAULT_OOM;
 }
 
+/**
+ * do_set_pte - map a page cache page read-only
+ * @vma:	the vma @address belongs to
+ * @address:	the user virtual address to map @page at
+ * @page:	the page, whose reference is handed over to the pte
+ * @pte:	the empty pte for @address, with its lock held
+ */
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte)
+{
+	pte_t entry;
+
+	flush_icache_page(vma, page);
+	entry = mk_pte(page, vma->vm_page_prot);
+	inc_mm_counter_fast(vma->vm_mm, MM_FILEPAGES);
+	page_add_file_rmap(page);
+	set_pte_at(vma->vm_mm, address, pte, entry);
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+}
+
+/*
+ * Fault-around: on a read fault, map the neighbouring pages that are
+ * already in the page cache as well, up to fault_around_bytes aligned
+ * around the faulting address, and without crossing the vma or the
+ * page table.  Programs touching a freshly mmapped file then take one
+ * fault per window instead of one per page.
+ */
+static unsigned long fault_around_bytes __read_mostly = 65536;
+
+static inline unsigned long fault_around_pages(void)
+{
+	return fault_around_bytes >> PAGE_SHIFT;
+}
+
+static inline unsigned long fault_around_mask(void)
+{
+	return ~(fault_around_bytes - 1) & PAGE_MASK;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int fault_around_bytes_get(void *data, u64 *val)
+{
+	*val = fault_around_bytes;
+	return 0;
+}
+
+/*
+ * fault_around_bytes must be a power of two and must not be larger than
+ * what one page table maps.  PAGE_SIZE turns fault-around off.
+ */
+static int fault_around_bytes_set(void *data, u64 val)
+{
+	if (val / PAGE_SIZE > PTRS_PER_PTE)
+		return -EINVAL;
+	if (val > PAGE_SIZE)
+		fault_around_bytes = rounddown_pow_of_two(val);
+	else
+		fault_around_bytes = PAGE_SIZE;
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(fault_around_bytes_fops,
+		fault_around_bytes_get, fault_around_bytes_set, "%llu\n");
+
+static int __init fault_around_debugfs(void)
+{
+	debugfs_create_file("fault_around_bytes", 0644, NULL, NULL,
+			    &fault_around_bytes_fops);
+	return 0;
+}
+late_initcall(fault_around_debugfs);
+#endif
+
+/*
+ * Called with the page table lock held and @pte pointing to the pte of
+ * the faulting @address, which is at @pgoff in the file.
+ */
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+			    pte_t *pte, pgoff_t pgoff, unsigned int flags)
+{
+	unsigned long start_addr;
+	pgoff_t max_pgoff;
+	struct vm_fault vmf;
+	int off;
+
+	start_addr = max(address & fault_around_mask(), vma->vm_start);
+	off = ((address - start_addr) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1);
+	pte -= off;
+	pgoff -= off;
+
+	/*
+	 * max_pgoff is the nearest of the end of the page table, the end of
+	 * the vma and the end of the fault-around window.
+	 */
+	max_pgoff = pgoff - ((start_addr >> PAGE_SHIFT) & (PTRS_PER_PTE - 1)) +
+		PTRS_PER_PTE - 1;
+	max_pgoff = min_t(pgoff_t, max_pgoff,
+			  vma_pages(vma) + vma->vm_pgoff - 1);
+	max_pgoff = min_t(pgoff_t, max_pgoff,
+			  pgoff + fault_around_pages() - 1);
+
+	/* Skip the ptes that are already populated */
+	while (!pte_none(*pte)) {
+		if (++pgoff > max_pgoff)
+			return;
+		start_addr += PAGE_SIZE;
+		if (start_addr >= vma->vm_end)
+			return;
+		pte++;
+	}
+
+	vmf.virtual_address = (void __user *)start_addr;
+	vmf.pte = pte;
+	vmf.pgoff = pgoff;
+	vmf.max_pgoff = max_pgoff;
+	vmf.flags = flags;
+	vmf.page = NULL;
+	vma->vm_ops->map_pages(vma, &vmf);
+
+	count_vm_event(FAULT_AROUND);
+}
+
 /*
  * __do_fault() tries to create a new page mapping. It aggressively
  * tries to share with existing pages, but makes a separate copy if
@@ -2920,6 +3044,21 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	int ret;
 	int page_mkwrite = 0;
 
+	/*
+	 * Map what is already cached around a read fault first.  If that
+	 * covered the faulting address too, there is nothing left to do.
+	 */
+	if (!(flags & (FAULT_FLAG_WRITE | FAULT_FLAG_NONLINEAR)) &&
+	    vma->vm_ops->map_pages && fault_around_pages() > 1) {
+		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+		do_fault_around(vma, address, page_table, pgoff, flags);
+		if (!pte_same(*page_table, orig_pte)) {
+			pte_unmap_unlock(page_table, ptl);
+			return 0;
+		}
+		pte_unmap_unlock(page_table, ptl);
+	}
+
 	vmf.virtual_address = (void __user *)(address & PAGE_MASK);
 	vmf.pgoff = pgoff;
 	vmf.flags = flags;
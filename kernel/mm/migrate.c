@@ -547,7 +547,7 @@ static int move_to_new_page(struct page *newpage, struct page *page,
  * to the newly allocated page in newpage.
  */
 static int unmap_and_move(new_page_t get_new_page, unsigned long private,
-			struct page *page, int force, int offlining)
+			struct page *page, int force, int offlining, bool sync)
 {
 	int rc = 0;
 	int *result = NULL;
@@ -570,7 +570,7 @@ static int unmap_and_move(new_page_t get_new_page, unsigned long private,
 	rc = -EAGAIN;
 
 	if (!trylock_page(page)) {
-		if (!force)
+		if (!force || !sync)
 			goto move_newpage;
 		lock_page(page);
 	}
@@ -598,7 +598,7 @@ static int unmap_and_move(new_page_t get_new_page, unsigned long private,
 	BUG_ON(charge);
 
 	if (PageWriteback(page)) {
-		if (!force)
+		if (!force || !sync)
 			goto uncharge;
 		wait_on_page_writeback(page);
 	}
@@ -739,10 +739,13 @@ move_newpage:
  * or no retryable pages exist anymore. All pages will be
  * returned to the LRU or freed.
  *
+ * If sync is false, pages that are locked or under writeback are
+ * skipped rather than waited on.
+ *
  * Return: Number of pages not migrated or error code.
  */
-int migrate_pages(struct list_head *from,
-		new_page_t get_new_page, unsigned long private, int offlining)
+int migrate_pages(struct list_head *from, new_page_t get_new_page,
+		unsigned long private, int offlining, bool sync)
 {
 	int retry = 1;
 	int nr_failed = 0;
@@ -762,7 +765,7 @@ int migrate_pages(struct list_head *from,
 			cond_resched();
 
 			rc = unmap_and_move(get_new_page, private,
-						page, pass > 2, offlining);
+						page, pass > 2, offlining, sync);
 
 			switch(rc) {
 			case -ENOMEM:
@@ -896,7 +899,7 @@ set_status:
 	err = 0;
 	if (!list_empty(&pagelist))
 		err = migrate_pages(&pagelist, new_page_node,
-				(unsigned long)pm, 0);
+				(unsigned long)pm, 0, true);
 
 	up_read(&mm->mmap_sem);
 	return err;
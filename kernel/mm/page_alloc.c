@@ -50,6 +50,8 @@
 #include <linux/kmemleak.h>
 #include <linux/memory.h>
 #include <linux/compaction.h>
+#include <linux/migrate.h>
+#include <linux/mm_inline.h>
 #include <trace/events/kmem.h>
 #include <linux/ftrace_event.h>
 
@@ -94,6 +96,13 @@ unsigned long totalreserve_pages __read_mostly;
 int percpu_pagelist_fraction;
 gfp_t gfp_allowed_mask __read_mostly = GFP_BOOT_MASK;
 
+/*
+ * High watermark and batch size, in blocks, of the per-cpu lists of
+ * order 1 to PCP_MAX_ORDER. Tunable in /sys/kernel/mm/pcp_high_order.
+ */
+static int pcp_order_high[PCP_MAX_ORDER] = { 16, 8, 4 };
+static int pcp_order_batch[PCP_MAX_ORDER] = { 4, 2, 1 };
+
 #ifdef CONFIG_PM_SLEEP
 /*
  * The following functions are used by the suspend/hibernate code to temporarily
@@ -573,6 +582,33 @@ static inline int free_pages_check(struct page *page)
 	return 0;
 }
 
+/*
+ * Pages on the per-cpu lists remember the migratetype of their pageblock
+ * in page_private(), but the pageblock may have been isolated since.  A
+ * borrowed CMA page must not go back to the CMA free list then.
+ */
+static inline int pcp_page_migratetype(struct page *page)
+{
+#ifdef CONFIG_CMA_MIGRATE
+	if (unlikely(get_pageblock_migratetype(page) == MIGRATE_ISOLATE))
+		return MIGRATE_ISOLATE;
+#endif
+	return page_private(page);
+}
+
+/*
+ * Account for pages of @migratetype added to (nr_pages > 0) or taken off
+ * the free lists.  Free CMA pages are counted separately as well, since
+ * only movable allocations can use them.
+ */
+static inline void __mod_zone_freepage_state(struct zone *zone, int nr_pages,
+					     int migratetype)
+{
+	__mod_zone_page_state(zone, NR_FREE_PAGES, nr_pages);
+	if (is_migrate_cma(migratetype))
+		__mod_zone_page_state(zone, NR_FREE_CMA_PAGES, nr_pages);
+}
+
 /*
  * Frees a number of pages from the PCP lists
  * Assumes all pages on list are in same zone, and of same order.
@@ -590,6 +626,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	int migratetype = 0;
 	int batch_free = 0;
 	int to_free = count;
+	int nr_cma = 0;
 
 	spin_lock(&zone->lock);
 	zone->all_unreclaimable = 0;
@@ -614,15 +651,21 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 		} while (list_empty(list));
 
 		do {
+			int mt;
+
 			page = list_entry(list->prev, struct page, lru);
 			/* must delete as __free_one_page list manipulates */
 			list_del(&page->lru);
 			/* MIGRATE_MOVABLE list may include MIGRATE_RESERVEs */
-			__free_one_page(page, zone, 0, page_private(page));
+			mt = pcp_page_migratetype(page);
+			__free_one_page(page, zone, 0, mt);
+			if (is_migrate_cma(mt))
+				nr_cma++;
 			trace_mm_page_pcpu_drain(page, 0, page_private(page));
 		} while (--to_free && --batch_free && !list_empty(list));
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, count);
+	__mod_zone_page_state(zone, NR_FREE_CMA_PAGES, nr_cma);
 	spin_unlock(&zone->lock);
 }
 
@@ -634,10 +677,97 @@ static void free_one_page(struct zone *zone, struct page *page, int order,
 	zone->pages_scanned = 0;
 
 	__free_one_page(page, zone, order, migratetype);
-	__mod_zone_page_state(zone, NR_FREE_PAGES, 1 << order);
+	__mod_zone_freepage_state(zone, 1 << order, migratetype);
+	spin_unlock(&zone->lock);
+}
+
+/*
+ * Return count blocks of the given order from the per-cpu lists to the
+ * buddy allocator. Called with interrupts disabled.
+ */
+static void free_pcp_order_bulk(struct zone *zone, unsigned int order,
+				int count, struct per_cpu_pages_order *pcpo)
+{
+	int migratetype = 0;
+	int to_free = count;
+	int nr_cma = 0;
+
+	spin_lock(&zone->lock);
+	zone->all_unreclaimable = 0;
+	zone->pages_scanned = 0;
+
+	while (to_free) {
+		struct list_head *list = &pcpo->lists[migratetype];
+		struct page *page;
+		int mt;
+
+		if (list_empty(list)) {
+			if (++migratetype == MIGRATE_PCPTYPES)
+				migratetype = 0;
+			continue;
+		}
+
+		page = list_entry(list->prev, struct page, lru);
+		list_del(&page->lru);
+		/* MIGRATE_MOVABLE list may include MIGRATE_RESERVEs */
+		mt = pcp_page_migratetype(page);
+		__free_one_page(page, zone, order, mt);
+		if (is_migrate_cma(mt))
+			nr_cma++;
+		trace_mm_page_pcpu_drain(page, order, page_private(page));
+		to_free--;
+	}
+	pcpo->count -= count;
+	__mod_zone_page_state(zone, NR_FREE_PAGES, count << order);
+	__mod_zone_page_state(zone, NR_FREE_CMA_PAGES, nr_cma << order);
 	spin_unlock(&zone->lock);
 }
 
+/* Empty all the high-order per-cpu lists of pcp. */
+static void drain_pcp_orders(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	int order;
+
+	for (order = 1; order <= PCP_MAX_ORDER; order++) {
+		struct per_cpu_pages_order *pcpo = &pcp->orders[order - 1];
+
+		if (pcpo->count)
+			free_pcp_order_bulk(zone, order, pcpo->count, pcpo);
+	}
+}
+
+/*
+ * Put a block of order 1 to PCP_MAX_ORDER on this cpu's list for its
+ * order, spilling a batch back to the buddy allocator when the list
+ * grows above its high watermark. Called with interrupts disabled.
+ * Returns false if the block must go straight to the buddy allocator.
+ */
+static bool free_pcp_order(struct zone *zone, struct page *page,
+			unsigned int order, int migratetype)
+{
+	struct per_cpu_pages_order *pcpo;
+
+	pcpo = &this_cpu_ptr(zone->pageset)->pcp.orders[order - 1];
+	if (!pcpo->high)
+		return false;
+
+	/* See free_hot_cold_page() */
+	if (migratetype >= MIGRATE_PCPTYPES) {
+		if (unlikely(migratetype == MIGRATE_ISOLATE))
+			return false;
+		set_page_private(page, migratetype);
+		migratetype = MIGRATE_MOVABLE;
+	} else
+		set_page_private(page, migratetype);
+
+	list_add(&page->lru, &pcpo->lists[migratetype]);
+	pcpo->count++;
+	if (pcpo->count >= pcpo->high)
+		free_pcp_order_bulk(zone, order, pcpo->batch, pcpo);
+
+	return true;
+}
+
 static bool free_pages_prepare(struct page *page, unsigned int order)
 {
 	int i;
@@ -670,17 +800,20 @@ static bool free_pages_prepare(struct page *page, unsigned int order)
 static void __free_pages_ok(struct page *page, unsigned int order)
 {
 	unsigned long flags;
+	int migratetype;
 	int wasMlocked = __TestClearPageMlocked(page);
 
 	if (!free_pages_prepare(page, order))
 		return;
 
+	migratetype = get_pageblock_migratetype(page);
 	local_irq_save(flags);
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
-					get_pageblock_migratetype(page));
+	if (order > PCP_MAX_ORDER ||
+	    !free_pcp_order(page_zone(page), page, order, migratetype))
+		free_one_page(page_zone(page), page, order, migratetype);
 	local_irq_restore(flags);
 }
 
@@ -817,13 +950,20 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
 
 /*
  * This array describes the order lists are fallen back to when
- * the free lists for the desirable migrate type are depleted
+ * the free lists for the desirable migrate type are depleted.
+ * Each list ends with MIGRATE_RESERVE.
  */
-static int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES-1] = {
-	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
-	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,   MIGRATE_RESERVE }, /* Never used */
+static int fallbacks[MIGRATE_TYPES][4] = {
+	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+#ifdef CONFIG_CMA_MIGRATE
+	[MIGRATE_MOVABLE]     = { MIGRATE_CMA,         MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
+	[MIGRATE_CMA]         = { MIGRATE_RESERVE }, /* Never used */
+#else
+	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE,   MIGRATE_RESERVE },
+#endif
+	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE }, /* Never used */
+	[MIGRATE_ISOLATE]     = { MIGRATE_RESERVE }, /* Never used */
 };
 
 /*
@@ -919,12 +1059,12 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 	/* Find the largest possible block of pages in the other list */
 	for (current_order = MAX_ORDER-1; current_order >= order;
 						--current_order) {
-		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+		for (i = 0;; i++) {
 			migratetype = fallbacks[start_migratetype][i];
 
 			/* MIGRATE_RESERVE handled later if necessary */
 			if (migratetype == MIGRATE_RESERVE)
-				continue;
+				break;
 
 			area = &(zone->free_area[current_order]);
 			if (list_empty(&area->free_list[migratetype]))
@@ -938,11 +1078,13 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			 * If breaking a large block of pages, move all free
 			 * pages to the preferred allocation list. If falling
 			 * back for a reclaimable kernel allocation, be more
-			 * agressive about taking ownership of free pages
+			 * agressive about taking ownership of free pages.
+			 * CMA pageblocks are only borrowed, never taken.
 			 */
-			if (unlikely(current_order >= (pageblock_order >> 1)) ||
+			if (!is_migrate_cma(migratetype) &&
+			    (unlikely(current_order >= (pageblock_order >> 1)) ||
 					start_migratetype == MIGRATE_RECLAIMABLE ||
-					page_group_by_mobility_disabled) {
+					page_group_by_mobility_disabled)) {
 				unsigned long pages;
 				pages = move_freepages_block(zone, page,
 								start_migratetype);
@@ -961,7 +1103,8 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			rmv_page_order(page);
 
 			/* Take ownership for orders >= pageblock_order */
-			if (current_order >= pageblock_order)
+			if (current_order >= pageblock_order &&
+					!is_migrate_cma(migratetype))
 				change_pageblock_range(page, current_order,
 							start_migratetype);
 
@@ -1016,7 +1159,7 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			unsigned long count, struct list_head *list,
 			int migratetype, int cold)
 {
-	int i;
+	int i, mt, nr_cma = 0;
 	
 	spin_lock(&zone->lock);
 	for (i = 0; i < count; ++i) {
@@ -1037,10 +1180,17 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			list_add(&page->lru, list);
 		else
 			list_add_tail(&page->lru, list);
-		set_page_private(page, migratetype);
+		/* Borrowed CMA pages must go back to the CMA lists */
+		mt = get_pageblock_migratetype(page);
+		if (is_migrate_cma(mt)) {
+			set_page_private(page, mt);
+			nr_cma++;
+		} else
+			set_page_private(page, migratetype);
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
+	__mod_zone_page_state(zone, NR_FREE_CMA_PAGES, -(nr_cma << order));
 	spin_unlock(&zone->lock);
 	return i;
 }
@@ -1092,6 +1242,7 @@ static void drain_pages(unsigned int cpu)
 		pcp = &pset->pcp;
 		free_pcppages_bulk(zone, pcp->count, pcp);
 		pcp->count = 0;
+		drain_pcp_orders(zone, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1258,13 +1409,15 @@ int split_free_page(struct page *page)
 	list_del(&page->lru);
 	zone->free_area[order].nr_free--;
 	rmv_page_order(page);
-	__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+	__mod_zone_freepage_state(zone, -(1UL << order),
+				  get_pageblock_migratetype(page));
 
 	/* Split into individual pages */
 	set_page_refcounted(page);
 	split_page(page, order);
 
-	if (order >= pageblock_order - 1) {
+	if (order >= pageblock_order - 1 &&
+	    !is_migrate_cma(get_pageblock_migratetype(page))) {
 		struct page *endpage = page + (1 << order) - 1;
 		for (; page < endpage; page += pageblock_nr_pages)
 			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
@@ -1273,6 +1426,41 @@ int split_free_page(struct page *page)
 	return 1 << order;
 }
 
+/*
+ * Take a block of order 1 to PCP_MAX_ORDER from this cpu's list for its
+ * order, refilling the list by a batch if it is empty. Called with
+ * interrupts disabled.
+ */
+static struct page *rmqueue_pcp_order(struct zone *zone, unsigned int order,
+				int migratetype, int cold)
+{
+	struct per_cpu_pages_order *pcpo;
+	struct list_head *list;
+	struct page *page;
+
+	pcpo = &this_cpu_ptr(zone->pageset)->pcp.orders[order - 1];
+	if (!pcpo->high)
+		return NULL;
+
+	list = &pcpo->lists[migratetype];
+	if (list_empty(list)) {
+		pcpo->count += rmqueue_bulk(zone, order, pcpo->batch, list,
+					migratetype, cold);
+		if (unlikely(list_empty(list)))
+			return NULL;
+	}
+
+	if (cold)
+		page = list_entry(list->prev, struct page, lru);
+	else
+		page = list_entry(list->next, struct page, lru);
+
+	list_del(&page->lru);
+	pcpo->count--;
+
+	return page;
+}
+
 /*
  * Really, prep_compound_page() should be called from __rmqueue_bulk().  But
  * we cheat by calling it from here, in the order > 0 path.  Saves a branch
@@ -1324,12 +1512,19 @@ again:
 			 */
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
-		page = __rmqueue(zone, order, migratetype);
-		spin_unlock(&zone->lock);
-		if (!page)
-			goto failed;
-		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1 << order));
+		local_irq_save(flags);
+		page = NULL;
+		if (order <= PCP_MAX_ORDER)
+			page = rmqueue_pcp_order(zone, order, migratetype, cold);
+		if (!page) {
+			spin_lock(&zone->lock);
+			page = __rmqueue(zone, order, migratetype);
+			spin_unlock(&zone->lock);
+			if (!page)
+				goto failed;
+			__mod_zone_freepage_state(zone, -(1 << order),
+					get_pageblock_migratetype(page));
+		}
 	}
 
 	__count_zone_vm_events(PGALLOC, zone, 1 << order);
@@ -1358,6 +1553,7 @@ failed:
 #define ALLOC_HARDER		0x10 /* try to alloc harder */
 #define ALLOC_HIGH		0x20 /* __GFP_HIGH set */
 #define ALLOC_CPUSET		0x40 /* check for correct cpuset */
+#define ALLOC_CMA		0x80 /* may use free pages lent by CMA */
 
 #ifdef CONFIG_FAIL_PAGE_ALLOC
 
@@ -1466,6 +1662,10 @@ int zone_watermark_ok(struct zone *z, int order, unsigned long mark,
 	long free_pages = zone_nr_free_pages(z) - (1 << order) + 1;
 	int o;
 
+	/* Only movable allocations can use the free pages lent by CMA */
+	if (!(alloc_flags & ALLOC_CMA))
+		free_pages -= zone_page_state(z, NR_FREE_CMA_PAGES);
+
 	if (alloc_flags & ALLOC_HIGH)
 		min -= min / 2;
 	if (alloc_flags & ALLOC_HARDER)
@@ -1785,15 +1985,21 @@ static struct page *
 __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	struct zonelist *zonelist, enum zone_type high_zoneidx,
 	nodemask_t *nodemask, int alloc_flags, struct zone *preferred_zone,
-	int migratetype, unsigned long *did_some_progress)
+	int migratetype, unsigned long *did_some_progress,
+	bool sync_migration)
 {
 	struct page *page;
 
-	if (!order || compaction_deferred(preferred_zone))
+	if (!order)
+		return NULL;
+
+	if (compaction_deferred(preferred_zone)) {
+		count_vm_event(COMPACTDEFERRED);
 		return NULL;
+	}
 
 	*did_some_progress = try_to_compact_pages(zonelist, order, gfp_mask,
-								nodemask);
+						nodemask, sync_migration);
 	if (*did_some_progress != COMPACT_SKIPPED) {
 
 		/* Page migration frees to the PCP lists but we want merging */
@@ -1829,7 +2035,8 @@ static inline struct page *
 __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	struct zonelist *zonelist, enum zone_type high_zoneidx,
 	nodemask_t *nodemask, int alloc_flags, struct zone *preferred_zone,
-	int migratetype, unsigned long *did_some_progress)
+	int migratetype, unsigned long *did_some_progress,
+	bool sync_migration)
 {
 	return NULL;
 }
@@ -1956,6 +2163,9 @@ gfp_to_alloc_flags(gfp_t gfp_mask)
 			alloc_flags |= ALLOC_NO_WATERMARKS;
 	}
 
+	if (allocflags_to_migratetype(gfp_mask) == MIGRATE_MOVABLE)
+		alloc_flags |= ALLOC_CMA;
+
 	return alloc_flags;
 }
 
@@ -1970,6 +2180,7 @@ __alloc_pages_slowpath(gfp_t gfp_mask, unsigned int order,
 	int alloc_flags;
 	unsigned long pages_reclaimed = 0;
 	unsigned long did_some_progress;
+	bool sync_migration = false;
 	struct task_struct *p = current;
 
 	/*
@@ -2033,14 +2244,20 @@ rebalance:
 	if (test_thread_flag(TIF_MEMDIE) && !(gfp_mask & __GFP_NOFAIL))
 		goto nopage;
 
-	/* Try direct compaction */
+	/*
+	 * Try direct compaction. The first attempt is asynchronous and
+	 * skips pages it would have to wait for, so the allocation does
+	 * not stall on IO before reclaim has had a go.
+	 */
 	page = __alloc_pages_direct_compact(gfp_mask, order,
 					zonelist, high_zoneidx,
 					nodemask,
 					alloc_flags, preferred_zone,
-					migratetype, &did_some_progress);
+					migratetype, &did_some_progress,
+					sync_migration);
 	if (page)
 		goto got_pg;
+	sync_migration = true;
 
 	/* Try direct reclaim and then allocating */
 	page = __alloc_pages_direct_reclaim(gfp_mask, order,
@@ -2086,6 +2303,20 @@ rebalance:
 		/* Wait for some write requests to complete then retry */
 		congestion_wait(BLK_RW_ASYNC, HZ/50);
 		goto rebalance;
+	} else {
+		/*
+		 * High-order allocations do not necessarily loop after
+		 * direct reclaim, so give synchronous compaction a go on
+		 * what reclaim has freed before failing
+		 */
+		page = __alloc_pages_direct_compact(gfp_mask, order,
+					zonelist, high_zoneidx,
+					nodemask,
+					alloc_flags, preferred_zone,
+					migratetype, &did_some_progress,
+					sync_migration);
+		if (page)
+			goto got_pg;
 	}
 
 nopage:
@@ -2115,6 +2346,7 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 	struct zone *preferred_zone;
 	struct page *page;
 	int migratetype = allocflags_to_migratetype(gfp_mask);
+	int alloc_flags = ALLOC_WMARK_LOW|ALLOC_CPUSET;
 
 	gfp_mask &= gfp_allowed_mask;
 
@@ -2141,9 +2373,12 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 		return NULL;
 	}
 
+	if (migratetype == MIGRATE_MOVABLE)
+		alloc_flags |= ALLOC_CMA;
+
 	/* First allocation attempt */
 	page = get_page_from_freelist(gfp_mask|__GFP_HARDWALL, nodemask, order,
-			zonelist, high_zoneidx, ALLOC_WMARK_LOW|ALLOC_CPUSET,
+			zonelist, high_zoneidx, alloc_flags,
 			preferred_zone, migratetype);
 	if (unlikely(!page))
 		page = __alloc_pages_slowpath(gfp_mask, order,
@@ -3362,6 +3597,7 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
 	int migratetype;
+	int order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -3371,6 +3607,18 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+
+	for (order = 1; order <= PCP_MAX_ORDER; order++) {
+		struct per_cpu_pages_order *pcpo = &pcp->orders[order - 1];
+
+		/* The boot pagesets (batch 0) must not keep anything */
+		pcpo->count = 0;
+		pcpo->high = batch ? pcp_order_high[order - 1] : 0;
+		pcpo->batch = pcp_order_batch[order - 1];
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+							migratetype++)
+			INIT_LIST_HEAD(&pcpo->lists[migratetype]);
+	}
 }
 
 /*
@@ -3478,6 +3726,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		drain_pcp_orders(zone, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -4063,6 +4312,10 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+	pgdat->kcompactd_max_order = 0;
+#endif
 	pgdat_page_cgroup_init(pgdat);
 	
 	for (j = 0; j < MAX_NR_ZONES; j++) {
@@ -4128,6 +4381,7 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 		zone->reclaim_stat.recent_rotated[1] = 0;
 		zone->reclaim_stat.recent_scanned[0] = 0;
 		zone->reclaim_stat.recent_scanned[1] = 0;
+		lru_gen_init_zone(zone);
 		zap_zone_vm_stats(zone);
 		zone->flags = 0;
 		if (!size)
@@ -5096,6 +5350,128 @@ int percpu_pagelist_fraction_sysctl_handler(ctl_table *table, int write,
 	return 0;
 }
 
+#ifdef CONFIG_SYSFS
+/*
+ * /sys/kernel/mm/pcp_high_order/order<N>_{high,batch}: watermarks of the
+ * per-cpu lists of order N blocks. Writing 0 to a high watermark stops
+ * caching that order.
+ */
+static DEFINE_MUTEX(pcp_order_mutex);
+
+struct pcp_order_attr {
+	struct kobj_attribute attr;
+	int *values;
+	int order;
+};
+
+static void pcp_order_apply(int order)
+{
+	struct zone *zone;
+	unsigned int cpu;
+
+	for_each_populated_zone(zone) {
+		for_each_possible_cpu(cpu) {
+			struct per_cpu_pages_order *pcpo;
+
+			pcpo = &per_cpu_ptr(zone->pageset, cpu)->pcp.orders[order - 1];
+			pcpo->high = pcp_order_high[order - 1];
+			pcpo->batch = pcp_order_batch[order - 1];
+		}
+	}
+
+	/* Lists above a lowered watermark only shrink on the next free */
+	drain_all_pages();
+}
+
+static ssize_t pcp_order_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	struct pcp_order_attr *pa = container_of(attr, struct pcp_order_attr,
+						 attr);
+
+	return sprintf(buf, "%d\n", pa->values[pa->order - 1]);
+}
+
+static ssize_t pcp_order_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct pcp_order_attr *pa = container_of(attr, struct pcp_order_attr,
+						 attr);
+	int idx = pa->order - 1;
+	unsigned long val;
+	int high, batch;
+	int err;
+
+	err = strict_strtoul(buf, 10, &val);
+	if (err || val > INT_MAX)
+		return -EINVAL;
+
+	mutex_lock(&pcp_order_mutex);
+	high = pcp_order_high[idx];
+	batch = pcp_order_batch[idx];
+	if (pa->values == pcp_order_high)
+		high = val;
+	else
+		batch = val;
+
+	/* A batch must fit below the watermark it drains at */
+	if (batch < 1 || (high && high < batch)) {
+		mutex_unlock(&pcp_order_mutex);
+		return -EINVAL;
+	}
+
+	pcp_order_high[idx] = high;
+	pcp_order_batch[idx] = batch;
+	pcp_order_apply(pa->order);
+	mutex_unlock(&pcp_order_mutex);
+
+	return count;
+}
+
+#define PCP_ORDER_ATTR(_order, _name)					\
+	static struct pcp_order_attr pcp_order##_order##_##_name##_attr = { \
+		.attr = __ATTR(order##_order##_##_name, 0644,		\
+			       pcp_order_show, pcp_order_store),	\
+		.values = pcp_order_##_name,				\
+		.order = _order,					\
+	}
+
+PCP_ORDER_ATTR(1, high);
+PCP_ORDER_ATTR(1, batch);
+PCP_ORDER_ATTR(2, high);
+PCP_ORDER_ATTR(2, batch);
+PCP_ORDER_ATTR(3, high);
+PCP_ORDER_ATTR(3, batch);
+
+static struct attribute *pcp_order_attrs[] = {
+	&pcp_order1_high_attr.attr.attr,
+	&pcp_order1_batch_attr.attr.attr,
+	&pcp_order2_high_attr.attr.attr,
+	&pcp_order2_batch_attr.attr.attr,
+	&pcp_order3_high_attr.attr.attr,
+	&pcp_order3_batch_attr.attr.attr,
+	NULL,
+};
+
+static struct attribute_group pcp_order_attr_group = {
+	.attrs = pcp_order_attrs,
+	.name = "pcp_high_order",
+};
+
+static int __init pcp_order_sysfs_init(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &pcp_order_attr_group);
+	if (err)
+		printk(KERN_ERR "pcp: register sysfs failed\n");
+
+	return 0;
+}
+late_initcall(pcp_order_sysfs_init);
+#endif /* CONFIG_SYSFS */
+
 int hashdist = HASHDIST_DEFAULT;
 
 #ifdef CONFIG_NUMA
@@ -5303,6 +5679,7 @@ int set_migratetype_isolate(struct page *page)
 
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE ||
+	    is_migrate_cma(get_pageblock_migratetype(page)) ||
 	    zone_idx == ZONE_MOVABLE) {
 		ret = 0;
 		goto out;
@@ -5345,8 +5722,13 @@ int set_migratetype_isolate(struct page *page)
 
 out:
 	if (!ret) {
+		int old_migratetype = get_pageblock_migratetype(page);
+		int moved;
+
 		set_pageblock_migratetype(page, MIGRATE_ISOLATE);
-		move_freepages_block(zone, page, MIGRATE_ISOLATE);
+		moved = move_freepages_block(zone, page, MIGRATE_ISOLATE);
+		if (is_migrate_cma(old_migratetype))
+			__mod_zone_page_state(zone, NR_FREE_CMA_PAGES, -moved);
 	}
 
 	spin_unlock_irqrestore(&zone->lock, flags);
@@ -5355,20 +5737,219 @@ out:
 	return ret;
 }
 
-void unset_migratetype_isolate(struct page *page)
+void unset_migratetype_isolate(struct page *page, unsigned migratetype)
 {
 	struct zone *zone;
 	unsigned long flags;
+	int moved;
+
 	zone = page_zone(page);
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
-	set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-	move_freepages_block(zone, page, MIGRATE_MOVABLE);
+	set_pageblock_migratetype(page, migratetype);
+	moved = move_freepages_block(zone, page, migratetype);
+	if (is_migrate_cma(migratetype))
+		__mod_zone_page_state(zone, NR_FREE_CMA_PAGES, moved);
 out:
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
+#ifdef CONFIG_CMA_MIGRATE
+/*
+ * CMA regions that lend their memory hand their pageblocks to the buddy
+ * allocator as MIGRATE_CMA at boot.  alloc_contig_range() takes a range
+ * of them back: it isolates the pageblocks so that nothing new is
+ * allocated there, migrates the pages in use elsewhere and then takes the
+ * free pages off the free lists.
+ *
+ * Lent memory is aligned to CONTIG_ALIGN_PAGES, so that free pages of
+ * other migratetypes never merge with it.
+ */
+#define CONTIG_ALIGN_PAGES	max_t(unsigned long, MAX_ORDER_NR_PAGES, \
+				      pageblock_nr_pages)
+#define CONTIG_MIGRATE_PASSES	5
+
+/* Give a pageblock reserved at boot to the buddy allocator. */
+void __init init_cma_reserved_pageblock(struct page *page)
+{
+	unsigned i = pageblock_nr_pages;
+	struct page *p = page;
+
+	do {
+		__ClearPageReserved(p);
+		set_page_count(p, 0);
+	} while (++p, --i);
+
+	set_page_refcounted(page);
+	set_pageblock_migratetype(page, MIGRATE_CMA);
+	__free_pages(page, pageblock_order);
+	totalram_pages += pageblock_nr_pages;
+#ifdef CONFIG_HIGHMEM
+	if (PageHighMem(page))
+		totalhigh_pages += pageblock_nr_pages;
+#endif
+}
+
+static struct page *
+alloc_contig_migrate_alloc(struct page *page, unsigned long private, int **x)
+{
+	return alloc_page(GFP_HIGHUSER_MOVABLE);
+}
+
+/*
+ * Migrate the LRU pages in [start, end) elsewhere.  Returns the number of
+ * pages migrated; whatever could not be moved is caught when the range is
+ * taken off the free lists.
+ */
+static int alloc_contig_migrate_range(unsigned long start, unsigned long end)
+{
+	unsigned long pfn;
+	struct page *page;
+	int pass, isolated, failed;
+	int migrated = 0;
+	LIST_HEAD(source);
+
+	/* Flush the per-cpu pagevecs so that every page is on the LRU */
+	migrate_prep();
+
+	for (pass = 0; pass < CONTIG_MIGRATE_PASSES; pass++) {
+		isolated = 0;
+		for (pfn = start; pfn < end; pfn++) {
+			if (!pfn_valid_within(pfn))
+				continue;
+			page = pfn_to_page(pfn);
+			if (!page_count(page) || !PageLRU(page))
+				continue;
+			if (isolate_lru_page(page))
+				continue;
+			list_add_tail(&page->lru, &source);
+			inc_zone_page_state(page, NR_ISOLATED_ANON +
+					    page_is_file_cache(page));
+			isolated++;
+		}
+		if (!isolated)
+			break;
+
+		/* Pages that could not be migrated go back to the LRU */
+		failed = migrate_pages(&source, alloc_contig_migrate_alloc,
+				       0, 0, true);
+		if (failed < 0)
+			break;
+		migrated += isolated - failed;
+	}
+	return migrated;
+}
+
+/*
+ * Take the free pages in [start, end) off the free lists, as order 0
+ * pages with one reference each.  The range must be isolated.  Returns
+ * the pfn after the last page taken, which may be past @end if a free
+ * page straddles it, or 0 if some page in the range is not free.
+ */
+static unsigned long take_isolated_free_range(struct zone *zone,
+				unsigned long start, unsigned long end)
+{
+	unsigned long flags, pfn = start;
+	struct page *page;
+	int order;
+
+	spin_lock_irqsave(&zone->lock, flags);
+	while (pfn < end) {
+		page = pfn_to_page(pfn);
+		if (!PageBuddy(page))
+			break;
+
+		order = page_order(page);
+		list_del(&page->lru);
+		rmv_page_order(page);
+		zone->free_area[order].nr_free--;
+		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+		set_page_refcounted(page);
+		split_page(page, order);
+		pfn += 1UL << order;
+	}
+	spin_unlock_irqrestore(&zone->lock, flags);
+
+	for (page = pfn_to_page(start); page < pfn_to_page(pfn); page++) {
+		arch_alloc_page(page, 0);
+		kernel_map_pages(page, 1, 1);
+	}
+
+	if (pfn < end) {
+		free_contig_range(start, pfn - start);
+		return 0;
+	}
+	return pfn;
+}
+
+/**
+ * alloc_contig_range() - take a range of lent pages back
+ * @start:	first pfn of the range
+ * @end:	pfn after the last one of the range
+ * @migratetype:	migratetype of the range's pageblocks, MIGRATE_CMA
+ *
+ * The pages of the range are migrated elsewhere if they are in use and
+ * then allocated, as order 0 pages to be freed with free_contig_range().
+ * The caller serializes calls for overlapping ranges.
+ *
+ * Returns the number of pages that had to be migrated, or -EBUSY if some
+ * page of the range could not be freed.
+ */
+int alloc_contig_range(unsigned long start, unsigned long end,
+		       unsigned migratetype)
+{
+	unsigned long iso_start = start & ~(CONTIG_ALIGN_PAGES - 1);
+	unsigned long iso_end = ALIGN(end, CONTIG_ALIGN_PAGES);
+	unsigned long outer_start, outer_end;
+	struct zone *zone = page_zone(pfn_to_page(start));
+	struct page *page;
+	int ret, order;
+
+	ret = start_isolate_page_range(iso_start, iso_end, migratetype);
+	if (ret)
+		return ret;
+
+	ret = alloc_contig_migrate_range(start, end);
+
+	/*
+	 * Find the free page that @start is part of.  Free pages only
+	 * merge while the range is isolated, so if this looks at a stale
+	 * one, taking the range below just fails.
+	 */
+	outer_start = start;
+	for (order = 0; order < MAX_ORDER; order++) {
+		page = pfn_to_page(start & (~0UL << order));
+		if (PageBuddy(page) && page_order(page) >= order) {
+			outer_start = page_to_pfn(page);
+			break;
+		}
+	}
+
+	outer_end = take_isolated_free_range(zone, outer_start, end);
+	if (!outer_end) {
+		ret = -EBUSY;
+		goto done;
+	}
+
+	/* Give back the parts of the first and last page outside the range */
+	if (outer_start < start)
+		free_contig_range(outer_start, start - outer_start);
+	if (outer_end > end)
+		free_contig_range(end, outer_end - end);
+
+done:
+	undo_isolate_page_range(iso_start, iso_end, migratetype);
+	return ret;
+}
+
+void free_contig_range(unsigned long pfn, unsigned long nr_pages)
+{
+	for (; nr_pages--; pfn++)
+		__free_page(pfn_to_page(pfn));
+}
+#endif /* CONFIG_CMA_MIGRATE */
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 /*
  * All pages in the range must be isolated before calling this.
@@ -5464,6 +6045,7 @@ static struct trace_print_flags pageflag_names[] = {
 	{1UL << PG_buddy,		"buddy"		},
 	{1UL << PG_swapbacked,		"swapbacked"	},
 	{1UL << PG_unevictable,		"unevictable"	},
+	{1UL << PG_ra_unused,		"ra_unused"	},
 #ifdef CONFIG_MMU
 	{1UL << PG_mlocked,		"mlocked"	},
 #endif
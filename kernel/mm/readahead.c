@@ -27,6 +27,7 @@ file_ra_state_init(struct file_ra_state *ra, struct address_space *mapping)
 {
 	ra->ra_pages = mapping->backing_dev_info->ra_pages;
 	ra->prev_pos = -1;
+	ra->wasted_seen = mapping->ra_wasted;
 }
 EXPORT_SYMBOL_GPL(file_ra_state_init);
 
@@ -171,7 +172,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		rcu_read_lock();
 		page = radix_tree_lookup(&mapping->page_tree, page_offset);
 		rcu_read_unlock();
-		if (page)
+		if (page && !radix_tree_exceptional_entry(page))
 			continue;
 
 		page = page_cache_alloc_cold(mapping);
@@ -181,6 +182,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		list_add(&page->lru, &page_pool);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
+		__SetPageRaUnused(page);
 		ret++;
 	}
 
@@ -189,8 +191,10 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
-	if (ret)
+	if (ret) {
+		count_vm_events(READAHEAD_PAGES, ret);
 		read_pages(mapping, filp, &page_pool, ret);
+	}
 	BUG_ON(!list_empty(&page_pool));
 out:
 	return ret;
@@ -239,6 +243,32 @@ unsigned long max_sane_readahead(unsigned long nr)
 		+ node_page_state(numa_node_id(), NR_FREE_PAGES)) / 2);
 }
 
+/*
+ * Pages read ahead carry PG_ra_unused until they are first used; those
+ * that are reclaimed before that are counted in mapping->ra_wasted.
+ * Every time that count has moved since @ra last looked, the readahead
+ * window of @ra is halved, down to an eighth of ra_pages.  It doubles
+ * again with each readahead that finds no new waste.
+ */
+#define RA_MAX_SHRINK	3
+#define RA_MIN_PAGES	4
+
+unsigned long ra_max_pages(struct address_space *mapping,
+			   struct file_ra_state *ra)
+{
+	unsigned int wasted = ACCESS_ONCE(mapping->ra_wasted);
+
+	if (wasted != ra->wasted_seen) {
+		ra->wasted_seen = wasted;
+		if (ra->shrink < RA_MAX_SHRINK &&
+		    (ra->ra_pages >> (ra->shrink + 1)) >= RA_MIN_PAGES)
+			ra->shrink++;
+	} else if (ra->shrink)
+		ra->shrink--;
+
+	return max_sane_readahead(ra->ra_pages >> ra->shrink);
+}
+
 /*
  * Submit IO for the read-ahead request in file_ra_state.
  */
@@ -343,7 +373,7 @@ static pgoff_t count_history_pages(struct address_space *mapping,
 	pgoff_t head;
 
 	rcu_read_lock();
-	head = radix_tree_prev_hole(&mapping->page_tree, offset - 1, max);
+	head = page_cache_prev_hole(mapping, offset - 1, max);
 	rcu_read_unlock();
 
 	return offset - 1 - head;
@@ -392,7 +422,7 @@ ondemand_readahead(struct address_space *mapping,
 		   bool hit_readahead_marker, pgoff_t offset,
 		   unsigned long req_size)
 {
-	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long max = ra_max_pages(mapping, ra);
 
 	/*
 	 * start of file
@@ -422,7 +452,7 @@ ondemand_readahead(struct address_space *mapping,
 		pgoff_t start;
 
 		rcu_read_lock();
-		start = radix_tree_next_hole(&mapping->page_tree, offset+1,max);
+		start = page_cache_next_hole(mapping, offset + 1, max);
 		rcu_read_unlock();
 
 		if (!start || start - offset > max)
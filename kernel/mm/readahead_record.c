@@ -0,0 +1,338 @@
+/*
+ * mm/readahead_record.c - record file accesses for launch prefetching
+ *
+ * While recording, every read() and page fault on a regular file, as
+ * reported by the mm_filemap_access tracepoint, is added to a table of
+ * (file, first page, number of pages) extents.  Accesses next to or
+ * overlapping a recent extent of the same file are merged into it.
+ *
+ * The table is read back from debugfs as lines of
+ *
+ *	<first page> <number of pages> <path>
+ *
+ * and the same lines written to the replay file read those ranges in,
+ * like POSIX_FADV_WILLNEED would.  Recording an application launch once
+ * and replaying it before the next launch brings in the pages it needs
+ * in a few large reads instead of many small synchronous faults.
+ *
+ * Recording can be limited to one thread group, the application being
+ * launched, by writing its tgid to the pid file before enabling.
+ */
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/mount.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/file.h>
+#include <linux/path.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+
+#include <trace/events/filemap.h>
+
+#define RA_RECORD_MAX	4096	/* extents in the table */
+#define RA_RECORD_MERGE	8	/* recent extents tried for merging */
+
+struct ra_extent {
+	struct path	path;
+	pgoff_t		start;
+	unsigned long	nr;
+};
+
+static struct ra_extent *ra_extents;
+static unsigned int ra_nr_extents;
+static unsigned long ra_dropped;
+static DEFINE_SPINLOCK(ra_record_lock);
+
+/* serializes enabling, clearing and reading back the table */
+static DEFINE_MUTEX(ra_record_mutex);
+static int ra_record_enabled;
+static u64 ra_record_tgid;
+
+static bool ra_extent_merge(struct ra_extent *e, struct file *file,
+			    pgoff_t start, unsigned long nr)
+{
+	if (e->path.dentry != file->f_path.dentry ||
+	    e->path.mnt != file->f_path.mnt)
+		return false;
+	if (start > e->start + e->nr || start + nr < e->start)
+		return false;
+
+	if (start + nr > e->start + e->nr)
+		e->nr = start + nr - e->start;
+	if (start < e->start) {
+		e->nr += e->start - start;
+		e->start = start;
+	}
+	return true;
+}
+
+static void probe_filemap_access(void *ignore, struct file *file,
+				 pgoff_t index, unsigned long nr)
+{
+	struct ra_extent *e;
+	unsigned int i;
+
+	if (!nr || !S_ISREG(file->f_mapping->host->i_mode))
+		return;
+	if (ra_record_tgid && current->tgid != ra_record_tgid)
+		return;
+
+	spin_lock(&ra_record_lock);
+	for (i = ra_nr_extents; i && ra_nr_extents - i < RA_RECORD_MERGE; i--)
+		if (ra_extent_merge(&ra_extents[i - 1], file, index, nr))
+			goto out;
+
+	if (ra_nr_extents == RA_RECORD_MAX) {
+		ra_dropped++;
+		goto out;
+	}
+
+	e = &ra_extents[ra_nr_extents];
+	e->path = file->f_path;
+	path_get(&e->path);
+	e->start = index;
+	e->nr = nr;
+	/* readers see the count without the lock, fill in the slot first */
+	smp_wmb();
+	ra_nr_extents++;
+out:
+	spin_unlock(&ra_record_lock);
+}
+
+/* Must be called with ra_record_mutex held and recording disabled */
+static void ra_record_clear(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < ra_nr_extents; i++)
+		path_put(&ra_extents[i].path);
+	ra_nr_extents = 0;
+	ra_dropped = 0;
+}
+
+static int ra_record_set_enabled(int enable)
+{
+	int ret = 0;
+
+	mutex_lock(&ra_record_mutex);
+	if (enable == ra_record_enabled)
+		goto out;
+
+	if (enable) {
+		/* a new recording replaces the previous one */
+		ra_record_clear();
+		ret = register_trace_mm_filemap_access(probe_filemap_access,
+						       NULL);
+		if (ret)
+			pr_info("readahead record: Couldn't activate "
+				"tracepoint probe to mm_filemap_access\n");
+	} else {
+		unregister_trace_mm_filemap_access(probe_filemap_access, NULL);
+		/* make sure no probe is still running before we report off */
+		tracepoint_synchronize_unregister();
+	}
+	if (!ret)
+		ra_record_enabled = enable;
+out:
+	mutex_unlock(&ra_record_mutex);
+
+	return ret;
+}
+
+/*
+ * The extents below the count are filled in, and their paths stay put
+ * while ra_record_mutex is held.  Only start and nr may still change.
+ */
+static unsigned int ra_extents_nr(void)
+{
+	unsigned int nr = ACCESS_ONCE(ra_nr_extents);
+
+	smp_rmb();	/* pairs with the smp_wmb() in the probe */
+	return nr;
+}
+
+static void *ra_extents_start(struct seq_file *m, loff_t *pos)
+{
+	mutex_lock(&ra_record_mutex);
+	if (*pos >= ra_extents_nr())
+		return NULL;
+	return &ra_extents[*pos];
+}
+
+static void *ra_extents_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	(*pos)++;
+	if (*pos >= ra_extents_nr())
+		return NULL;
+	return &ra_extents[*pos];
+}
+
+static void ra_extents_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&ra_record_mutex);
+}
+
+static int ra_extents_show(struct seq_file *m, void *v)
+{
+	struct ra_extent *e = v;
+	pgoff_t start;
+	unsigned long nr;
+
+	/* the probe may still be merging into it */
+	spin_lock(&ra_record_lock);
+	start = e->start;
+	nr = e->nr;
+	spin_unlock(&ra_record_lock);
+
+	seq_printf(m, "%lu %lu ", start, nr);
+	seq_path(m, &e->path, "\n");
+	seq_putc(m, '\n');
+
+	return 0;
+}
+
+static const struct seq_operations ra_extents_op = {
+	.start	= ra_extents_start,
+	.next	= ra_extents_next,
+	.stop	= ra_extents_stop,
+	.show	= ra_extents_show,
+};
+
+static int ra_extents_open(struct inode *inode, struct file *filp)
+{
+	return seq_open(filp, &ra_extents_op);
+}
+
+static const struct file_operations ra_extents_fops = {
+	.open		= ra_extents_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int ra_stat_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "extents %u\n", ACCESS_ONCE(ra_nr_extents));
+	seq_printf(m, "dropped %lu\n", ACCESS_ONCE(ra_dropped));
+
+	return 0;
+}
+
+static int ra_stat_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, ra_stat_show, NULL);
+}
+
+static const struct file_operations ra_stat_fops = {
+	.open		= ra_stat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int ra_enable_get(void *data, u64 *val)
+{
+	*val = ra_record_enabled;
+	return 0;
+}
+
+static int ra_enable_set(void *data, u64 val)
+{
+	return ra_record_set_enabled(!!val);
+}
+DEFINE_SIMPLE_ATTRIBUTE(ra_enable_fops, ra_enable_get, ra_enable_set,
+			"%llu\n");
+
+/*
+ * Read in one "<first page> <number of pages> <path>" line.  Files that
+ * are gone or cannot be opened are skipped.
+ */
+static void ra_replay_line(char *line)
+{
+	unsigned long start, nr;
+	struct file *filp;
+	int n;
+
+	if (sscanf(line, "%lu %lu %n", &start, &nr, &n) != 2 || !line[n])
+		return;
+
+	filp = filp_open(line + n, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp))
+		return;
+
+	if (S_ISREG(filp->f_mapping->host->i_mode))
+		force_page_cache_readahead(filp->f_mapping, filp, start, nr);
+	filp_close(filp, NULL);
+}
+
+/*
+ * Only complete lines are consumed, the writer is expected to write the
+ * rest again.  A buffer without any newline is taken as one last line.
+ */
+static ssize_t ra_replay_write(struct file *filp, const char __user *ubuf,
+			       size_t cnt, loff_t *ppos)
+{
+	char *buf, *line, *end;
+	size_t len = min_t(size_t, cnt, PAGE_SIZE - 1);
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	if (copy_from_user(buf, ubuf, len)) {
+		kfree(buf);
+		return -EFAULT;
+	}
+	buf[len] = 0;
+
+	if (!strchr(buf, '\n')) {
+		ra_replay_line(buf);
+	} else {
+		len = 0;
+		for (line = buf; (end = strchr(line, '\n')); line = end + 1) {
+			*end = 0;
+			ra_replay_line(line);
+			len = end + 1 - buf;
+		}
+	}
+	kfree(buf);
+
+	*ppos += len;
+	return len;
+}
+
+static const struct file_operations ra_replay_fops = {
+	.write		= ra_replay_write,
+};
+
+static __init int ra_record_init(void)
+{
+	struct dentry *d;
+
+	ra_extents = vmalloc(RA_RECORD_MAX * sizeof(struct ra_extent));
+	if (!ra_extents)
+		return -ENOMEM;
+
+	d = debugfs_create_dir("readahead_record", NULL);
+	if (!d) {
+		pr_warning("Could not create debugfs directory "
+			   "'readahead_record'\n");
+		vfree(ra_extents);
+		ra_extents = NULL;
+		return 0;
+	}
+
+	debugfs_create_file("enable", 0644, d, NULL, &ra_enable_fops);
+	debugfs_create_u64("pid", 0644, d, &ra_record_tgid);
+	debugfs_create_file("extents", 0444, d, NULL, &ra_extents_fops);
+	debugfs_create_file("stat", 0444, d, NULL, &ra_stat_fops);
+	debugfs_create_file("replay", 0200, d, NULL, &ra_replay_fops);
+
+	return 0;
+}
+late_initcall(ra_record_init);
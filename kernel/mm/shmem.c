@@ -1029,6 +1029,34 @@ out:
 	return (found < 0) ? found : 0;
 }
 
+/*
+ * Swap slot for the page at @index: the one after its predecessor's in the
+ * file if that is free, so that a region written out in order lands in
+ * order in swap, and its writes and later reads can be merged.
+ */
+static swp_entry_t shmem_get_swap_page(struct shmem_inode_info *info,
+				       unsigned long index)
+{
+	swp_entry_t *entry, prev, swap;
+
+	prev.val = 0;
+	if (index && info->swapped) {
+		spin_lock(&info->lock);
+		entry = shmem_swp_entry(info, index - 1, NULL);
+		if (entry) {
+			prev = *entry;
+			shmem_swp_unmap(entry);
+		}
+		spin_unlock(&info->lock);
+	}
+	if (prev.val) {
+		swap = get_swap_page_after(prev);
+		if (swap.val)
+			return swap;
+	}
+	return get_swap_page();
+}
+
 /*
  * Move the page from the page cache to the swap cache.
  */
@@ -1060,7 +1088,7 @@ static int shmem_writepage(struct page *page, struct writeback_control *wbc)
 	 * discarded.
 	 */
 	if (wbc->for_reclaim)
-		swap = get_swap_page();
+		swap = shmem_get_swap_page(info, index);
 	else
 		swap.val = 0;
 
@@ -1119,6 +1147,39 @@ redirty:
 	return 0;
 }
 
+/* Limits the stack used by shmem_swap_neighbours() callers */
+#define SHMEM_SWAP_RA_MAX	16
+
+/*
+ * Collects the swap entries of the pages following @idx in the file, up to
+ * the swap readahead window (1 << page_cluster, including @idx itself).
+ * Returns their number, 0 if none of those pages is in swap.
+ */
+static int shmem_swap_neighbours(struct shmem_inode_info *info,
+			unsigned long idx, swp_entry_t *swap)
+{
+	unsigned long i, end;
+	swp_entry_t *entry;
+	int nr = 0;
+
+	if (!page_cluster || !info->swapped)
+		return 0;
+	end = idx + min(1 << page_cluster, SHMEM_SWAP_RA_MAX);
+
+	spin_lock(&info->lock);
+	end = min(end, info->next_index);
+	for (i = idx + 1; i < end; i++) {
+		entry = shmem_swp_entry(info, i, NULL);
+		if (!entry)
+			continue;	/* no index page here */
+		if (entry->val)
+			swap[nr++] = *entry;
+		shmem_swp_unmap(entry);
+	}
+	spin_unlock(&info->lock);
+	return nr;
+}
+
 #ifdef CONFIG_NUMA
 #ifdef CONFIG_TMPFS
 static void shmem_show_mpol(struct seq_file *seq, struct mempolicy *mpol)
@@ -1149,9 +1210,13 @@ static struct mempolicy *shmem_get_sbmpol(struct shmem_sb_info *sbinfo)
 static struct page *shmem_swapin(swp_entry_t entry, gfp_t gfp,
 			struct shmem_inode_info *info, unsigned long idx)
 {
+	swp_entry_t ra[SHMEM_SWAP_RA_MAX];
 	struct mempolicy mpol, *spol;
 	struct vm_area_struct pvma;
 	struct page *page;
+	int nr;
+
+	nr = shmem_swap_neighbours(info, idx, ra);
 
 	spol = mpol_cond_copy(&mpol,
 				mpol_shared_policy_lookup(&info->policy, idx));
@@ -1161,7 +1226,10 @@ static struct page *shmem_swapin(swp_entry_t entry, gfp_t gfp,
 	pvma.vm_pgoff = idx;
 	pvma.vm_ops = NULL;
 	pvma.vm_policy = spol;
-	page = swapin_readahead(entry, gfp, &pvma, 0);
+	if (nr)
+		page = swap_entries_readahead(entry, ra, nr, gfp, &pvma, 0);
+	else
+		page = swapin_readahead(entry, gfp, &pvma, 0);
 	return page;
 }
 
@@ -1191,6 +1259,12 @@ static inline void shmem_show_mpol(struct seq_file *seq, struct mempolicy *p)
 static inline struct page *shmem_swapin(swp_entry_t entry, gfp_t gfp,
 			struct shmem_inode_info *info, unsigned long idx)
 {
+	swp_entry_t ra[SHMEM_SWAP_RA_MAX];
+	int nr;
+
+	nr = shmem_swap_neighbours(info, idx, ra);
+	if (nr)
+		return swap_entries_readahead(entry, ra, nr, gfp, NULL, 0);
 	return swapin_readahead(entry, gfp, NULL, 0);
 }
 
@@ -1272,7 +1346,7 @@ repeat:
 
 	if (swap.val) {
 		/* Look it up and read it in.. */
-		swappage = lookup_swap_cache(swap);
+		swappage = lookup_swap_cache(swap, NULL, 0);
 		if (!swappage) {
 			shmem_swp_unmap(entry);
 			/* here we actually do the io */
@@ -28,6 +28,7 @@
 #include <linux/memory.h>
 #include <linux/math64.h>
 #include <linux/fault-inject.h>
+#include <linux/uaccess.h>
 
 /*
  * Lock order:
@@ -263,6 +264,64 @@ static inline void set_freepointer(struct kmem_cache *s, void *object, void *fp)
 	*(void **)(object + s->offset) = fp;
 }
 
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+/*
+ * The fast paths leave interrupts enabled.  They take an object off, or
+ * put one on, the cpu freelist with a single cmpxchg64_local() of the
+ * freelist together with its transaction id.  The id changes with every
+ * update of the freelist, so an interrupt that allocated or freed in
+ * between is noticed even if it left the same object at the head of the
+ * list.  Whatever changes c->freelist with interrupts disabled must bump
+ * the id as well.
+ */
+union cpu_freelist {		/* freelist and tid of kmem_cache_cpu */
+	struct {
+		void **freelist;
+		unsigned long tid;
+	};
+	u64 val;
+};
+
+static inline unsigned long next_tid(unsigned long tid)
+{
+	return tid + 1;
+}
+
+/* Must be called with preemption disabled */
+static inline int cpu_freelist_cmpxchg(struct kmem_cache_cpu *c,
+		void **old_freelist, unsigned long tid, void **new_freelist)
+{
+	union cpu_freelist old, new;
+
+	BUILD_BUG_ON(sizeof(union cpu_freelist) != sizeof(u64));
+
+	old.freelist = old_freelist;
+	old.tid = tid;
+	new.freelist = new_freelist;
+	new.tid = next_tid(tid);
+
+	return cmpxchg64_local(&c->freelist_tid, old.val, new.val) == old.val;
+}
+
+/*
+ * By the time the fast path reads the free pointer of the object at the
+ * head of the freelist, an interrupt may have allocated it, and even
+ * flushed and freed its slab.  The value read is then discarded by the
+ * failing cmpxchg, but with DEBUG_PAGEALLOC the read itself could fault.
+ */
+static inline void *get_freepointer_safe(struct kmem_cache *s, void *object)
+{
+	void *p;
+
+#ifdef CONFIG_DEBUG_PAGEALLOC
+	probe_kernel_read(&p, (void **)(object + s->offset), sizeof(p));
+#else
+	p = get_freepointer(s, object);
+#endif
+	return p;
+}
+#endif
+
 /* Loop over all objects in a slab */
 #define for_each_object(__p, __s, __addr, __objects) \
 	for (__p = (__addr); __p < (__addr) + (__objects) * (__s)->size;\
@@ -1302,10 +1361,15 @@ static inline int lock_and_freeze_slab(struct kmem_cache_node *n,
 
 /*
  * Try to allocate a partial slab from a specific node.
+ *
+ * If @c is given, further partial slabs are moved to its cpu partial list
+ * under the same list_lock, until that holds half of s->cpu_partial.
  */
-static struct page *get_partial_node(struct kmem_cache_node *n)
+static struct page *get_partial_node(struct kmem_cache *s,
+		struct kmem_cache_node *n, struct kmem_cache_cpu *c)
 {
-	struct page *page;
+	struct page *page, *next;
+	struct page *first = NULL;
 
 	/*
 	 * Racy check. If we mistakenly see no partial slabs then we
@@ -1317,13 +1381,26 @@ static struct page *get_partial_node(struct kmem_cache_node *n)
 		return NULL;
 
 	spin_lock(&n->list_lock);
-	list_for_each_entry(page, &n->partial, lru)
-		if (lock_and_freeze_slab(n, page))
-			goto out;
-	page = NULL;
-out:
+	list_for_each_entry_safe(page, next, &n->partial, lru) {
+		if (!lock_and_freeze_slab(n, page))
+			continue;
+
+		if (!first) {
+			first = page;
+			if (!c || c->nr_partial >= s->cpu_partial / 2)
+				break;
+			stat(s, CPU_PARTIAL_NODE);
+			continue;
+		}
+
+		/* Frozen slabs on a cpu partial list are not locked */
+		slab_unlock(page);
+		list_add_tail(&page->lru, &c->partial);
+		if (++c->nr_partial >= s->cpu_partial / 2)
+			break;
+	}
 	spin_unlock(&n->list_lock);
-	return page;
+	return first;
 }
 
 /*
@@ -1369,7 +1446,7 @@ static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
 
 		if (n && cpuset_zone_allowed_hardwall(zone, flags) &&
 				n->nr_partial > s->min_partial) {
-			page = get_partial_node(n);
+			page = get_partial_node(s, n, NULL);
 			if (page) {
 				put_mems_allowed();
 				return page;
@@ -1384,12 +1461,17 @@ static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
 /*
  * Get a partial page, lock it and return it.
  */
-static struct page *get_partial(struct kmem_cache *s, gfp_t flags, int node)
+static struct page *get_partial(struct kmem_cache *s, gfp_t flags, int node,
+				struct kmem_cache_cpu *c)
 {
 	struct page *page;
 	int searchnode = (node == -1) ? numa_node_id() : node;
 
-	page = get_partial_node(get_node(s, searchnode));
+	/* Only stock the cpu partial list with node local slabs */
+	if (searchnode != numa_node_id())
+		c = NULL;
+
+	page = get_partial_node(s, get_node(s, searchnode), c);
 	if (page || (flags & __GFP_THISNODE))
 		return page;
 
@@ -1473,9 +1555,83 @@ static void deactivate_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 		page->inuse--;
 	}
 	c->page = NULL;
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+	c->tid = next_tid(c->tid);
+#endif
 	unfreeze_slab(s, page, tail);
 }
 
+/*
+ * Per cpu partial slabs.
+ *
+ * Next to the slab it allocates from, every cpu keeps a short list of
+ * frozen partial slabs.  Frozen slabs are on no node list, so freeing to
+ * them only takes the slab lock, and a cpu whose slab is used up takes
+ * the next one from its own list.  The node partial list and its
+ * list_lock are only needed when the cpu list is empty, and then several
+ * slabs are taken at once, or when a slab becomes partial while the cpu
+ * list is full.
+ *
+ * The cpu partial list is only used by its own cpu with interrupts off.
+ */
+
+/*
+ * Take a slab off the cpu partial list, lock it and return it.
+ *
+ * Frees from other cpus may have emptied the other slabs on the list.
+ * Those are unfrozen on the way, which gives them back to the page
+ * allocator once the node keeps s->min_partial empty slabs.
+ */
+static struct page *get_cpu_partial(struct kmem_cache *s,
+				    struct kmem_cache_cpu *c, int node)
+{
+	struct page *page, *next, *found = NULL;
+
+	list_for_each_entry_safe(page, next, &c->partial, lru) {
+		if (!found && (node == -1 || page_to_nid(page) == node)) {
+			list_del(&page->lru);
+			c->nr_partial--;
+			found = page;
+			continue;
+		}
+
+		/* Only remote frees change inuse, and only downwards */
+		if (page->inuse)
+			continue;
+		slab_lock(page);
+		if (page->inuse) {
+			slab_unlock(page);
+			continue;
+		}
+		list_del(&page->lru);
+		c->nr_partial--;
+		unfreeze_slab(s, page, 1);
+	}
+
+	if (found)
+		slab_lock(found);
+	return found;
+}
+
+/*
+ * Return all slabs on the cpu partial list to their node lists.
+ */
+static void unfreeze_partials(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct page *page, *next;
+
+	if (!c->nr_partial)
+		return;
+
+	stat(s, CPU_PARTIAL_DRAIN);
+	list_for_each_entry_safe(page, next, &c->partial, lru) {
+		list_del(&page->lru);
+		slab_lock(page);
+		unfreeze_slab(s, page, 1);
+	}
+	c->nr_partial = 0;
+}
+
 static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 {
 	stat(s, CPUSLAB_FLUSH);
@@ -1494,6 +1650,8 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 
 	if (likely(c && c->page))
 		flush_slab(s, c);
+	if (likely(c))
+		unfreeze_partials(s, c);
 }
 
 static void flush_cpu_slab(void *d)
@@ -1607,6 +1765,13 @@ static void *__slab_alloc(struct kmem_cache *s, gfp_t gfpflags, int node,
 {
 	void **object;
 	struct page *new;
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+	unsigned long flags;
+
+	local_irq_save(flags);
+	/* The fast path did not keep us on its cpu */
+	c = __this_cpu_ptr(s->cpu_slab);
+#endif
 
 	/* We handle __GFP_ZERO in the caller */
 	gfpflags &= ~__GFP_ZERO;
@@ -1633,6 +1798,10 @@ load_freelist:
 	c->node = page_to_nid(c->page);
 unlock_out:
 	slab_unlock(c->page);
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+	c->tid = next_tid(c->tid);
+	local_irq_restore(flags);
+#endif
 	stat(s, ALLOC_SLOWPATH);
 	return object;
 
@@ -1640,7 +1809,14 @@ another_slab:
 	deactivate_slab(s, c);
 
 new_slab:
-	new = get_partial(s, gfpflags, node);
+	new = get_cpu_partial(s, c, node);
+	if (new) {
+		c->page = new;
+		stat(s, CPU_PARTIAL_ALLOC);
+		goto load_freelist;
+	}
+
+	new = get_partial(s, gfpflags, node, c);
 	if (new) {
 		c->page = new;
 		stat(s, ALLOC_FROM_PARTIAL);
@@ -1667,6 +1843,9 @@ new_slab:
 	}
 	if (!(gfpflags & __GFP_NOWARN) && printk_ratelimit())
 		slab_out_of_memory(s, gfpflags, node);
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+	local_irq_restore(flags);
+#endif
 	return NULL;
 debug:
 	if (!alloc_debug_processing(s, c->page, object, addr))
@@ -1693,7 +1872,11 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 {
 	void **object;
 	struct kmem_cache_cpu *c;
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+	unsigned long tid;
+#else
 	unsigned long flags;
+#endif
 
 	gfpflags &= gfp_allowed_mask;
 
@@ -1703,6 +1886,28 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 	if (should_failslab(s->objsize, gfpflags, s->flags))
 		return NULL;
 
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+redo:
+	preempt_disable();
+	c = __this_cpu_ptr(s->cpu_slab);
+	/* An update of the freelist after this shows up in the tid */
+	tid = c->tid;
+	barrier();
+	object = c->freelist;
+	if (unlikely(!object || !node_match(c, node))) {
+		preempt_enable();
+		object = __slab_alloc(s, gfpflags, node, addr, c);
+	} else {
+		if (unlikely(!cpu_freelist_cmpxchg(c, object, tid,
+				get_freepointer_safe(s, object)))) {
+			stat(s, CMPXCHG_CPU_FAIL);
+			preempt_enable();
+			goto redo;
+		}
+		stat(s, ALLOC_FASTPATH);
+		preempt_enable();
+	}
+#else
 	local_irq_save(flags);
 	c = __this_cpu_ptr(s->cpu_slab);
 	object = c->freelist;
@@ -1715,6 +1920,7 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 		stat(s, ALLOC_FASTPATH);
 	}
 	local_irq_restore(flags);
+#endif
 
 	if (unlikely(gfpflags & __GFP_ZERO) && object)
 		memset(object, 0, s->objsize);
@@ -1779,6 +1985,11 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 {
 	void *prior;
 	void **object = (void *)x;
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+	unsigned long flags;
+
+	local_irq_save(flags);
+#endif
 
 	stat(s, FREE_SLOWPATH);
 	slab_lock(page);
@@ -1802,15 +2013,37 @@ checks_ok:
 
 	/*
 	 * Objects left in the slab. If it was not on the partial list before
-	 * then add it.
+	 * then add it, to the cpu partial list unless that is disabled.
 	 */
 	if (unlikely(!prior)) {
+		struct kmem_cache_cpu *c = __this_cpu_ptr(s->cpu_slab);
+
+		if (s->cpu_partial && page_to_nid(page) == numa_node_id()) {
+			/*
+			 * Frozen, the slab is left alone by other cpus while
+			 * it is unlocked.  A full cpu list goes back to the
+			 * node first, which frees the slabs on it that were
+			 * emptied by remote frees.
+			 */
+			__SetPageSlubFrozen(page);
+			slab_unlock(page);
+			if (c->nr_partial >= s->cpu_partial)
+				unfreeze_partials(s, c);
+			list_add(&page->lru, &c->partial);
+			c->nr_partial++;
+			stat(s, CPU_PARTIAL_FREE);
+			goto out;
+		}
 		add_partial(get_node(s, page_to_nid(page)), page, 1);
 		stat(s, FREE_ADD_PARTIAL);
 	}
 
 out_unlock:
 	slab_unlock(page);
+out:
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+	local_irq_restore(flags);
+#endif
 	return;
 
 slab_empty:
@@ -1822,6 +2055,9 @@ slab_empty:
 		stat(s, FREE_REMOVE_PARTIAL);
 	}
 	slab_unlock(page);
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+	local_irq_restore(flags);
+#endif
 	stat(s, FREE_SLAB);
 	discard_slab(s, page);
 	return;
@@ -1848,15 +2084,42 @@ static __always_inline void slab_free(struct kmem_cache *s,
 {
 	void **object = (void *)x;
 	struct kmem_cache_cpu *c;
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+	void **freelist;
+	unsigned long tid;
+#else
 	unsigned long flags;
+#endif
 
 	kmemleak_free_recursive(x, s->flags);
-	local_irq_save(flags);
-	c = __this_cpu_ptr(s->cpu_slab);
 	kmemcheck_slab_free(s, object, s->objsize);
 	debug_check_no_locks_freed(object, s->objsize);
 	if (!(s->flags & SLAB_DEBUG_OBJECTS))
 		debug_check_no_obj_freed(object, s->objsize);
+
+#ifdef CONFIG_SLUB_CMPXCHG_LOCAL
+redo:
+	preempt_disable();
+	c = __this_cpu_ptr(s->cpu_slab);
+	tid = c->tid;
+	barrier();
+	if (likely(page == c->page && c->node >= 0)) {
+		freelist = c->freelist;
+		set_freepointer(s, object, freelist);
+		if (unlikely(!cpu_freelist_cmpxchg(c, freelist, tid, object))) {
+			stat(s, CMPXCHG_CPU_FAIL);
+			preempt_enable();
+			goto redo;
+		}
+		stat(s, FREE_FASTPATH);
+		preempt_enable();
+	} else {
+		preempt_enable();
+		__slab_free(s, page, x, addr);
+	}
+#else
+	local_irq_save(flags);
+	c = __this_cpu_ptr(s->cpu_slab);
 	if (likely(page == c->page && c->node >= 0)) {
 		set_freepointer(s, object, c->freelist);
 		c->freelist = object;
@@ -1865,6 +2128,7 @@ static __always_inline void slab_free(struct kmem_cache *s,
 		__slab_free(s, page, x, addr);
 
 	local_irq_restore(flags);
+#endif
 }
 
 void kmem_cache_free(struct kmem_cache *s, void *x)
@@ -2066,6 +2330,8 @@ static DEFINE_PER_CPU(struct kmem_cache_cpu, kmalloc_percpu[KMALLOC_CACHES]);
 
 static inline int alloc_kmem_cache_cpus(struct kmem_cache *s, gfp_t flags)
 {
+	int cpu;
+
 	if (s < kmalloc_caches + KMALLOC_CACHES && s >= kmalloc_caches)
 		/*
 		 * Boot time creation of the kmalloc array. Use static per cpu data
@@ -2078,6 +2344,9 @@ static inline int alloc_kmem_cache_cpus(struct kmem_cache *s, gfp_t flags)
 	if (!s->cpu_slab)
 		return 0;
 
+	for_each_possible_cpu(cpu)
+		INIT_LIST_HEAD(&per_cpu_ptr(s->cpu_slab, cpu)->partial);
+
 	return 1;
 }
 
@@ -2188,6 +2457,24 @@ static void set_min_partial(struct kmem_cache *s, unsigned long min)
 	s->min_partial = min;
 }
 
+static void set_cpu_partial(struct kmem_cache *s)
+{
+	/*
+	 * Debug caches take the slow paths anyway and keep their slabs
+	 * on the node lists where validation can find them.
+	 */
+	if (s->flags & (DEBUG_DEFAULT_FLAGS | SLAB_TRACE))
+		s->cpu_partial = 0;
+	else if (s->size >= PAGE_SIZE)
+		s->cpu_partial = 2;
+	else if (s->size >= 1024)
+		s->cpu_partial = 4;
+	else if (s->size >= 256)
+		s->cpu_partial = 8;
+	else
+		s->cpu_partial = 13;
+}
+
 /*
  * calculate_sizes() determines the order and the distribution of data within
  * a slab object.
@@ -2344,6 +2631,7 @@ static int kmem_cache_open(struct kmem_cache *s, gfp_t gfpflags,
 	 * list to avoid pounding the page allocator excessively.
 	 */
 	set_min_partial(s, ilog2(s->size));
+	set_cpu_partial(s);
 	s->refcount = 1;
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -3940,6 +4228,54 @@ static ssize_t min_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(min_partial);
 
+static ssize_t cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->cpu_partial);
+}
+
+static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
+				 size_t length)
+{
+	unsigned long slabs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &slabs);
+	if (err)
+		return err;
+	if (slabs > INT_MAX)
+		return -EINVAL;
+	if (slabs && (s->flags & (DEBUG_DEFAULT_FLAGS | SLAB_TRACE)))
+		return -EINVAL;
+
+	s->cpu_partial = slabs;
+	flush_all(s);
+	return length;
+}
+SLAB_ATTR(cpu_partial);
+
+static ssize_t slabs_cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	unsigned long sum = 0;
+	int cpu;
+	int len;
+
+	for_each_online_cpu(cpu)
+		sum += per_cpu_ptr(s->cpu_slab, cpu)->nr_partial;
+
+	len = sprintf(buf, "%lu", sum);
+
+#ifdef CONFIG_SMP
+	for_each_online_cpu(cpu) {
+		int nr = per_cpu_ptr(s->cpu_slab, cpu)->nr_partial;
+
+		if (nr && len < PAGE_SIZE - 20)
+			len += sprintf(buf + len, " C%d=%d", cpu, nr);
+	}
+#endif
+	return len + sprintf(buf + len, "\n");
+}
+SLAB_ATTR_RO(slabs_cpu_partial);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (s->ctor) {
@@ -4281,6 +4617,11 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(CMPXCHG_CPU_FAIL, cmpxchg_cpu_fail);
+STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
+STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
+STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
+STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4289,12 +4630,14 @@ static struct attribute *slab_attrs[] = {
 	&objs_per_slab_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
+	&cpu_partial_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&total_objects_attr.attr,
 	&slabs_attr.attr,
 	&partial_attr.attr,
 	&cpu_slabs_attr.attr,
+	&slabs_cpu_partial_attr.attr,
 	&ctor_attr.attr,
 	&aliases_attr.attr,
 	&align_attr.attr,
@@ -4335,6 +4678,11 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&cmpxchg_cpu_fail_attr.attr,
+	&cpu_partial_alloc_attr.attr,
+	&cpu_partial_free_attr.attr,
+	&cpu_partial_node_attr.attr,
+	&cpu_partial_drain_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -120,6 +120,12 @@ static void pagevec_move_tail(struct pagevec *pvec)
 		}
 		if (PageLRU(page) && !PageActive(page) && !PageUnevictable(page)) {
 			int lru = page_lru_base_type(page);
+
+			if (lru_gen_enabled()) {
+				if (lru_gen_rotate_page(zone, page))
+					pgmoved++;
+				continue;
+			}
 			list_move_tail(&page->lru, &zone->lru[lru].list);
 			pgmoved++;
 		}
@@ -189,6 +195,8 @@ void activate_page(struct page *page)
 		lru += LRU_ACTIVE;
 		add_page_to_lru_list(zone, page, lru);
 		__count_vm_event(PGACTIVATE);
+		if (file)
+			workingset_activation(page);
 
 		update_page_reclaim_stat(zone, page, file, 1);
 	}
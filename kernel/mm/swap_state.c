@@ -19,6 +19,8 @@
 #include <linux/pagevec.h>
 #include <linux/migrate.h>
 #include <linux/page_cgroup.h>
+#include <linux/log2.h>
+#include <linux/pfn.h>
 
 #include <asm/pgtable.h>
 
@@ -251,37 +253,93 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
 	}
 }
 
+/*
+ * VMA based swap readahead.  Every vma remembers, in swap_readahead_info,
+ * the page of its last swap fault, the readahead window used for it and
+ * how many of the pages read ahead have been hit since.
+ */
+int sysctl_swap_vma_readahead __read_mostly = 1;
+
+#define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
+#define SWAP_RA_HITS_MAX	SWAP_RA_HITS_MASK
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+
+#define SWAP_RA_HITS(v)	((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN(v)	(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_WIN_SHIFT)
+#define SWAP_RA_ADDR(v)	((v) & PAGE_MASK)
+
+#define SWAP_RA_VAL(addr, win, hits)				\
+	(((addr) & PAGE_MASK) |					\
+	 (((win) << SWAP_RA_WIN_SHIFT) & SWAP_RA_WIN_MASK) |	\
+	 ((hits) & SWAP_RA_HITS_MASK))
+
+/* The ptes of the window are copied to the stack, keep it small */
+#ifdef CONFIG_64BIT
+#define SWAP_RA_ORDER_CEILING	5
+#else
+#define SWAP_RA_ORDER_CEILING	3
+#endif
+
+static void swap_ra_hit(struct vm_area_struct *vma, unsigned long addr)
+{
+	unsigned long ra_val;
+	unsigned int hits;
+
+	if (!vma || !sysctl_swap_vma_readahead) {
+		count_vm_event(SWAP_RA_HIT);
+		return;
+	}
+
+	count_vm_event(SWAP_VMA_RA_HIT);
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	hits = min_t(unsigned int, SWAP_RA_HITS(ra_val) + 1, SWAP_RA_HITS_MAX);
+	atomic_long_set(&vma->swap_readahead_info,
+			SWAP_RA_VAL(addr, SWAP_RA_WIN(ra_val), hits));
+}
+
 /*
  * Lookup a swap entry in the swap cache. A found page will be returned
  * unlocked and with its refcount incremented - we rely on the kernel
  * lock getting page table operations atomic even if we drop the page
  * lock before returning.
+ *
+ * @vma and @addr are those of the faulting pte, if any: a hit on a page
+ * brought in by readahead is credited to the readahead of @vma.
  */
-struct page * lookup_swap_cache(swp_entry_t entry)
+struct page *lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma,
+			       unsigned long addr)
 {
 	struct page *page;
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page))
+			swap_ra_hit(vma, addr);
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
 }
 
-/* 
+/*
  * Locate a page of swap in physical memory, reserving swap cache space
- * and reading the disk if it is not already cached.
+ * if it is not already cached.  A newly added page is returned locked,
+ * with *new_page_allocated set, and the caller has to start the read.
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			bool *new_page_allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*new_page_allocated = false;
+
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -327,11 +385,8 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 		err = __add_to_swap_cache(new_page, entry);
 		if (likely(!err)) {
 			radix_tree_preload_end();
-			/*
-			 * Initiate read into locked page and return.
-			 */
 			lru_cache_add_anon(new_page);
-			swap_readpage(new_page);
+			*new_page_allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -349,6 +404,50 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+/*
+ * Locate a page of swap in physical memory, reserving swap cache space
+ * and reading the disk if it is not already cached.
+ * A failure return means that either the page allocation failed or that
+ * the swap entry is no longer in use.
+ */
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool page_was_allocated;
+	struct page *page;
+
+	page = __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &page_was_allocated);
+	/* Initiate read into locked page */
+	if (page_was_allocated)
+		swap_readpage(page);
+	return page;
+}
+
+/*
+ * Read in a page that is only wanted speculatively.  It is marked
+ * PG_readahead so that a later hit on it can be counted.
+ */
+static int swap_readahead_one(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			enum vm_event_item item)
+{
+	bool page_was_allocated;
+	struct page *page;
+
+	page = __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &page_was_allocated);
+	if (!page)
+		return -ENOMEM;
+	if (page_was_allocated) {
+		SetPageReadahead(page);
+		swap_readpage(page);
+		count_vm_event(item);
+	}
+	page_cache_release(page);
+	return 0;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -385,9 +484,16 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	 */
 	nr_pages = valid_swaphandles(entry, &offset);
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
+		swp_entry_t ra_entry = swp_entry(swp_type(entry), offset);
+
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
+		if (offset != swp_offset(entry)) {
+			if (swap_readahead_one(ra_entry, gfp_mask,
+					       vma, addr, SWAP_RA))
+				break;
+			continue;
+		}
+		page = read_swap_cache_async(entry, gfp_mask, vma, addr);
 		if (!page)
 			break;
 		page_cache_release(page);
@@ -395,3 +501,156 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/*
+ * Size the readahead window of a fault at @addr in @vma from the hits on
+ * the pages read ahead since its previous swap fault: start with 4 pages
+ * after the first hit and double as hits keep coming in.  Without hits,
+ * only a fault right next to the previous one reads ahead, 2 pages.  The
+ * window is halved at most per fault, so that a few misses in between
+ * do not stop a stream that has proved useful.
+ */
+static unsigned int swap_ra_window(struct vm_area_struct *vma,
+			unsigned long addr, unsigned long *prev_pfn)
+{
+	unsigned long fpfn = PFN_DOWN(addr);
+	unsigned int win, max_win, hits;
+	unsigned long ra_val;
+
+	max_win = 1 << min_t(int, page_cluster, SWAP_RA_ORDER_CEILING);
+
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	*prev_pfn = PFN_DOWN(SWAP_RA_ADDR(ra_val));
+	hits = SWAP_RA_HITS(ra_val);
+
+	win = hits + 2;
+	if (win == 2) {
+		if (fpfn != *prev_pfn + 1 && fpfn != *prev_pfn - 1)
+			win = 1;
+	} else
+		win = roundup_pow_of_two(win);
+
+	win = max_t(unsigned int, win, SWAP_RA_WIN(ra_val) / 2);
+	win = min(win, max_win);
+
+	atomic_long_set(&vma->swap_readahead_info, SWAP_RA_VAL(addr, win, 0));
+	return win;
+}
+
+/**
+ * swap_vma_readahead - swap in pages mapped next to the faulting address
+ * @fentry: swap entry of the faulting pte
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma the fault is in
+ * @addr: faulting address
+ * @pmd: pmd mapping @addr
+ *
+ * Returns the struct page for @fentry, after queueing swapin.
+ *
+ * Unlike swapin_readahead(), which reads the slots around @fentry in the
+ * swap area, this reads the swap entries of the ptes around @addr.  Pages
+ * that are neighbours in the swap area were often swapped out together
+ * by unrelated processes, and reading them only wastes memory and, with
+ * compressed swap, cpu time.  Neighbours in the address space are much
+ * more likely to be wanted next.
+ *
+ * The window grows with the hits on the pages read ahead earlier and
+ * never leaves the vma or the page table of @addr.  When vma readahead
+ * is disabled (vm.swap_vma_readahead = 0) this is swapin_readahead().
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			pmd_t *pmd)
+{
+	pte_t ptes[1 << SWAP_RA_ORDER_CEILING];
+	unsigned long fpfn, prev_pfn, lpfn, rpfn, start, end, pfn;
+	unsigned int win, left;
+	pte_t *pte;
+
+	if (!sysctl_swap_vma_readahead)
+		return swapin_readahead(fentry, gfp_mask, vma, addr);
+
+	win = swap_ra_window(vma, addr, &prev_pfn);
+	if (win == 1)
+		goto skip;
+
+	/* read ahead in the direction the faults are going */
+	fpfn = PFN_DOWN(addr);
+	if (fpfn == prev_pfn + 1)
+		left = 0;
+	else if (fpfn == prev_pfn - 1)
+		left = win - 1;
+	else
+		left = (win - 1) / 2;
+	lpfn = fpfn - min_t(unsigned long, left, fpfn);
+	rpfn = fpfn + win - left;
+
+	start = max(lpfn, PFN_DOWN(vma->vm_start));
+	start = max(start, PFN_DOWN(addr & PMD_MASK));
+	end = min(rpfn, PFN_DOWN(vma->vm_end));
+	end = min(end, PFN_DOWN((addr & PMD_MASK) + PMD_SIZE));
+
+	/*
+	 * Copy the ptes, we cannot allocate with the page table mapped.
+	 * They are read without the pte lock; a stale entry at worst reads
+	 * in a page nobody wants, swapcache_prepare() keeps out freed ones.
+	 */
+	pte = pte_offset_map(pmd, start << PAGE_SHIFT);
+	memcpy(ptes, pte, (end - start) * sizeof(pte_t));
+	pte_unmap(pte);
+
+	for (pfn = start; pfn < end; pfn++) {
+		pte_t pentry = ptes[pfn - start];
+		swp_entry_t entry;
+
+		if (pfn == fpfn)
+			continue;
+		if (pte_none(pentry) || pte_present(pentry) || pte_file(pentry))
+			continue;
+		entry = pte_to_swp_entry(pentry);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		if (swap_readahead_one(entry, gfp_mask, vma,
+				       pfn << PAGE_SHIFT, SWAP_VMA_RA))
+			break;
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
+	return read_swap_cache_async(fentry, gfp_mask, vma, addr);
+}
+
+/**
+ * swap_entries_readahead - swap in pages the caller knows to be related
+ * @fentry: swap entry of the page wanted now
+ * @entries: swap entries of the pages likely to be wanted next
+ * @nr: number of @entries
+ * @gfp_mask: memory allocation flags
+ * @vma: vma for the mempolicy, if any
+ * @addr: target address for mempolicy
+ *
+ * Returns the struct page for @fentry, after queueing swapin.
+ *
+ * For objects that keep an index of their swap entries, like tmpfs files:
+ * the pages following the wanted one in the object are read in wherever
+ * they are in swap, instead of the slots around @fentry.
+ */
+struct page *swap_entries_readahead(swp_entry_t fentry, swp_entry_t *entries,
+			int nr, gfp_t gfp_mask, struct vm_area_struct *vma,
+			unsigned long addr)
+{
+	struct page *page;
+	int i;
+
+	/* Queue the wanted page first, the others are only a guess */
+	page = read_swap_cache_async(fentry, gfp_mask, vma, addr);
+	if (!page)
+		return NULL;
+	for (i = 0; i < nr; i++)
+		if (swap_readahead_one(entries[i], gfp_mask, vma, addr,
+				       SWAP_RA))
+			break;
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+	return page;
+}
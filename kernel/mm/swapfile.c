@@ -500,6 +500,49 @@ swp_entry_t get_swap_page_of_type(int type)
 	return (swp_entry_t) {0};
 }
 
+/*
+ * Allocate the slot right after @prev for swap cache, if it is free, so that
+ * the neighbours of a page in its object end up next to it in swap: their
+ * writes can be merged and swap readahead finds them.  Returns a null entry
+ * if the slot is taken, and the caller should fall back to get_swap_page().
+ */
+swp_entry_t get_swap_page_after(swp_entry_t prev)
+{
+	struct swap_info_struct *si;
+	unsigned long type = swp_type(prev);
+	pgoff_t offset = swp_offset(prev) + 1;
+
+	spin_lock(&swap_lock);
+	if (nr_swap_pages <= 0 || type >= nr_swapfiles)
+		goto noswap;
+	si = swap_info[type];
+	/* leave discard clusters to scan_swap_map() */
+	if (!(si->flags & SWP_WRITEOK) || (si->flags & SWP_DISCARDABLE))
+		goto noswap;
+	if (offset < si->lowest_bit || offset > si->highest_bit)
+		goto noswap;
+	if (si->swap_map[offset])
+		goto noswap;
+
+	if (offset == si->lowest_bit)
+		si->lowest_bit++;
+	if (offset == si->highest_bit)
+		si->highest_bit--;
+	si->inuse_pages++;
+	if (si->inuse_pages == si->pages) {
+		si->lowest_bit = si->max;
+		si->highest_bit = 0;
+	}
+	si->swap_map[offset] = SWAP_HAS_CACHE;
+	nr_swap_pages--;
+	spin_unlock(&swap_lock);
+	return swp_entry(type, offset);
+
+noswap:
+	spin_unlock(&swap_lock);
+	return (swp_entry_t) {0};
+}
+
 static struct swap_info_struct *swap_info_get(swp_entry_t entry)
 {
 	struct swap_info_struct *p;
@@ -182,6 +182,41 @@ int invalidate_inode_page(struct page *page)
 	return invalidate_complete_page(mapping, page);
 }
 
+/*
+ * Drop the shadow entries that evicted pages left in [start, end], see
+ * mm/workingset.c.  They must not outlive the range they describe.
+ */
+static void clear_shadow_entries(struct address_space *mapping,
+				 pgoff_t start, pgoff_t end)
+{
+	unsigned long indices[PAGEVEC_SIZE];
+	void **slots[PAGEVEC_SIZE];
+	pgoff_t index = start;
+	unsigned int nr, i;
+
+	while (mapping->nrshadows && index <= end) {
+		spin_lock_irq(&mapping->tree_lock);
+		nr = radix_tree_gang_lookup_slot(&mapping->page_tree,
+				slots, indices, index, PAGEVEC_SIZE);
+		for (i = 0; i < nr && indices[i] <= end; i++) {
+			void *entry = radix_tree_deref_slot(slots[i]);
+
+			if (!radix_tree_exceptional_entry(entry))
+				continue;
+			radix_tree_delete(&mapping->page_tree, indices[i]);
+			workingset_forget(mapping, entry);
+		}
+		spin_unlock_irq(&mapping->tree_lock);
+
+		if (!nr)
+			break;
+		index = indices[nr - 1] + 1;
+		if (!index)
+			break;	/* wraparound */
+		cond_resched();
+	}
+}
+
 /**
  * truncate_inode_pages - truncate range of pages specified by start & end byte offsets
  * @mapping: mapping to truncate
@@ -215,7 +250,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	pgoff_t next;
 	int i;
 
-	if (mapping->nrpages == 0)
+	if (mapping->nrpages == 0 && mapping->nrshadows == 0)
 		return;
 
 	BUG_ON((lend & (PAGE_CACHE_SIZE - 1)) != (PAGE_CACHE_SIZE - 1));
@@ -290,6 +325,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		pagevec_release(&pvec);
 		mem_cgroup_uncharge_end();
 	}
+	clear_shadow_entries(mapping, start, end);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
 
@@ -387,7 +423,7 @@ invalidate_complete_page2(struct address_space *mapping, struct page *page)
 
 	clear_page_mlock(page);
 	BUG_ON(page_has_private(page));
-	__remove_from_page_cache(page);
+	__remove_from_page_cache(page, NULL);
 	spin_unlock_irq(&mapping->tree_lock);
 	mem_cgroup_uncharge_cache_page(page);
 	page_cache_release(page);	/* pagecache ref */
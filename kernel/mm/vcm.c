@@ -20,6 +20,9 @@
 #include <linux/err.h>
 #include <linux/slab.h>
 #include <linux/genalloc.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/dma-mapping.h>
 #include <asm/cacheflush.h>
@@ -331,6 +334,36 @@ void vcm_deactivate(struct vcm *vcm)
 EXPORT_SYMBOL_GPL(vcm_deactivate);
 
 
+/******************************** Statistics ********************************/
+
+/* Protects the stats of all contexts; the VMM driver has no lock. */
+static DEFINE_SPINLOCK(vcm_stats_lock);
+
+static void __vcm_stats_map(struct vcm *vcm, resource_size_t size,
+			    unsigned long entries, ktime_t start)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	unsigned long flags;
+
+	spin_lock_irqsave(&vcm_stats_lock, flags);
+	++vcm->stats.binds;
+	vcm->stats.pages   += size >> PAGE_SHIFT;
+	vcm->stats.entries += entries;
+	vcm->stats.map_ns  += ns;
+	spin_unlock_irqrestore(&vcm_stats_lock, flags);
+}
+
+static void __vcm_stats_unmap(struct vcm *vcm, ktime_t start)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	unsigned long flags;
+
+	spin_lock_irqsave(&vcm_stats_lock, flags);
+	vcm->stats.unmap_ns += ns;
+	spin_unlock_irqrestore(&vcm_stats_lock, flags);
+}
+
+
 /****************************** VCM VMM driver ******************************/
 
 static void vcm_vmm_cleanup(struct vcm *vcm)
@@ -351,6 +384,35 @@ static void vcm_vmm_unreserve(struct vcm_res *res)
 	kfree(res);
 }
 
+/*
+ * If @phys is a single physically contiguous run of lowmem pages,
+ * returns the first of them.  Such memory is already mapped by the
+ * kernel's linear mapping (with section entries on ARM) so there is
+ * no need to create another mapping page by page.
+ */
+static struct page *vcm_vmm_linear(const struct vcm_phys *phys)
+{
+	const struct vcm_phys_part *part = phys->parts;
+	unsigned i = phys->count;
+	unsigned long pfn;
+
+	if (!part->page)
+		return NULL;
+
+	pfn = page_to_pfn(part->page);
+	do {
+		if (!part->page || page_to_pfn(part->page) != pfn)
+			return NULL;
+		pfn += part->size >> PAGE_SHIFT;
+	} while (++part, --i);
+
+	/* Lowmem is below highmem so checking the last page is enough. */
+	if (PageHighMem(pfn_to_page(pfn - 1)))
+		return NULL;
+
+	return phys->parts->page;
+}
+
 struct vcm_res *vcm_vmm_map(struct vcm *vcm, struct vcm_phys *phys,
 			    unsigned flags)
 {
@@ -358,21 +420,30 @@ struct vcm_res *vcm_vmm_map(struct vcm *vcm, struct vcm_phys *phys,
 	 * Original implementation written by Cho KyongHo
 	 * (pullip.cho@samsung.com).  Later rewritten by mina86.
 	 */
+	ktime_t start = ktime_get();
 	struct vcm_phys_part *part;
-	struct page **pages, **p;
+	struct page **pages, **p, *first;
 	struct vcm_res *res;
 	int ret = -ENOMEM;
 	unsigned i;
 
+	res = kmalloc(sizeof *res, GFP_KERNEL);
+	if (!res)
+		return ERR_PTR(-ENOMEM);
+	res->res_size = phys->size;
+
+	first = vcm_vmm_linear(phys);
+	if (first) {
+		res->start = (dma_addr_t)page_address(first);
+		__vcm_stats_map(vcm, phys->size, 1, start);
+		return res;
+	}
+
 	pages = kmalloc((phys->size >> PAGE_SHIFT) * sizeof *pages, GFP_KERNEL);
 	if (!pages)
-		return ERR_PTR(-ENOMEM);
+		goto error_res;
 	p = pages;
 
-	res = kmalloc(sizeof *res, GFP_KERNEL);
-	if (!res)
-		goto error_pages;
-
 	i    = phys->count;
 	part = phys->parts;
 	do {
@@ -385,26 +456,32 @@ struct vcm_res *vcm_vmm_map(struct vcm *vcm, struct vcm_phys *phys,
 		} while (--j);
 	} while (++part, --i);
 
+	/* vmap() flushes caches and TLB once for the whole area. */
 	res->start = (dma_addr_t)vmap(pages, p - pages, VM_ALLOC, PAGE_KERNEL);
 	if (!res->start)
-		goto error_res;
+		goto error_pages;
 
 	kfree(pages);
-	res->res_size = phys->size;
+	__vcm_stats_map(vcm, phys->size, phys->size >> PAGE_SHIFT, start);
 	return res;
 
 error_notsupp:
 	ret = -EOPNOTSUPP;
-error_res:
-	kfree(res);
 error_pages:
 	kfree(pages);
+error_res:
+	kfree(res);
 	return ERR_PTR(ret);
 }
 
 static void vcm_vmm_unbind(struct vcm_res *res)
 {
-	vunmap((void *)res->start);
+	ktime_t start = ktime_get();
+
+	/* Bindings using the linear mapping have nothing to unmap. */
+	if (is_vmalloc_addr((void *)res->start))
+		vunmap((void *)res->start);
+	__vcm_stats_unmap(res->vcm, start);
 }
 
 static int vcm_vmm_activate(struct vcm *vcm)
@@ -438,6 +515,47 @@ struct vcm vcm_vmm[1] = { {
 } };
 EXPORT_SYMBOL_GPL(vcm_vmm);
 
+#ifdef CONFIG_DEBUG_FS
+
+static int vcm_vmm_stats_show(struct seq_file *s, void *unused)
+{
+	struct vcm_stats stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vcm_stats_lock, flags);
+	stats = vcm_vmm->stats;
+	spin_unlock_irqrestore(&vcm_stats_lock, flags);
+
+	seq_printf(s, "binds:    %lu\n", stats.binds);
+	seq_printf(s, "pages:    %lu\n", stats.pages);
+	seq_printf(s, "entries:  %lu\n", stats.entries);
+	seq_printf(s, "map ns:   %llu\n", (unsigned long long)stats.map_ns);
+	seq_printf(s, "unmap ns: %llu\n",
+		   (unsigned long long)stats.unmap_ns);
+	return 0;
+}
+
+static int vcm_vmm_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vcm_vmm_stats_show, NULL);
+}
+
+static const struct file_operations vcm_vmm_stats_fops = {
+	.open		= vcm_vmm_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init vcm_vmm_debugfs_init(void)
+{
+	debugfs_create_file("vcm_vmm", 0444, NULL, NULL, &vcm_vmm_stats_fops);
+	return 0;
+}
+late_initcall(vcm_vmm_debugfs_init);
+
+#endif
+
 
 /****************************** VCM Drivers API *****************************/
 
@@ -449,6 +567,7 @@ struct vcm *__must_check vcm_init(struct vcm *vcm)
 		return ERR_PTR(-EINVAL);
 
 	atomic_set(&vcm->activations, 0);
+	memset(&vcm->stats, 0, sizeof vcm->stats);
 
 	return vcm;
 }
@@ -514,26 +633,55 @@ vcm_mmu_phys(struct vcm *vcm, resource_size_t size, unsigned flags)
 					   vcm)->driver->orders);
 }
 
+static int __vcm_mmu_count_entry(dma_addr_t vaddr, dma_addr_t paddr,
+				 unsigned order, void *priv)
+{
+	++*(unsigned long *)priv;
+	return 0;
+}
+
 static int __must_check
 __vcm_mmu_activate(struct vcm_res *res, struct vcm_phys *phys)
 {
 	struct vcm_mmu *mmu = container_of(res->vcm, struct vcm_mmu, vcm);
-	if (mmu->driver->activate)
-		return mmu->driver->activate(res, phys);
+	unsigned long entries = 0;
+	ktime_t start;
+	int ret;
 
-	return vcm_phys_walk(res->start, phys, mmu->driver->orders,
-			     mmu->driver->activate_page,
-			     mmu->driver->deactivate_page, res->vcm);
+	vcm_phys_walk(res->start, phys, mmu->driver->orders,
+		      __vcm_mmu_count_entry, NULL, &entries);
+
+	start = ktime_get();
+	if (mmu->driver->activate) {
+		ret = mmu->driver->activate(res, phys);
+	} else {
+		ret = vcm_phys_walk(res->start, phys, mmu->driver->orders,
+				    mmu->driver->activate_page,
+				    mmu->driver->deactivate_page, res->vcm);
+		if (mmu->driver->flush)
+			mmu->driver->flush(res->vcm);
+	}
+
+	if (ret >= 0)
+		__vcm_stats_map(res->vcm, phys->size, entries, start);
+	return ret;
 }
 
 static void __vcm_mmu_deactivate(struct vcm_res *res, struct vcm_phys *phys)
 {
 	struct vcm_mmu *mmu = container_of(res->vcm, struct vcm_mmu, vcm);
-	if (mmu->driver->deactivate)
-		return mmu->driver->deactivate(res, phys);
+	ktime_t start = ktime_get();
 
-	vcm_phys_walk(res->start, phys, mmu->driver->orders,
-		      mmu->driver->deactivate_page, NULL, res->vcm);
+	if (mmu->driver->deactivate) {
+		mmu->driver->deactivate(res, phys);
+	} else {
+		vcm_phys_walk(res->start, phys, mmu->driver->orders,
+			      mmu->driver->deactivate_page, NULL, res->vcm);
+		if (mmu->driver->flush)
+			mmu->driver->flush(res->vcm);
+	}
+
+	__vcm_stats_unmap(res->vcm, start);
 }
 
 static int vcm_mmu_bind(struct vcm_res *_res, struct vcm_phys *phys)
@@ -617,7 +765,7 @@ static void vcm_mmu_deactivate(struct vcm *vcm)
 	mmu->activated = 0;
 
 	list_for_each_entry(r, &mmu->bound_res, bound)
-		mmu->driver->deactivate(&r->res, r->res.phys);
+		__vcm_mmu_deactivate(&r->res, r->res.phys);
 
 	spin_unlock_irqrestore(&mmu->lock, flags);
 }
@@ -948,34 +1096,33 @@ static inline bool is_of_order(dma_addr_t size, unsigned order)
 	return !(size & (((dma_addr_t)PAGE_SIZE << order) - 1));
 }
 
+/*
+ * Walks a physically contiguous run picking for each page the largest
+ * order both addresses are aligned to and which fits in what is left,
+ * so that a run which starts unaligned still gets large pages once
+ * alignment is reached.
+ */
 static int
-__vcm_phys_walk_part(dma_addr_t vaddr, const struct vcm_phys_part *part,
-		     const unsigned char *orders,
-		     int (*callback)(dma_addr_t vaddr, dma_addr_t paddr,
-				     unsigned order, void *priv), void *priv,
-		     unsigned *limit)
+__vcm_phys_walk_run(dma_addr_t vaddr, dma_addr_t paddr, resource_size_t size,
+		    const unsigned char *orders,
+		    int (*callback)(dma_addr_t vaddr, dma_addr_t paddr,
+				    unsigned order, void *priv), void *priv,
+		    unsigned *limit)
 {
-	resource_size_t size = part->size;
-	dma_addr_t paddr = part->start;
-	resource_size_t ps;
-
-	while (!is_of_order(vaddr, *orders))
-		++orders;
-	while (!is_of_order(paddr, *orders))
-		++orders;
-
-	ps = PAGE_SIZE << *orders;
 	for (; *limit && size; --*limit) {
+		const unsigned char *o = orders;
+		resource_size_t ps;
 		int ret;
 
-		while (ps > size)
-			ps = PAGE_SIZE << *++orders;
+		while (!is_of_order(vaddr | paddr, *o) ||
+		       ((resource_size_t)PAGE_SIZE << *o) > size)
+			++o;
 
-		ret = callback(vaddr, paddr, *orders, priv);
+		ret = callback(vaddr, paddr, *o, priv);
 		if (ret < 0)
 			return ret;
 
-		ps = PAGE_SIZE << *orders;
+		ps = (resource_size_t)PAGE_SIZE << *o;
 		vaddr += ps;
 		paddr += ps;
 		size  -= ps;
@@ -1005,13 +1152,22 @@ int vcm_phys_walk(dma_addr_t _vaddr, const struct vcm_phys *phys,
 		dma_addr_t vaddr = _vaddr;
 		int ret = 0;
 
-		for (; count && limit; --count, ++part) {
-			ret = __vcm_phys_walk_part(vaddr, part, orders,
-						   callback, priv, &limit);
+		while (count && limit) {
+			dma_addr_t paddr = part->start;
+			resource_size_t size = part->size;
+
+			/* Merge physically adjacent parts into one run. */
+			for (++part, --count;
+			     count && part->start == paddr + size;
+			     ++part, --count)
+				size += part->size;
+
+			ret = __vcm_phys_walk_run(vaddr, paddr, size, orders,
+						  callback, priv, &limit);
 			if (ret)
 				break;
 
-			vaddr += part->size;
+			vaddr += size;
 		}
 
 		if (r)
@@ -0,0 +1,133 @@
+/*
+ * mm/vmacache.c
+ *
+ * Per-thread cache of the vmas last returned by find_vma().
+ *
+ * A single cached vma per mm keeps getting replaced when several threads
+ * of a process fault in different areas.  Instead, every thread keeps a
+ * few vmas of its own, indexed by a hash of the address they were looked
+ * up for.  Nothing is taken off the caches when a vma goes away: the mm
+ * sequence number is bumped, and each thread throws its cache away the
+ * next time it finds its copy of the number out of date.
+ */
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/vmstat.h>
+#include <linux/vmacache.h>
+
+/*
+ * The sequence number of @mm has wrapped around, so a thread that has
+ * not looked at its cache for 2^32 invalidations could mistake a stale
+ * cache for a valid one.  Flush the caches of all threads using @mm.
+ */
+void vmacache_flush_all(struct mm_struct *mm)
+{
+	struct task_struct *g, *p;
+
+	/*
+	 * Single threaded tasks need not iterate the entire list of
+	 * processes.  We can avoid the flushing as well since the mm's
+	 * seqnum was increased and don't have to worry about other
+	 * threads' seqnum.  Current's flush will occur upon the next
+	 * lookup.
+	 */
+	if (atomic_read(&mm->mm_users) == 1)
+		return;
+
+	read_lock(&tasklist_lock);
+	do_each_thread(g, p) {
+		/*
+		 * Only flush the vmacache pointers as the mm seqnum is
+		 * already set and curr's will be set upon invalidation
+		 * when the next lookup is done.
+		 */
+		if (mm == p->mm)
+			vmacache_flush(p);
+	} while_each_thread(g, p);
+	read_unlock(&tasklist_lock);
+}
+
+/*
+ * Kernel threads borrowing an mm and lookups in the mm of another task,
+ * as done by ptrace and /proc, must not use or fill current's cache.
+ */
+static bool vmacache_valid_mm(struct mm_struct *mm)
+{
+	return current->mm == mm && !(current->flags & PF_KTHREAD);
+}
+
+void vmacache_update(unsigned long addr, struct vm_area_struct *newvma)
+{
+	if (vmacache_valid_mm(newvma->vm_mm))
+		current->vmacache[VMACACHE_HASH(addr)] = newvma;
+}
+
+static bool vmacache_valid(struct mm_struct *mm)
+{
+	struct task_struct *curr;
+
+	if (!vmacache_valid_mm(mm))
+		return false;
+
+	curr = current;
+	if (mm->vmacache_seqnum != curr->vmacache_seqnum) {
+		/*
+		 * First attempt will always be invalid, initialize
+		 * the new cache for this task here.
+		 */
+		curr->vmacache_seqnum = mm->vmacache_seqnum;
+		vmacache_flush(curr);
+		return false;
+	}
+	return true;
+}
+
+struct vm_area_struct *vmacache_find(struct mm_struct *mm, unsigned long addr)
+{
+	int i;
+
+	count_vm_event(VMACACHE_FIND_CALLS);
+
+	if (!vmacache_valid(mm))
+		return NULL;
+
+	for (i = 0; i < VMACACHE_SIZE; i++) {
+		struct vm_area_struct *vma = current->vmacache[i];
+
+		if (!vma)
+			continue;
+		if (WARN_ON_ONCE(vma->vm_mm != mm))
+			break;
+		if (vma->vm_start <= addr && vma->vm_end > addr) {
+			count_vm_event(VMACACHE_FIND_HITS);
+			return vma;
+		}
+	}
+
+	return NULL;
+}
+
+#ifndef CONFIG_MMU
+struct vm_area_struct *vmacache_find_exact(struct mm_struct *mm,
+					   unsigned long start,
+					   unsigned long end)
+{
+	int i;
+
+	count_vm_event(VMACACHE_FIND_CALLS);
+
+	if (!vmacache_valid(mm))
+		return NULL;
+
+	for (i = 0; i < VMACACHE_SIZE; i++) {
+		struct vm_area_struct *vma = current->vmacache[i];
+
+		if (vma && vma->vm_start == start && vma->vm_end == end) {
+			count_vm_event(VMACACHE_FIND_HITS);
+			return vma;
+		}
+	}
+
+	return NULL;
+}
+#endif
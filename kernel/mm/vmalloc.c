@@ -26,6 +26,7 @@
 #include <linux/rcupdate.h>
 #include <linux/pfn.h>
 #include <linux/kmemleak.h>
+#include <linux/workqueue.h>
 #include <asm/atomic.h>
 #include <asm/uaccess.h>
 #include <asm/tlbflush.h>
@@ -512,6 +513,52 @@ static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
 /* for per-CPU blocks */
 static void purge_fragmented_blocks_allcpus(void);
 
+/*
+ * Purged areas closer to each other than VMAP_FLUSH_GAP are flushed as one
+ * range.  If the ranges add up to more than VMAP_FLUSH_ALL_PAGES the whole
+ * TLB is flushed instead: on many CPUs (ARM among them) a kernel range flush
+ * goes page by page, while flushing everything is a single operation.
+ */
+#define VMAP_FLUSH_GAP		(16 * PAGE_SIZE)
+#define VMAP_FLUSH_ALL_PAGES	512
+
+/*
+ * Walks the areas on valist, which is sorted by address, merging them into
+ * ranges.  Flushes the ranges if flush is set.  Returns the number of pages
+ * the ranges cover.
+ */
+static unsigned long flush_vmap_area_ranges(struct list_head *valist,
+					    int flush)
+{
+	unsigned long start = 0, end = 0, pages = 0;
+	struct vmap_area *va;
+
+	list_for_each_entry(va, valist, purge_list) {
+		if (end && va->va_start <= end + VMAP_FLUSH_GAP) {
+			end = va->va_end;
+			continue;
+		}
+		if (end) {
+			pages += (end - start) >> PAGE_SHIFT;
+			if (flush) {
+				flush_tlb_kernel_range(start, end);
+				count_vm_event(VMAP_FLUSH_RANGE);
+			}
+		}
+		start = va->va_start;
+		end = va->va_end;
+	}
+	if (end) {
+		pages += (end - start) >> PAGE_SHIFT;
+		if (flush) {
+			flush_tlb_kernel_range(start, end);
+			count_vm_event(VMAP_FLUSH_RANGE);
+		}
+	}
+
+	return pages;
+}
+
 /*
  * Purges all lazily-freed vmap areas.
  *
@@ -526,6 +573,7 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 					int sync, int force_flush)
 {
 	static DEFINE_SPINLOCK(purge_lock);
+	unsigned long fstart = *start, fend = *end;
 	LIST_HEAD(valist);
 	struct vmap_area *va;
 	struct vmap_area *n_va;
@@ -561,11 +609,31 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	}
 	rcu_read_unlock();
 
-	if (nr)
+	if (nr) {
 		atomic_sub(nr, &vmap_lazy_nr);
+		count_vm_event(VMAP_PURGE);
+		count_vm_events(VMAP_PURGE_PAGES, nr);
+	}
 
-	if (nr || force_flush)
-		flush_tlb_kernel_range(*start, *end);
+	/* The caller's own range is not merged with the purged areas. */
+	if (!force_flush || fstart >= fend)
+		fstart = fend = 0;
+
+	if (nr || fstart < fend) {
+		unsigned long pages = flush_vmap_area_ranges(&valist, 0);
+
+		pages += (fend - fstart) >> PAGE_SHIFT;
+		if (pages > VMAP_FLUSH_ALL_PAGES) {
+			flush_tlb_all();
+			count_vm_event(VMAP_FLUSH_ALL);
+		} else {
+			if (fstart < fend) {
+				flush_tlb_kernel_range(fstart, fend);
+				count_vm_event(VMAP_FLUSH_RANGE);
+			}
+			flush_vmap_area_ranges(&valist, 1);
+		}
+	}
 
 	if (nr) {
 		spin_lock(&vmap_area_lock);
@@ -597,16 +665,37 @@ static void purge_vmap_area_lazy(void)
 	__purge_vmap_area_lazy(&start, &end, 1, 0);
 }
 
+/*
+ * Purging from the context of whoever happened to free the area which went
+ * over lazy_max_pages makes that caller pay for everybody's unmaps, so the
+ * purge is handed over to keventd instead.
+ */
+static void purge_vmap_area_work(struct work_struct *work)
+{
+	purge_vmap_area_lazy();
+}
+
+static DECLARE_WORK(vmap_purge_work, purge_vmap_area_work);
+
 /*
  * Free and unmap a vmap area, caller ensuring flush_cache_vunmap had been
  * called for the correct range previously.
  */
 static void free_unmap_vmap_area_noflush(struct vmap_area *va)
 {
+	int nr;
+
 	va->flags |= VM_LAZY_FREE;
-	atomic_add((va->va_end - va->va_start) >> PAGE_SHIFT, &vmap_lazy_nr);
-	if (unlikely(atomic_read(&vmap_lazy_nr) > lazy_max_pages()))
+	nr = atomic_add_return((va->va_end - va->va_start) >> PAGE_SHIFT,
+			       &vmap_lazy_nr);
+	if (likely(nr <= lazy_max_pages()))
+		return;
+
+	/* Purge here if keventd is not up yet or cannot keep up. */
+	if (!keventd_up() || nr > 2 * lazy_max_pages())
 		try_purge_vmap_area_lazy();
+	else
+		schedule_work(&vmap_purge_work);
 }
 
 /*
@@ -40,6 +40,10 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/compaction.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/pid_namespace.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -52,6 +56,12 @@ struct scan_control {
 	/* Incremented by the number of inactive pages that were scanned */
 	unsigned long nr_scanned;
 
+	/*
+	 * Incremented by the number of pages isolated for shrink_page_list(),
+	 * which, unlike nr_scanned, counts each of them once
+	 */
+	unsigned long nr_isolated;
+
 	/* Number of pages freed so far during a call to shrink_zones() */
 	unsigned long nr_reclaimed;
 
@@ -407,9 +417,11 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
- * gets returned with a refcount of 0.
+ * gets returned with a refcount of 0.  Page cache pages that are @reclaimed
+ * leave a shadow entry behind for refault detection.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -454,7 +466,16 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		spin_unlock_irq(&mapping->tree_lock);
 		swapcache_free(swap, page);
 	} else {
-		__remove_from_page_cache(page);
+		void *shadow = NULL;
+
+		if (reclaimed && page_is_file_cache(page)) {
+			shadow = workingset_eviction(page);
+			if (PageRaUnused(page)) {
+				mapping->ra_wasted++;
+				count_vm_event(READAHEAD_WASTED);
+			}
+		}
+		__remove_from_page_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 	}
@@ -474,7 +495,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -632,6 +653,8 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 	cond_resched();
 
 	pagevec_init(&freed_pvec, 1);
+	/* Pages isolated together mostly belong to the same memcg */
+	mem_cgroup_uncharge_start();
 	while (!list_empty(page_list)) {
 		enum page_references references;
 		struct address_space *mapping;
@@ -793,7 +816,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -832,6 +855,7 @@ keep:
 		list_add(&page->lru, &ret_pages);
 		VM_BUG_ON(PageLRU(page) || PageUnevictable(page));
 	}
+	mem_cgroup_uncharge_end();
 	list_splice(&ret_pages, page_list);
 	if (pagevec_count(&freed_pvec))
 		__pagevec_free(&freed_pvec);
@@ -1111,6 +1135,42 @@ static int too_many_isolated(struct zone *zone, int file,
 	return isolated > inactive;
 }
 
+/*
+ * Put back any unfreeable pages left over by shrink_page_list().  Called
+ * with zone->lru_lock held and interrupts disabled, may drop the lock.
+ */
+static void putback_inactive_pages(struct zone *zone,
+				   struct zone_reclaim_stat *reclaim_stat,
+				   struct list_head *page_list,
+				   struct pagevec *pvec)
+{
+	while (!list_empty(page_list)) {
+		struct page *page = lru_to_page(page_list);
+		int lru;
+
+		VM_BUG_ON(PageLRU(page));
+		list_del(&page->lru);
+		if (unlikely(!page_evictable(page, NULL))) {
+			spin_unlock_irq(&zone->lru_lock);
+			putback_lru_page(page);
+			spin_lock_irq(&zone->lru_lock);
+			continue;
+		}
+		SetPageLRU(page);
+		lru = page_lru(page);
+		add_page_to_lru_list(zone, page, lru);
+		if (is_active_lru(lru)) {
+			int file = is_file_lru(lru);
+			reclaim_stat->recent_rotated[file]++;
+		}
+		if (!pagevec_add(pvec, page)) {
+			spin_unlock_irq(&zone->lru_lock);
+			__pagevec_release(pvec);
+			spin_lock_irq(&zone->lru_lock);
+		}
+	}
+}
+
 /*
  * shrink_inactive_list() is a helper for shrink_zone().  It returns the number
  * of reclaimed pages
@@ -1139,7 +1199,6 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 	lru_add_drain();
 	spin_lock_irq(&zone->lru_lock);
 	do {
-		struct page *page;
 		unsigned long nr_taken;
 		unsigned long nr_scan;
 		unsigned long nr_freed;
@@ -1199,6 +1258,7 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 		spin_unlock_irq(&zone->lru_lock);
 
 		nr_scanned += nr_scan;
+		sc->nr_isolated += nr_taken;
 		nr_freed = shrink_page_list(&page_list, sc, PAGEOUT_IO_ASYNC);
 
 		/*
@@ -1230,33 +1290,7 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 		__count_zone_vm_events(PGSTEAL, zone, nr_freed);
 
 		spin_lock(&zone->lru_lock);
-		/*
-		 * Put back any unfreeable pages.
-		 */
-		while (!list_empty(&page_list)) {
-			int lru;
-			page = lru_to_page(&page_list);
-			VM_BUG_ON(PageLRU(page));
-			list_del(&page->lru);
-			if (unlikely(!page_evictable(page, NULL))) {
-				spin_unlock_irq(&zone->lru_lock);
-				putback_lru_page(page);
-				spin_lock_irq(&zone->lru_lock);
-				continue;
-			}
-			SetPageLRU(page);
-			lru = page_lru(page);
-			add_page_to_lru_list(zone, page, lru);
-			if (is_active_lru(lru)) {
-				int file = is_file_lru(lru);
-				reclaim_stat->recent_rotated[file]++;
-			}
-			if (!pagevec_add(&pvec, page)) {
-				spin_unlock_irq(&zone->lru_lock);
-				__pagevec_release(&pvec);
-				spin_lock_irq(&zone->lru_lock);
-			}
-		}
+		putback_inactive_pages(zone, reclaim_stat, &page_list, &pvec);
 		__mod_zone_page_state(zone, NR_ISOLATED_ANON, -nr_anon);
 		__mod_zone_page_state(zone, NR_ISOLATED_FILE, -nr_file);
 
@@ -1658,6 +1692,666 @@ static void set_lumpy_reclaim_mode(int priority, struct scan_control *sc)
 		sc->lumpy_reclaim_mode = 0;
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * Multi-generational LRU, see Documentation/vm/multigen_lru.txt.
+ *
+ * Eviction takes pages from the oldest generation of a zone and runs
+ * them through shrink_page_list() like the inactive list.  Aging opens
+ * a new generation in every zone and then walks the page tables of
+ * running processes, moving each page found through a young pte into
+ * the new generation.  Walking page tables touches the ptes of many
+ * pages in a row, which is a lot cheaper than chasing the reverse
+ * mappings of every candidate page.
+ */
+#ifdef CONFIG_LRU_GEN_ENABLED
+int lru_gen_mode __read_mostly = 1;
+#else
+int lru_gen_mode __read_mostly;
+#endif
+
+static int __init lru_gen_setup(char *str)
+{
+	lru_gen_mode = !!simple_strtoul(str, NULL, 0);
+	return 1;
+}
+__setup("lru_gen=", lru_gen_setup);
+
+/*
+ * How many mm_structs the aging walk pins at a time, and all that
+ * direct reclaim walks; kswapd walks on to the last process.
+ */
+#define LRU_GEN_MM_BATCH	16
+
+/* Serializes aging, and protects the pid the walk goes on from */
+static DEFINE_MUTEX(lru_gen_aging_mutex);
+static int lru_gen_next_pid = 1;
+
+void __paginginit lru_gen_init_zone(struct zone *zone)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	int gen, file;
+
+	lrugen->max_seq = MIN_NR_GENS + 1;
+	lrugen->min_seq[0] = 0;
+	lrugen->min_seq[1] = 0;
+	for (gen = 0; gen < MAX_NR_GENS; gen++) {
+		for (file = 0; file < 2; file++) {
+			INIT_LIST_HEAD(&lrugen->lists[gen][file]);
+			lrugen->nr_pages[gen][file] = 0;
+		}
+		lrugen->timestamps[gen] = jiffies;
+	}
+}
+
+/*
+ * Retire the oldest generation of @file pages if it is empty and more
+ * than MIN_NR_GENS generations are left.  Called with lru_lock held.
+ */
+static bool lru_gen_try_inc_min_seq(struct zone *zone, int file)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	int gen = lru_gen_from_seq(lrugen->min_seq[file]);
+
+	if (lrugen->max_seq - lrugen->min_seq[file] < MIN_NR_GENS)
+		return false;
+
+	if (!list_empty(&lrugen->lists[gen][file]))
+		return false;
+
+	VM_BUG_ON(lrugen->nr_pages[gen][file]);
+	lrugen->min_seq[file]++;
+	return true;
+}
+
+/*
+ * Make room for a new generation by merging the oldest generation of
+ * @file pages into the next one.  Both are inactive, so the zone
+ * statistics do not change.  Without swap the oldest anon generation
+ * collects every anon page, so lru_lock is dropped now and then.
+ */
+static void lru_gen_fold_min_seq(struct zone *zone, int file)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	unsigned long seq = lrugen->min_seq[file];
+	int old_gen = lru_gen_from_seq(seq);
+	int new_gen = lru_gen_from_seq(seq + 1);
+	struct list_head *head = &lrugen->lists[old_gen][file];
+	int batch = 0;
+
+	while (!list_empty(head)) {
+		struct page *page = list_first_entry(head, struct page, lru);
+
+		/* the youngest page of the old generation goes first */
+		set_page_lru_gen(page, new_gen);
+		list_move_tail(&page->lru, &lrugen->lists[new_gen][file]);
+		lrugen->nr_pages[old_gen][file]--;
+		lrugen->nr_pages[new_gen][file]++;
+
+		if (++batch == SWAP_CLUSTER_MAX) {
+			batch = 0;
+			spin_unlock_irq(&zone->lru_lock);
+			cond_resched();
+			spin_lock_irq(&zone->lru_lock);
+		}
+	}
+
+	/* eviction may have emptied and retired it while we slept */
+	if (lrugen->min_seq[file] == seq)
+		lrugen->min_seq[file]++;
+}
+
+/*
+ * Open a new youngest generation.  The second youngest generation turns
+ * inactive, so its pages are moved over in the zone statistics.
+ */
+static void lru_gen_inc_max_seq(struct zone *zone)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	int gen, file;
+
+	spin_lock_irq(&zone->lru_lock);
+	for (file = 0; file < 2; file++) {
+		while (lru_gen_try_inc_min_seq(zone, file))
+			;
+		if (lrugen->max_seq - lrugen->min_seq[file] + 1 >= MAX_NR_GENS)
+			lru_gen_fold_min_seq(zone, file);
+	}
+
+	gen = lru_gen_from_seq(lrugen->max_seq - 1);
+	for (file = 0; file < 2; file++) {
+		long delta = lrugen->nr_pages[gen][file];
+
+		__mod_zone_page_state(zone,
+			NR_LRU_BASE + file * LRU_FILE + LRU_ACTIVE, -delta);
+		__mod_zone_page_state(zone,
+			NR_LRU_BASE + file * LRU_FILE, delta);
+	}
+
+	lrugen->max_seq++;
+	lrugen->timestamps[lru_gen_from_seq(lrugen->max_seq)] = jiffies;
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+/*
+ * Move the pages found accessed by the page table walk into the youngest
+ * generation of their zone, and drop the references the walk took.
+ */
+static void lru_gen_promote_pages(struct pagevec *pvec)
+{
+	struct zone *zone = NULL;
+	int i;
+
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		struct page *page = pvec->pages[i];
+		struct zone *pagezone = page_zone(page);
+		int gen;
+
+		if (pagezone != zone) {
+			if (zone)
+				spin_unlock_irq(&zone->lru_lock);
+			zone = pagezone;
+			spin_lock_irq(&zone->lru_lock);
+		}
+
+		gen = page_lru_gen(page);
+		if (!PageLRU(page) || gen < 0 ||
+		    gen == lru_gen_from_seq(zone->lrugen.max_seq))
+			continue;
+
+		lru_gen_del_page(zone, page, false);
+		lru_gen_add_page(zone, page, true);
+	}
+	if (zone)
+		spin_unlock_irq(&zone->lru_lock);
+	release_pages(pvec->pages, pvec->nr, pvec->cold);
+	pagevec_reinit(pvec);
+}
+
+static void lru_gen_walk_pte_range(struct vm_area_struct *vma, pmd_t *pmd,
+				   unsigned long addr, unsigned long end,
+				   struct pagevec *pvec)
+{
+	unsigned long start = addr;
+	unsigned long young = 0;
+	pte_t *pte, *orig_pte;
+	spinlock_t *ptl;
+
+	do {
+		orig_pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+		for (pte = orig_pte; addr != end && pagevec_space(pvec);
+		     pte++, addr += PAGE_SIZE) {
+			struct page *page;
+
+			if (!pte_present(*pte) || !pte_young(*pte))
+				continue;
+
+			page = vm_normal_page(vma, addr, *pte);
+			if (!page || !PageLRU(page))
+				continue;
+
+			if (!ptep_test_and_clear_young(vma, addr, pte))
+				continue;
+
+			young++;
+			get_page(page);
+			pagevec_add(pvec, page);
+		}
+		pte_unmap_unlock(orig_pte, ptl);
+
+		if (!pagevec_space(pvec))
+			lru_gen_promote_pages(pvec);
+	} while (addr != end);
+
+	if (young) {
+		flush_tlb_range(vma, start, end);
+		count_vm_events(LRU_GEN_YOUNG, young);
+	}
+}
+
+static void lru_gen_walk_pmd_range(struct vm_area_struct *vma, pud_t *pud,
+				   unsigned long addr, unsigned long end,
+				   struct pagevec *pvec)
+{
+	unsigned long next;
+	pmd_t *pmd;
+
+	pmd = pmd_offset(pud, addr);
+	do {
+		next = pmd_addr_end(addr, end);
+		if (pmd_none_or_clear_bad(pmd))
+			continue;
+		lru_gen_walk_pte_range(vma, pmd, addr, next, pvec);
+		cond_resched();
+	} while (pmd++, addr = next, addr != end);
+}
+
+static void lru_gen_walk_pud_range(struct vm_area_struct *vma, pgd_t *pgd,
+				   unsigned long addr, unsigned long end,
+				   struct pagevec *pvec)
+{
+	unsigned long next;
+	pud_t *pud;
+
+	pud = pud_offset(pgd, addr);
+	do {
+		next = pud_addr_end(addr, end);
+		if (pud_none_or_clear_bad(pud))
+			continue;
+		lru_gen_walk_pmd_range(vma, pud, addr, next, pvec);
+	} while (pud++, addr = next, addr != end);
+}
+
+static void lru_gen_walk_mm(struct mm_struct *mm, struct pagevec *pvec)
+{
+	struct vm_area_struct *vma;
+
+	/* an mm being changed is either exiting or about to fault anyway */
+	if (!down_read_trylock(&mm->mmap_sem))
+		return;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		unsigned long addr = vma->vm_start;
+		unsigned long end = vma->vm_end;
+		unsigned long next;
+		pgd_t *pgd;
+
+		if (vma->vm_flags & (VM_IO | VM_PFNMAP | VM_LOCKED |
+				     VM_HUGETLB))
+			continue;
+
+		pgd = pgd_offset(mm, addr);
+		do {
+			next = pgd_addr_end(addr, end);
+			if (pgd_none_or_clear_bad(pgd))
+				continue;
+			lru_gen_walk_pud_range(vma, pgd, addr, next, pvec);
+		} while (pgd++, addr = next, addr != end);
+	}
+
+	up_read(&mm->mmap_sem);
+}
+
+/*
+ * Pin the mm_structs of the next LRU_GEN_MM_BATCH processes, starting
+ * from pid *@next_pid.  Returns how many were found.
+ */
+static int lru_gen_get_mms(struct mm_struct **mms, int *next_pid)
+{
+	struct task_struct *task;
+	struct pid *pid;
+	int nr = 0;
+
+	rcu_read_lock();
+	while (nr < LRU_GEN_MM_BATCH) {
+		pid = find_ge_pid(*next_pid, &init_pid_ns);
+		if (!pid)
+			break;
+		*next_pid = pid_nr(pid) + 1;
+
+		task = pid_task(pid, PIDTYPE_PID);
+		if (!task || !thread_group_leader(task))
+			continue;
+
+		mms[nr] = get_task_mm(task);
+		if (mms[nr])
+			nr++;
+	}
+	rcu_read_unlock();
+
+	return nr;
+}
+
+/*
+ * Age all zones by one generation.  @max_seq is the youngest generation
+ * of @zone the caller saw; if somebody else aged in the meantime there
+ * is nothing left to do.
+ *
+ * The walk goes on from the process the previous one stopped at, so
+ * that the cost of aging is spread over the reclaimers: direct reclaim
+ * walks one batch of mm_structs, kswapd walks on to the last process.
+ * Pages of processes a walk did not get to are still caught by
+ * page_check_references() when they come up for eviction.
+ */
+static void lru_gen_age(struct zone *zone, unsigned long max_seq,
+			struct scan_control *sc)
+{
+	struct mm_struct *mms[LRU_GEN_MM_BATCH];
+	struct pagevec pvec;
+	struct zone *z;
+	int i, nr;
+
+	/*
+	 * The final mmput() of an mm that exited during the walk tears
+	 * down the address space, which must not happen from reclaim that
+	 * cannot recurse into the filesystem.  A new generation without a
+	 * walk would hold nothing but the pages activated since the last
+	 * one, so leave the aging to kswapd.
+	 */
+	if (!(sc->gfp_mask & __GFP_FS)) {
+		wakeup_kswapd(zone, sc->order);
+		return;
+	}
+
+	mutex_lock(&lru_gen_aging_mutex);
+	if (ACCESS_ONCE(zone->lrugen.max_seq) != max_seq) {
+		mutex_unlock(&lru_gen_aging_mutex);
+		return;
+	}
+
+	for_each_populated_zone(z)
+		lru_gen_inc_max_seq(z);
+	count_vm_event(LRU_GEN_AGING);
+
+	nr = lru_gen_get_mms(mms, &lru_gen_next_pid);
+	if (!nr) {
+		lru_gen_next_pid = 1;
+		nr = lru_gen_get_mms(mms, &lru_gen_next_pid);
+	}
+
+	pagevec_init(&pvec, 0);
+	for (;;) {
+		mutex_unlock(&lru_gen_aging_mutex);
+
+		for (i = 0; i < nr; i++) {
+			lru_gen_walk_mm(mms[i], &pvec);
+			mmput(mms[i]);
+		}
+		cond_resched();
+		if (!nr || !current_is_kswapd())
+			break;
+
+		mutex_lock(&lru_gen_aging_mutex);
+		nr = lru_gen_get_mms(mms, &lru_gen_next_pid);
+		if (!nr)
+			lru_gen_next_pid = 1;
+	}
+
+	if (pagevec_count(&pvec))
+		lru_gen_promote_pages(&pvec);
+}
+
+/*
+ * Lumpy reclaim: isolate the other pages of @file type in the @order
+ * aligned block around @page, like isolate_lru_pages().  Called with
+ * lru_lock held.  Returns how many were taken.
+ */
+static unsigned long lru_gen_isolate_block(struct zone *zone,
+		struct page *page, int order, int file, struct list_head *dst)
+{
+	unsigned long page_pfn = page_to_pfn(page);
+	unsigned long pfn = page_pfn & ~((1UL << order) - 1);
+	unsigned long end_pfn = pfn + (1UL << order);
+	int zone_id = page_zone_id(page);
+	unsigned long nr_taken = 0;
+
+	for (; pfn < end_pfn; pfn++) {
+		struct page *cursor_page;
+
+		/* The target page is in the block, ignore it. */
+		if (unlikely(pfn == page_pfn))
+			continue;
+
+		/* Avoid holes within the zone. */
+		if (unlikely(!pfn_valid_within(pfn)))
+			break;
+
+		cursor_page = pfn_to_page(pfn);
+
+		/* Check that we have not crossed a zone boundary. */
+		if (unlikely(page_zone_id(cursor_page) != zone_id))
+			continue;
+
+		/* Only the type being evicted, it is all counted as such */
+		if (page_is_file_cache(cursor_page) != file)
+			continue;
+
+		if (nr_swap_pages <= 0 && PageAnon(cursor_page) &&
+		    !PageSwapCache(cursor_page))
+			continue;
+
+		if (__isolate_lru_page(cursor_page, ISOLATE_BOTH, file) == 0) {
+			lru_gen_del_page(zone, cursor_page, false);
+			list_add(&cursor_page->lru, dst);
+			nr_taken++;
+		}
+	}
+	return nr_taken;
+}
+
+/*
+ * Evict the type whose oldest generation is older, file pages on a tie.
+ * Returns -1 if there is nothing to evict.
+ */
+static int lru_gen_pick_type(struct zone *zone, struct scan_control *sc)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	long nr[2] = { 0, 0 };
+	int gen, file;
+
+	for (gen = 0; gen < MAX_NR_GENS; gen++)
+		for (file = 0; file < 2; file++)
+			nr[file] += lrugen->nr_pages[gen][file];
+
+	if (!sc->may_swap || nr_swap_pages <= 0)
+		nr[0] = 0;
+
+	if (nr[0] <= 0)
+		return nr[1] > 0 ? 1 : -1;
+	if (nr[1] <= 0)
+		return 0;
+
+	return lrugen->min_seq[0] < lrugen->min_seq[1] ? 0 : 1;
+}
+
+static void lru_gen_shrink_zone(struct zone *zone, struct scan_control *sc,
+				int priority)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	struct zone_reclaim_stat *reclaim_stat = get_reclaim_stat(zone, sc);
+	unsigned long nr_reclaimed = sc->nr_reclaimed;
+	unsigned long nr_scanned = 0;
+	unsigned long nr_to_scan;
+	struct pagevec pvec;
+	int aged = 0;
+
+	nr_to_scan = zone_page_state(zone, NR_ACTIVE_FILE) +
+		     zone_page_state(zone, NR_INACTIVE_FILE);
+	if (sc->may_swap && nr_swap_pages > 0)
+		nr_to_scan += zone_page_state(zone, NR_ACTIVE_ANON) +
+			      zone_page_state(zone, NR_INACTIVE_ANON);
+	nr_to_scan >>= priority;
+
+	pagevec_init(&pvec, 1);
+	lru_add_drain();
+
+	while (nr_scanned < nr_to_scan) {
+		LIST_HEAD(page_list);
+		struct list_head *head;
+		unsigned long max_seq;
+		unsigned long nr_taken = 0;
+		unsigned long nr_scan;
+		unsigned long nr_freed;
+		int gen, file;
+
+		file = lru_gen_pick_type(zone, sc);
+		if (file < 0)
+			break;
+
+		while (unlikely(too_many_isolated(zone, file, sc))) {
+			congestion_wait(BLK_RW_ASYNC, HZ/10);
+
+			/* We are about to die and free our memory. */
+			if (fatal_signal_pending(current)) {
+				nr_reclaimed += SWAP_CLUSTER_MAX;
+				goto out;
+			}
+		}
+
+		spin_lock_irq(&zone->lru_lock);
+		while (lru_gen_try_inc_min_seq(zone, file))
+			;
+
+		/* never evict from the two youngest, active, generations */
+		max_seq = lrugen->max_seq;
+		if (max_seq - lrugen->min_seq[file] < MIN_NR_GENS) {
+			spin_unlock_irq(&zone->lru_lock);
+			if (aged++ == MAX_NR_GENS)
+				break;
+			lru_gen_age(zone, max_seq, sc);
+			continue;
+		}
+
+		gen = lru_gen_from_seq(lrugen->min_seq[file]);
+		head = &lrugen->lists[gen][file];
+		for (nr_scan = 0; nr_scan < SWAP_CLUSTER_MAX; nr_scan++) {
+			struct page *page;
+
+			if (list_empty(head))
+				break;
+			page = lru_to_page(head);
+			VM_BUG_ON(!PageLRU(page));
+
+			switch (__isolate_lru_page(page, ISOLATE_BOTH, file)) {
+			case 0:
+				lru_gen_del_page(zone, page, false);
+				list_add(&page->lru, &page_list);
+				nr_taken++;
+				break;
+
+			case -EBUSY:
+				/* else it is being freed elsewhere */
+				list_move(&page->lru, head);
+				continue;
+
+			default:
+				BUG();
+			}
+
+			if (sc->lumpy_reclaim_mode && sc->order)
+				nr_taken += lru_gen_isolate_block(zone, page,
+						sc->order, file, &page_list);
+		}
+
+		__mod_zone_page_state(zone, NR_ISOLATED_ANON + file, nr_taken);
+		reclaim_stat->recent_scanned[file] += nr_taken;
+		zone->pages_scanned += nr_scan;
+		if (current_is_kswapd())
+			__count_zone_vm_events(PGSCAN_KSWAPD, zone, nr_scan);
+		else
+			__count_zone_vm_events(PGSCAN_DIRECT, zone, nr_scan);
+		spin_unlock_irq(&zone->lru_lock);
+
+		nr_scanned += nr_scan;
+		if (!nr_taken)
+			continue;
+		sc->nr_isolated += nr_taken;
+
+		nr_freed = shrink_page_list(&page_list, sc, PAGEOUT_IO_ASYNC);
+
+		/* As in shrink_inactive_list(), wait for lumpy reclaim IO */
+		if (nr_freed < nr_taken && !current_is_kswapd() &&
+		    sc->lumpy_reclaim_mode) {
+			unsigned int count[NR_LRU_LISTS] = { 0, };
+			unsigned long nr_active;
+
+			congestion_wait(BLK_RW_ASYNC, HZ/10);
+
+			nr_active = clear_active_flags(&page_list, count);
+			count_vm_events(PGDEACTIVATE, nr_active);
+
+			nr_freed += shrink_page_list(&page_list, sc,
+						     PAGEOUT_IO_SYNC);
+		}
+		nr_reclaimed += nr_freed;
+
+		local_irq_disable();
+		if (current_is_kswapd())
+			__count_vm_events(KSWAPD_STEAL, nr_freed);
+		__count_zone_vm_events(PGSTEAL, zone, nr_freed);
+
+		spin_lock(&zone->lru_lock);
+		putback_inactive_pages(zone, reclaim_stat, &page_list, &pvec);
+		__mod_zone_page_state(zone, NR_ISOLATED_ANON + file, -nr_taken);
+		spin_unlock_irq(&zone->lru_lock);
+
+		if (nr_reclaimed >= sc->nr_to_reclaim &&
+		    priority < DEF_PRIORITY)
+			break;
+	}
+out:
+	pagevec_release(&pvec);
+	sc->nr_reclaimed = nr_reclaimed;
+
+	throttle_vm_writeout(sc->gfp_mask);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int lru_gen_show(struct seq_file *m, void *v)
+{
+	struct zone *zone;
+
+	for_each_populated_zone(zone) {
+		struct lru_gen_struct *lrugen = &zone->lrugen;
+		unsigned long seq;
+
+		seq_printf(m, "node %d zone %s\n", zone_to_nid(zone),
+			   zone->name);
+		seq_printf(m, "%10s %10s %12s %12s\n",
+			   "seq", "age_ms", "anon", "file");
+
+		spin_lock_irq(&zone->lru_lock);
+		seq = min(lrugen->min_seq[0], lrugen->min_seq[1]);
+		for (; seq <= lrugen->max_seq; seq++) {
+			int gen = lru_gen_from_seq(seq);
+			long anon = 0, file = 0;
+
+			if (seq >= lrugen->min_seq[0])
+				anon = lrugen->nr_pages[gen][0];
+			if (seq >= lrugen->min_seq[1])
+				file = lrugen->nr_pages[gen][1];
+
+			seq_printf(m, "%10lu %10u %12ld %12ld%s\n", seq,
+				   jiffies_to_msecs(jiffies -
+						    lrugen->timestamps[gen]),
+				   anon, file,
+				   lru_gen_is_active(zone, gen) ?
+				   " active" : "");
+		}
+		spin_unlock_irq(&zone->lru_lock);
+	}
+
+	return 0;
+}
+
+static int lru_gen_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, lru_gen_show, NULL);
+}
+
+static const struct file_operations lru_gen_fops = {
+	.open		= lru_gen_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init lru_gen_debugfs_init(void)
+{
+	if (lru_gen_enabled())
+		debugfs_create_file("lru_gen", 0444, NULL, NULL,
+				    &lru_gen_fops);
+	return 0;
+}
+late_initcall(lru_gen_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
+#else
+static inline void lru_gen_shrink_zone(struct zone *zone,
+				       struct scan_control *sc, int priority)
+{
+}
+#endif /* CONFIG_LRU_GEN */
+
 /*
  * This is a basic per-zone page freer.  Used by both kswapd and direct reclaim.
  */
@@ -1669,11 +2363,18 @@ static void shrink_zone(int priority, struct zone *zone,
 	enum lru_list l;
 	unsigned long nr_reclaimed = sc->nr_reclaimed;
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
-
-	get_scan_count(zone, sc, nr, priority);
+	unsigned long start_isolated = sc->nr_isolated;
+	unsigned long start_reclaimed = sc->nr_reclaimed;
 
 	set_lumpy_reclaim_mode(priority, sc);
 
+	if (lru_gen_enabled() && scanning_global_lru(sc)) {
+		lru_gen_shrink_zone(zone, sc, priority);
+		goto out;
+	}
+
+	get_scan_count(zone, sc, nr, priority);
+
 	while (nr[LRU_INACTIVE_ANON] || nr[LRU_ACTIVE_FILE] ||
 					nr[LRU_INACTIVE_FILE]) {
 		for_each_evictable_lru(l) {
@@ -1708,6 +2409,10 @@ static void shrink_zone(int priority, struct zone *zone,
 		shrink_active_list(SWAP_CLUSTER_MAX, zone, sc, priority, 0);
 
 	throttle_vm_writeout(sc->gfp_mask);
+out:
+	mem_cgroup_vmpressure(sc->mem_cgroup, sc->gfp_mask,
+			      sc->nr_isolated - start_isolated,
+			      sc->nr_reclaimed - start_reclaimed);
 }
 
 /*
@@ -2100,7 +2805,8 @@ loop_again:
 			 * Do some background aging of the anon list, to give
 			 * pages a chance to be referenced before reclaiming.
 			 */
-			if (inactive_anon_is_low(zone, &sc))
+			if (!lru_gen_enabled() &&
+			    inactive_anon_is_low(zone, &sc))
 				shrink_active_list(SWAP_CLUSTER_MAX, zone,
 							&sc, priority, 0);
 
@@ -2324,11 +3030,14 @@ static int kswapd(void *p)
 				/*
 				 * After a short sleep, check if it was a
 				 * premature sleep. If not, then go fully
-				 * to sleep until explicitly woken up
+				 * to sleep until explicitly woken up, leaving
+				 * fragmentation of what we reclaimed to
+				 * kcompactd
 				 */
-				if (!sleeping_prematurely(pgdat, order, remaining))
+				if (!sleeping_prematurely(pgdat, order, remaining)) {
+					wakeup_kcompactd(pgdat, order);
 					schedule();
-				else {
+				} else {
 					if (remaining)
 						count_vm_event(KSWAPD_LOW_WMARK_HIT_QUICKLY);
 					else
@@ -2772,10 +3481,8 @@ retry:
 	if (page_evictable(page, NULL)) {
 		enum lru_list l = page_lru_base_type(page);
 
-		__dec_zone_state(zone, NR_UNEVICTABLE);
-		list_move(&page->lru, &zone->lru[l].list);
-		mem_cgroup_move_lists(page, LRU_UNEVICTABLE, l);
-		__inc_zone_state(zone, NR_INACTIVE_ANON + l);
+		del_page_from_lru_list(zone, page, LRU_UNEVICTABLE);
+		add_page_to_lru_list(zone, page, l);
 		__count_vm_event(UNEVICTABLE_PGRESCUED);
 	} else {
 		/*
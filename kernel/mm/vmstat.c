@@ -481,6 +481,9 @@ static char * const migratetype_names[MIGRATE_TYPES] = {
 	"Reclaimable",
 	"Movable",
 	"Reserve",
+#ifdef CONFIG_CMA_MIGRATE
+	"CMA",
+#endif
 	"Isolate",
 };
 
@@ -745,6 +748,10 @@ static const char * const vmstat_text[] = {
 	"nr_isolated_anon",
 	"nr_isolated_file",
 	"nr_shmem",
+	"workingset_refault",
+	"workingset_activate",
+	"workingset_shadows",
+	"nr_free_cma",
 #ifdef CONFIG_NUMA
 	"numa_hit",
 	"numa_miss",
@@ -759,6 +766,10 @@ static const char * const vmstat_text[] = {
 	"pgpgout",
 	"pswpin",
 	"pswpout",
+	"swap_ra",
+	"swap_ra_hit",
+	"swap_vma_ra",
+	"swap_vma_ra_hit",
 
 	TEXTS_FOR_ZONES("pgalloc")
 
@@ -768,6 +779,13 @@ static const char * const vmstat_text[] = {
 
 	"pgfault",
 	"pgmajfault",
+	"fault_around",
+	"fault_around_mapped",
+	"vmacache_find_calls",
+	"vmacache_find_hits",
+	"readahead_pages",
+	"readahead_used",
+	"readahead_wasted",
 
 	TEXTS_FOR_ZONES("pgrefill")
 	TEXTS_FOR_ZONES("pgsteal")
@@ -788,6 +806,10 @@ static const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+	"vmap_purge",
+	"vmap_purge_pages",
+	"vmap_flush_range",
+	"vmap_flush_all",
 
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
@@ -796,6 +818,18 @@ static const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_deferred",
+	"compact_skip_fragindex",
+	"compact_skip_watermark",
+	"compact_skip_writeback",
+	"compact_skip_locked",
+	"compact_skip_isolated",
+	"compact_daemon_wake",
+#endif
+
+#ifdef CONFIG_LRU_GEN
+	"lru_gen_aging",
+	"lru_gen_young",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -848,6 +882,7 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 		   "\n  pagesets");
 	for_each_online_cpu(i) {
 		struct per_cpu_pageset *pageset;
+		int j;
 
 		pageset = per_cpu_ptr(zone->pageset, i);
 		seq_printf(m,
@@ -859,6 +894,12 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
 			   pageset->pcp.batch);
+		for (j = 1; j <= PCP_MAX_ORDER; j++)
+			seq_printf(m, "\n      order %i count: %i high: %i batch: %i",
+				   j,
+				   pageset->pcp.orders[j - 1].count,
+				   pageset->pcp.orders[j - 1].high,
+				   pageset->pcp.orders[j - 1].batch);
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
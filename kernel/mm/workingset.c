@@ -0,0 +1,297 @@
+/*
+ * linux/mm/workingset.c
+ *
+ * Workingset detection
+ *
+ * Page cache pages start out on the inactive file list and are only
+ * promoted to the active list when they are referenced a second time
+ * while still on it.  A workingset that is larger than the inactive
+ * list but would fit into memory just fine can thus thrash forever:
+ * every page is evicted before its second access comes in.
+ *
+ * To catch this, every zone counts the pages that leave its inactive
+ * list, by eviction or by activation, in zone->inactive_age.  When a
+ * page cache page is evicted, a snapshot of that counter is left in its
+ * slot of the page cache radix tree as an exceptional "shadow" entry.
+ * When the page is faulted back in, the difference between the current
+ * counter and the snapshot is the refault distance: the minimum number
+ * of extra inactive list slots the page would have needed to stay
+ * resident.
+ *
+ * The inactive list could only grow at the expense of the active list,
+ * so if the refault distance is no larger than the active file list the
+ * page is competing with the active pages on equal terms and is
+ * activated right away.  Pages that were refaulted from further away
+ * start out inactive as usual.
+ *
+ * Shadow entries take up radix tree slots, and keep alive radix tree
+ * nodes that would otherwise have been freed.  A shadow whose refault
+ * distance has grown beyond the size of the file LRU of its zone can no
+ * longer activate anything: a shrinker prunes those from the mappings
+ * that hold shadows, so that their number stays around the size of the
+ * file LRU and the nodes left empty are freed.  Shadows also go away
+ * when the page is read back in, or when the mapping is truncated or
+ * its inode reclaimed.
+ */
+
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/fs.h>
+#include <linux/mm_inline.h>
+#include <linux/radix-tree.h>
+#include <linux/pagevec.h>
+#include <linux/init.h>
+
+/*
+ * Mappings that hold shadow entries, for the shrinker.  Nests inside
+ * the tree_lock of the mappings; the shrinker only trylocks those.
+ */
+static LIST_HEAD(shadow_mappings);
+static DEFINE_SPINLOCK(shadow_lock);
+
+#define EVICTION_SHIFT	(RADIX_TREE_EXCEPTIONAL_SHIFT + \
+			 ZONES_SHIFT + NODES_SHIFT)
+#define EVICTION_MASK	(~0UL >> EVICTION_SHIFT)
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zone,
+			  unsigned long *evictionp)
+{
+	unsigned long entry = (unsigned long)shadow;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+	*evictionp = entry;
+}
+
+static unsigned long file_lru_pages(struct zone *zone)
+{
+	return zone_page_state(zone, NR_ACTIVE_FILE) +
+	       zone_page_state(zone, NR_INACTIVE_FILE);
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @page: the page being evicted
+ *
+ * Returns a shadow entry to be stored in @page->mapping->page_tree in
+ * place of the evicted page.  The caller holds the mapping's tree_lock,
+ * and must store the returned entry and call workingset_store().
+ */
+void *workingset_eviction(struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	__inc_zone_state(zone, WORKINGSET_SHADOWS);
+
+	return pack_shadow(eviction, zone);
+}
+
+/**
+ * workingset_store - account for a shadow entry stored in a mapping
+ * @mapping: the mapping
+ *
+ * Called with the mapping's tree_lock held.
+ */
+void workingset_store(struct address_space *mapping)
+{
+	if (mapping->nrshadows++)
+		return;
+
+	spin_lock(&shadow_lock);
+	list_add_tail(&mapping->shadow_list, &shadow_mappings);
+	spin_unlock(&shadow_lock);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: the shadow entry of the evicted page
+ *
+ * Calculates the refault distance of the page from the eviction
+ * counter stored in @shadow and returns %true if the page should be
+ * activated right away.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	unsigned long eviction;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &eviction);
+
+	refault_distance = (atomic_long_read(&zone->inactive_age) - eviction) &
+			   EVICTION_MASK;
+
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: the page that was promoted to the active list
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+static void forget_shadow(void *shadow)
+{
+	struct zone *zone;
+	unsigned long eviction;
+
+	unpack_shadow(shadow, &zone, &eviction);
+	__dec_zone_state(zone, WORKINGSET_SHADOWS);
+}
+
+/**
+ * workingset_forget - account for a shadow entry being removed
+ * @mapping: the mapping the entry was removed from
+ * @shadow: the shadow entry
+ *
+ * Called with the mapping's tree_lock held whenever a shadow entry
+ * is dropped from the page cache or replaced by a page.
+ */
+void workingset_forget(struct address_space *mapping, void *shadow)
+{
+	forget_shadow(shadow);
+
+	if (--mapping->nrshadows)
+		return;
+
+	spin_lock(&shadow_lock);
+	list_del(&mapping->shadow_list);
+	spin_unlock(&shadow_lock);
+}
+
+/*
+ * A shadow whose refault distance is larger than the file LRU of its
+ * zone could not have kept the page resident and never activates it.
+ */
+static bool shadow_expired(void *shadow)
+{
+	unsigned long eviction;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &eviction);
+
+	return ((atomic_long_read(&zone->inactive_age) - eviction) &
+		EVICTION_MASK) > file_lru_pages(zone);
+}
+
+/*
+ * Drop the expired shadows among the next @nr_to_scan slots of @mapping,
+ * going on from where the last call stopped.  Called with shadow_lock
+ * and the mapping's tree_lock held.  Returns the number of slots looked
+ * at.
+ */
+static int prune_mapping(struct address_space *mapping, int nr_to_scan)
+{
+	unsigned long indices[PAGEVEC_SIZE];
+	void **slots[PAGEVEC_SIZE];
+	unsigned int nr, i;
+	int scanned = 0;
+
+	while (scanned < nr_to_scan) {
+		nr = radix_tree_gang_lookup_slot(&mapping->page_tree, slots,
+				indices, mapping->shadow_index, PAGEVEC_SIZE);
+		if (!nr) {
+			mapping->shadow_index = 0;
+			break;
+		}
+		for (i = 0; i < nr; i++) {
+			void *entry = radix_tree_deref_slot(slots[i]);
+
+			if (!radix_tree_exceptional_entry(entry) ||
+			    !shadow_expired(entry))
+				continue;
+			radix_tree_delete(&mapping->page_tree, indices[i]);
+			forget_shadow(entry);
+			if (!--mapping->nrshadows) {
+				list_del(&mapping->shadow_list);
+				return scanned + i + 1;
+			}
+		}
+		scanned += nr;
+		mapping->shadow_index = indices[nr - 1] + 1;
+		if (!mapping->shadow_index)
+			break;	/* wraparound */
+	}
+	return scanned;
+}
+
+static void prune_shadows(int nr_to_scan)
+{
+	struct address_space *mapping;
+
+	spin_lock_irq(&shadow_lock);
+	while (nr_to_scan > 0 && !list_empty(&shadow_mappings)) {
+		mapping = list_first_entry(&shadow_mappings,
+					   struct address_space, shadow_list);
+		list_move_tail(&mapping->shadow_list, &shadow_mappings);
+
+		/* Busy mappings are skipped, but still cost a slot */
+		if (!spin_trylock(&mapping->tree_lock)) {
+			nr_to_scan--;
+			continue;
+		}
+		nr_to_scan -= max(prune_mapping(mapping, nr_to_scan), 1);
+		spin_unlock(&mapping->tree_lock);
+	}
+	spin_unlock_irq(&shadow_lock);
+}
+
+/*
+ * Reports the shadows in excess of the size of the file LRUs, which are
+ * all expired, and prunes expired shadows from the mappings in turn.
+ */
+static int shrink_shadows(struct shrinker *shrink, int nr, gfp_t gfp_mask)
+{
+	unsigned long excess = 0;
+	struct zone *zone;
+
+	if (nr)
+		prune_shadows(nr);
+
+	for_each_populated_zone(zone) {
+		unsigned long shadows = zone_page_state(zone,
+							WORKINGSET_SHADOWS);
+
+		if (shadows > file_lru_pages(zone))
+			excess += shadows - file_lru_pages(zone);
+	}
+	return min_t(unsigned long, excess, INT_MAX);
+}
+
+static struct shrinker shadow_shrinker = {
+	.shrink = shrink_shadows,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int __init workingset_init(void)
+{
+	register_shrinker(&shadow_shrinker);
+	return 0;
+}
+module_init(workingset_init);
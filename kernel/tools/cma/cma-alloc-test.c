@@ -0,0 +1,313 @@
+/*
+ * cma-alloc-test.c -- runs the CMA allocators in user space
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* gcc -Wall -Wextra -g -fsanitize=address -idirafter ../../include \
+ *	-o cma-alloc-test cma-alloc-test.c */
+
+/*
+ * Run with:
+ *
+ *	cma-alloc-test [<rounds> [<seed>]]
+ *
+ * This builds mm/cma-best-fit.c, mm/cma-size-class.c and lib/rbtree.c
+ * as they are, with the few kernel interfaces they use mapped onto libc,
+ * so that they can be run under AddressSanitizer (and its leak checker)
+ * or valgrind.  For each allocator it allocates and frees chunks of a
+ * few recurring and of random sizes and alignments in a region for
+ * <rounds> rounds (100000 by default), and after every step checks that:
+ *
+ *  - a chunk lies within the region, is aligned as asked for, and does
+ *    not overlap any other chunk or any hole;
+ *  - the holes are in order by start and by size in their trees, and
+ *    no two of them are adjacent, i.e. freed chunks were merged;
+ *  - the holes and chunks add up to the region;
+ *  - an allocation only fails if no hole can hold it.
+ *
+ * At the end it frees everything, which must leave one hole again.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/************************* Kernel Shims *************************/
+
+/* Headers whose contents are replaced by what follows */
+#define _LINUX_SLAB_H
+#define _LINUX_MODULE_H
+#define __LINUX_CMA_H
+
+typedef unsigned int dma_addr_t;	/* as on ARM */
+
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+#define __must_check		__attribute__((warn_unused_result))
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+#define ALIGN(x, a)		(((x) + (a) - 1) & ~((typeof(x))(a) - 1))
+
+#define GFP_KERNEL		0
+#define kmalloc(size, gfp)	malloc(size)
+#define kzalloc(size, gfp)	calloc(1, size)
+#define kfree(ptr)		free(ptr)
+
+#define pr_debug(fmt, ...)	do { } while (0)
+
+static unsigned long warnings;
+
+#define WARN_ON(cond) ({						\
+	int __ret = !!(cond);						\
+	if (__ret) {							\
+		fprintf(stderr, "cma-alloc-test: WARN_ON(%s) at %s:%d\n",\
+			#cond, __FILE__, __LINE__);			\
+		warnings++;						\
+	}								\
+	__ret;								\
+})
+
+#define EXPORT_SYMBOL(sym)
+#define module_init(fn)							\
+	static void __attribute__((constructor)) fn##_ctor(void) { fn(); }
+
+#include <linux/rbtree.h>
+
+/* The parts of <linux/cma.h> the allocators use */
+struct cma_region {
+	const char *name;
+	dma_addr_t start;
+	size_t size;
+	void *private_data;
+};
+
+struct cma_chunk {
+	dma_addr_t start;
+	size_t size;
+
+	struct cma_region *reg;
+	struct rb_node by_start;
+};
+
+struct cma_allocator {
+	const char *name;
+
+	int (*init)(struct cma_region *reg);
+	void (*cleanup)(struct cma_region *reg);
+	struct cma_chunk *(*alloc)(struct cma_region *reg, size_t size,
+				   dma_addr_t alignment);
+	void (*free)(struct cma_chunk *chunk);
+};
+
+#define MAX_ALLOCATORS	4
+
+static struct cma_allocator *allocators[MAX_ALLOCATORS];
+static unsigned nr_allocators;
+
+static int cma_allocator_register(struct cma_allocator *alloc)
+{
+	if (nr_allocators == MAX_ALLOCATORS)
+		return -ENOMEM;
+	allocators[nr_allocators++] = alloc;
+	return 0;
+}
+
+#include "../../lib/rbtree.c"
+#include "../../mm/cma-best-fit.c"
+#undef pr_fmt
+#include "../../mm/cma-size-class.c"
+
+
+/************************* Test *************************/
+
+#define REGION_START	0x40000000
+#define REGION_SIZE	(64 << 20)
+#define PAGE		4096
+#define MAX_CHUNKS	128
+
+/* Sizes devices allocate over and over again, in pages */
+static const size_t recurring[] = { 1, 16, 300, 768, 1200 };
+
+static struct cma_chunk *chunks[MAX_CHUNKS];
+static unsigned long step;
+
+
+static void fail(const char *allocator, const char *what)
+{
+	fprintf(stderr, "cma-alloc-test: %s: round %lu: %s\n", allocator,
+		step, what);
+	exit(1);
+}
+
+static int overlap(dma_addr_t a, size_t a_size, dma_addr_t b, size_t b_size)
+{
+	return a < b + b_size && b < a + a_size;
+}
+
+static int fits(const struct cma_chunk *hole, size_t size,
+		dma_addr_t alignment)
+{
+	dma_addr_t start = ALIGN(hole->start, alignment);
+
+	return start >= hole->start &&
+		start - hole->start + size <= hole->size;
+}
+
+/*
+ * Checks the holes in both trees against each other and the chunks.
+ * If size is not 0, a chunk of that size and alignment just could not
+ * be allocated.
+ */
+static void check(struct cma_region *reg, const char *allocator,
+		  size_t size, dma_addr_t alignment)
+{
+	struct cma_bf_private *prv = reg->private_data;
+	const struct cma_chunk *prev = NULL;
+	size_t total = 0, prev_size = 0;
+	unsigned long holes = 0;
+	struct rb_node *node;
+	int i;
+
+	for (node = rb_first(&prv->by_start_root); node; node = rb_next(node)) {
+		const struct cma_chunk *hole =
+			rb_entry(node, struct cma_chunk, by_start);
+
+		if (!hole->size || hole->start < reg->start ||
+		    hole->start - reg->start + hole->size > reg->size)
+			fail(allocator, "hole outside the region");
+		if (prev && prev->start + prev->size >= hole->start)
+			fail(allocator, "holes not in order or not merged");
+		for (i = 0; i < MAX_CHUNKS; i++)
+			if (chunks[i] &&
+			    overlap(chunks[i]->start, chunks[i]->size,
+				    hole->start, hole->size))
+				fail(allocator, "chunk overlaps a hole");
+		if (size && fits(hole, size, alignment))
+			fail(allocator, "allocation failed but a hole fits");
+		total += hole->size;
+		holes++;
+		prev = hole;
+	}
+
+	for (node = rb_first(&prv->by_size_root); node; node = rb_next(node)) {
+		const struct cma_bf_item *item =
+			rb_entry(node, struct cma_bf_item, by_size);
+
+		if (item->ch.size < prev_size)
+			fail(allocator, "holes not in order by size");
+		prev_size = item->ch.size;
+		holes--;
+	}
+	if (holes)
+		fail(allocator, "trees hold different holes");
+
+	for (i = 0; i < MAX_CHUNKS; i++)
+		if (chunks[i])
+			total += chunks[i]->size;
+	if (total != reg->size)
+		fail(allocator, "holes and chunks do not add up to the region");
+	if (warnings)
+		fail(allocator, "warning");
+}
+
+static void alloc_chunk(struct cma_allocator *alloc, struct cma_region *reg,
+			int slot)
+{
+	struct cma_chunk *chunk;
+	dma_addr_t alignment;
+	size_t size;
+	int i;
+
+	if (rand() % 4)
+		size = recurring[rand() % (sizeof recurring /
+					   sizeof *recurring)] * PAGE;
+	else
+		size = (1 + rand() % 2048) * PAGE;
+	alignment = PAGE << (rand() % 4 ? 0 : rand() % 9);
+
+	chunk = alloc->alloc(reg, size, alignment);
+	if (!chunk) {
+		check(reg, alloc->name, size, alignment);
+		return;
+	}
+	chunk->reg = reg;
+
+	if (chunk->size != size || chunk->start % alignment ||
+	    chunk->start < reg->start ||
+	    chunk->start - reg->start + size > reg->size)
+		fail(alloc->name, "chunk of a wrong size or place");
+	for (i = 0; i < MAX_CHUNKS; i++)
+		if (chunks[i] && overlap(chunks[i]->start, chunks[i]->size,
+					 chunk->start, chunk->size))
+			fail(alloc->name, "chunks overlap");
+	chunks[slot] = chunk;
+}
+
+static void test(struct cma_allocator *alloc, unsigned long rounds)
+{
+	struct cma_region reg = {
+		.name	= "test",
+		.start	= REGION_START,
+		.size	= REGION_SIZE,
+	};
+	unsigned long allocated = 0;
+	int i;
+
+	if (alloc->init(&reg))
+		fail(alloc->name, "init failed");
+
+	for (step = 0; step < rounds; step++) {
+		i = rand() % MAX_CHUNKS;
+		if (chunks[i]) {
+			alloc->free(chunks[i]);
+			chunks[i] = NULL;
+		} else {
+			alloc_chunk(alloc, &reg, i);
+			allocated += !!chunks[i];
+		}
+		check(&reg, alloc->name, 0, 0);
+	}
+
+	for (i = 0; i < MAX_CHUNKS; i++)
+		if (chunks[i]) {
+			alloc->free(chunks[i]);
+			chunks[i] = NULL;
+		}
+	check(&reg, alloc->name, 0, 0);
+	alloc->cleanup(&reg);
+	if (warnings)
+		fail(alloc->name, "not one hole after freeing everything");
+
+	printf("%s: %lu rounds, %lu chunks allocated\n", alloc->name,
+	       rounds, allocated);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long rounds = 100000;
+	unsigned i;
+
+	if (argc > 3) {
+		fprintf(stderr, "usage: %s [<rounds> [<seed>]]\n", argv[0]);
+		return 2;
+	}
+	if (argc > 1)
+		rounds = strtoul(argv[1], NULL, 0);
+	srand(argc > 2 ? strtoul(argv[2], NULL, 0) : 1);
+
+	for (i = 0; i < nr_allocators; i++)
+		test(allocators[i], rounds);
+	return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * cma-replay.c -- replays recorded CMA allocations against allocators
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* $(CROSS_COMPILE)gcc -Wall -Wextra -g -o cma-replay cma-replay.c  */
+
+/*
+ * Record with:
+ *
+ *	echo 1 > /sys/kernel/debug/tracing/events/cma/enable
+ *	... run the workload ...
+ *	cat /sys/kernel/debug/tracing/trace > cma.trace
+ *
+ * and replay the allocations of one region against some allocators
+ * (the best-fit and size class ones by default) with:
+ *
+ *	cma-replay <region> [<allocator>...] < cma.trace
+ *
+ * The replay itself runs in the kernel (CONFIG_CMA_REPLAY); this turns
+ * the trace into commands for it and prints the results.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define REPLAY_FILE	"/sys/kernel/debug/cma_replay"
+#define MAX_IDS		1024	/* CMA_REPLAY_MAX_IDS in mm/cma.c */
+
+/* Start address of the live chunk with each id, 0 if the id is free. */
+static unsigned long long live[MAX_IDS];
+
+static int fd;
+static unsigned no;
+
+
+static void command(const char *fmt, ...)
+	__attribute__((format(printf, 1, 2)));
+
+static void command(const char *fmt, ...)
+{
+	char buf[128];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof buf, fmt, ap);
+	va_end(ap);
+
+	if (write(fd, buf, len) != len) {
+		fprintf(stderr, "cma-replay: %d: %s: %s", no, REPLAY_FILE,
+			strerror(errno));
+		fprintf(stderr, " (command was %s", buf);
+		exit(1);
+	}
+}
+
+static int find(unsigned long long start)
+{
+	int id;
+
+	for (id = 0; id < MAX_IDS; ++id)
+		if (live[id] == start)
+			return id;
+	return -1;
+}
+
+static void event(char *line, const char *region)
+{
+	unsigned long long start, alignment;
+	unsigned long size;
+	char name[32], *p;
+	int id;
+
+	p = strstr(line, " cma_");
+	if (!p)
+		return;
+	p += 5;
+
+	if (sscanf(strchr(p, ' ') ?: "", " region=%31s start=%llx size=%lu "
+		   "align=%llx", name, &start, &size, &alignment) != 4 ||
+	    strcmp(name, region))
+		return;
+
+	if (!strncmp(p, "alloc_failed:", 13)) {
+		/* Try it, but do not hold on to it if it fits this time */
+		id = find(0);
+		if (id < 0)
+			goto full;
+		command("a %d %lu %llx\nf %d\n", id, size, alignment, id);
+	} else if (!strncmp(p, "alloc:", 6)) {
+		id = find(0);
+		if (id < 0)
+			goto full;
+		live[id] = start;
+		command("a %d %lu %llx\n", id, size, alignment);
+	} else if (!strncmp(p, "free:", 5)) {
+		/* Chunks allocated before tracing started are not known */
+		id = find(start);
+		if (id < 0)
+			return;
+		live[id] = 0;
+		command("f %d\n", id);
+	}
+	return;
+
+full:
+	fprintf(stderr, "cma-replay: %d: more than %d live chunks\n",
+		no, MAX_IDS);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	static const char *defaults[] = { "bf", "sc", NULL };
+	const char **allocs = defaults;
+	char line[1024];
+	ssize_t n;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <region> [<allocator>...] "
+			"< trace\n", argv[0]);
+		return 2;
+	}
+	if (argc > 2)
+		allocs = (const char **)argv + 2;
+
+	fd = open(REPLAY_FILE, O_RDWR);
+	if (fd < 0) {
+		perror(REPLAY_FILE);
+		return 1;
+	}
+
+	command("region %s\n", argv[1]);
+	while (fgets(line, sizeof line, stdin)) {
+		++no;
+		event(line, argv[1]);
+	}
+
+	for (; *allocs; ++allocs)
+		command("run %s\n", *allocs);
+
+	lseek(fd, 0, SEEK_SET);
+	while ((n = read(fd, line, sizeof line)) > 0)
+		fwrite(line, 1, n, stdout);
+
+	close(fd);
+	return 0;
+}
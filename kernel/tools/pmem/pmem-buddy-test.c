@@ -0,0 +1,286 @@
+/*
+ * pmem-buddy-test.c -- exercise the buddy allocator of a pmem region
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* $(CROSS_COMPILE)gcc -Wall -Wextra -O2 -o pmem-buddy-test pmem-buddy-test.c */
+
+/*
+ * Run with:
+ *
+ *	pmem-buddy-test [-d <debugfs file>] [-n <rounds>] [-s <seed>]
+ *			<pmem device>
+ *
+ * on a region nothing else uses at the time, for example /dev/pmem
+ * before the media and graphics services start.  In each of <rounds>
+ * rounds (10000 by default) it either frees a random block it holds, by
+ * closing its file, or allocates one of a random size, by mapping a new
+ * file, so that blocks get split and buddies merged in every order.  It
+ * stops with an error if:
+ *
+ *  - a block is smaller than asked for, not a power of two pages, not
+ *    aligned to its size within the region, or overlaps another block;
+ *  - the tags it writes at both ends of a block changed before the block
+ *    is freed;
+ *  - the free size in the debugfs file (/sys/kernel/debug/<device name>
+ *    by default) is not the size at the start less what it holds;
+ *  - an allocation fails that is not larger than the largest free block
+ *    the debugfs file shows;
+ *  - once it has freed everything, the free blocks per order are not the
+ *    same as at the start, i.e. some buddies were not merged back.
+ *
+ * See drivers/misc/pmem.c.
+ */
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* From <linux/android_pmem.h>, which is not usable from user space */
+#define PMEM_IOCTL_MAGIC	'p'
+#define PMEM_GET_PHYS		_IOW(PMEM_IOCTL_MAGIC, 1, unsigned int)
+#define PMEM_ALLOCATE		_IOW(PMEM_IOCTL_MAGIC, 5, unsigned int)
+#define PMEM_GET_TOTAL_SIZE	_IOW(PMEM_IOCTL_MAGIC, 7, unsigned int)
+
+struct pmem_region {
+	unsigned long offset;
+	unsigned long len;
+};
+
+#define MAX_BLOCKS	256
+
+struct block {
+	int fd;
+	unsigned long *map;
+	size_t map_len;			/* what was asked for and mapped */
+	unsigned long start;		/* offset in the region */
+	unsigned long len;
+	unsigned long tag;
+};
+
+struct free_stat {
+	char orders[512];		/* "order:count ..." */
+	unsigned long free;		/* kB */
+	unsigned long largest;		/* kB */
+};
+
+static struct block blocks[MAX_BLOCKS];
+static const char *device, *debugfs;
+static unsigned long region_start, region_size;
+static long page_size;
+
+
+static void die(const char *what)
+{
+	fprintf(stderr, "pmem-buddy-test: %s: %s\n", what, strerror(errno));
+	exit(1);
+}
+
+static void fail(unsigned long round, const char *what)
+{
+	fprintf(stderr, "pmem-buddy-test: round %lu: %s\n", round, what);
+	exit(1);
+}
+
+static void read_stat(struct free_stat *s)
+{
+	char line[1024];
+	FILE *f;
+
+	memset(s, 0, sizeof *s);
+	f = fopen(debugfs, "r");
+	if (!f)
+		die(debugfs);
+	if (!fgets(line, sizeof line, f) ||
+	    sscanf(line, "free blocks (order:count):%511[^\n]",
+		   s->orders) != 1 ||
+	    !fgets(line, sizeof line, f) ||
+	    sscanf(line, "free %lukB largest %lukB", &s->free,
+		   &s->largest) != 2) {
+		fprintf(stderr, "pmem-buddy-test: %s: no allocator "
+			"statistics\n", debugfs);
+		exit(1);
+	}
+	fclose(f);
+}
+
+static unsigned long random_len(void)
+{
+	unsigned long pages = region_size / page_size, max;
+
+	/* Mostly small blocks, sometimes up to a quarter of the region */
+	max = rand() % 4 ? pages / 64 : pages / 4;
+	if (!max)
+		max = 1;
+	return (1 + rand() % max) * page_size;
+}
+
+static int alloc_block(struct block *b, unsigned long round)
+{
+	struct pmem_region region;
+	unsigned long len = random_len();
+	int i;
+
+	b->fd = open(device, O_RDWR);
+	if (b->fd < 0)
+		die(device);
+	b->map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, b->fd, 0);
+	if (b->map == MAP_FAILED) {
+		struct free_stat s;
+
+		if (errno != EINVAL)
+			die("mmap");
+		read_stat(&s);
+		if (len <= s.largest << 10)
+			fail(round, "allocation failed with a large enough "
+			     "block free");
+		close(b->fd);
+		b->fd = -1;
+		return 0;
+	}
+	if (ioctl(b->fd, PMEM_GET_PHYS, &region))
+		die("PMEM_GET_PHYS");
+	b->start = region.offset - region_start;
+	b->len = region.len;
+
+	if (b->len < len || b->len % page_size ||
+	    (b->len & (b->len - 1)))
+		fail(round, "block of a wrong size");
+	if (b->start % b->len || b->start + b->len > region_size)
+		fail(round, "block not aligned to its size");
+	for (i = 0; i < MAX_BLOCKS; i++)
+		if (blocks + i != b && blocks[i].fd >= 0 &&
+		    b->start < blocks[i].start + blocks[i].len &&
+		    blocks[i].start < b->start + b->len)
+			fail(round, "blocks overlap");
+
+	/* Tag both ends, only the mapped part is accessible */
+	b->map_len = len;
+	b->tag = round << 8 | (b - blocks);
+	b->map[0] = b->tag;
+	b->map[len / sizeof(long) - 1] = ~b->tag;
+	return 1;
+}
+
+static void free_block(struct block *b, unsigned long round)
+{
+	if (b->map[0] != b->tag ||
+	    b->map[b->map_len / sizeof(long) - 1] != ~b->tag)
+		fail(round, "block was overwritten");
+	munmap(b->map, b->map_len);
+	close(b->fd);
+	b->fd = -1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long rounds = 10000, round, held = 0, seed = 1, first;
+	struct pmem_region region;
+	struct free_stat start, s;
+	char path[256];
+	int c, i, fd;
+
+	while ((c = getopt(argc, argv, "d:n:s:")) != -1) {
+		switch (c) {
+		case 'd':
+			debugfs = optarg;
+			break;
+		case 'n':
+			rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1)
+		goto usage;
+	device = argv[optind];
+	if (!debugfs) {
+		const char *name = strrchr(device, '/');
+
+		snprintf(path, sizeof path, "/sys/kernel/debug/%s",
+			 name ? name + 1 : device);
+		debugfs = path;
+	}
+	page_size = sysconf(_SC_PAGESIZE);
+	srand(seed);
+
+	/*
+	 * An idle region is free as one block per bit set in its size, the
+	 * largest first, so allocating that block tells where it starts.
+	 */
+	fd = open(device, O_RDWR);
+	if (fd < 0)
+		die(device);
+	if (ioctl(fd, PMEM_GET_TOTAL_SIZE, &region))
+		die("PMEM_GET_TOTAL_SIZE");
+	region_size = region.len;
+	for (first = page_size; first <= region_size / 2; first <<= 1)
+		;
+	if (ioctl(fd, PMEM_ALLOCATE, first) ||
+	    ioctl(fd, PMEM_GET_PHYS, &region))
+		die("PMEM_ALLOCATE");
+	if (region.len != first) {
+		fprintf(stderr, "pmem-buddy-test: %s is in use\n", device);
+		return 1;
+	}
+	region_start = region.offset;
+	close(fd);
+	read_stat(&start);
+
+	for (i = 0; i < MAX_BLOCKS; i++)
+		blocks[i].fd = -1;
+	for (round = 0; round < rounds; round++) {
+		struct block *b = &blocks[rand() % MAX_BLOCKS];
+
+		if (b->fd >= 0) {
+			free_block(b, round);
+			held -= b->len;
+		} else {
+			if (!alloc_block(b, round))
+				continue;
+			held += b->len;
+		}
+
+		read_stat(&s);
+		if (s.free << 10 != (start.free << 10) - held)
+			fail(round, "free size does not match the blocks held");
+	}
+
+	for (i = 0; i < MAX_BLOCKS; i++)
+		if (blocks[i].fd >= 0)
+			free_block(&blocks[i], round);
+	read_stat(&s);
+	if (strcmp(s.orders, start.orders))
+		fail(round, "free blocks not merged back");
+
+	printf("%lu rounds, region of %lukB: free blocks%s\n", rounds,
+	       region_size >> 10, s.orders);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-d <debugfs file>] [-n <rounds>] "
+		"[-s <seed>] <pmem device>\n", argv[0]);
+	return 2;
+}
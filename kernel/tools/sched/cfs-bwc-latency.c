@@ -0,0 +1,217 @@
+/*
+ * cfs-bwc-latency.c -- wakeup latency of a periodic task under background load
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* $(CROSS_COMPILE)gcc -Wall -Wextra -O2 -o cfs-bwc-latency \
+ *	cfs-bwc-latency.c -lrt */
+
+/*
+ * Run with:
+ *
+ *	cfs-bwc-latency [-b <bg cgroup>] [-f <fg cgroup>] [-n <hogs>]
+ *			[-p <period us>] [-t <seconds>]
+ *
+ * Starts <hogs> busy looping processes (two by default) in the background
+ * cgroup, and in the foreground one a task that wakes up every <period
+ * us> (16666, a 60Hz frame, by default) like a UI thread does.  Prints
+ * how late the wakeups were and, for the background group, the
+ * throttling statistics from cpu.stat.  For example, with the cpu
+ * controller mounted on /dev/cpuctl:
+ *
+ *	mkdir /dev/cpuctl/bg
+ *	cfs-bwc-latency -b /dev/cpuctl/bg
+ *	echo 10000 > /dev/cpuctl/bg/cpu.cfs_quota_us
+ *	cfs-bwc-latency -b /dev/cpuctl/bg
+ *
+ * shows the latencies with shares only, then with the background group
+ * limited to 10% of a cpu (the default period is 100ms).
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define MAX_HOGS	64
+#define NR_BUCKETS	8	/* latency histogram: < 100us << 0 .. 7 */
+
+static pid_t hogs[MAX_HOGS];
+static int nr_hogs = 2;
+
+
+static void die(const char *what)
+{
+	fprintf(stderr, "cfs-bwc-latency: %s: %s\n", what, strerror(errno));
+	exit(1);
+}
+
+static void stop_hogs(void)
+{
+	int i;
+
+	for (i = 0; i < nr_hogs; ++i)
+		if (hogs[i] > 0) {
+			kill(hogs[i], SIGKILL);
+			waitpid(hogs[i], NULL, 0);
+		}
+}
+
+static void attach(const char *cgroup, pid_t pid)
+{
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof path, "%s/tasks", cgroup);
+	f = fopen(path, "w");
+	if (!f || fprintf(f, "%d\n", (int)pid) < 0 || fclose(f)) {
+		stop_hogs();
+		die(path);
+	}
+}
+
+static void print_stat(const char *cgroup, const char *when)
+{
+	char path[256], line[128];
+	FILE *f;
+
+	snprintf(path, sizeof path, "%s/cpu.stat", cgroup);
+	f = fopen(path, "r");
+	if (!f)
+		return;		/* no CONFIG_CFS_BANDWIDTH */
+	printf("%s cpu.stat:", when);
+	while (fgets(line, sizeof line, f)) {
+		line[strcspn(line, "\n")] = 0;
+		printf("  %s", line);
+	}
+	putchar('\n');
+	fclose(f);
+}
+
+static long long ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	const char *bg = NULL, *fg = NULL;
+	long long lat, sum = 0, max = 0, min = -1;
+	unsigned long hist[NR_BUCKETS] = { 0 };
+	unsigned long nr = 0, seconds = 10;
+	long period = 16666;
+	struct timespec next, now;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "b:f:n:p:t:")) != -1) {
+		switch (c) {
+		case 'b':
+			bg = optarg;
+			break;
+		case 'f':
+			fg = optarg;
+			break;
+		case 'n':
+			nr_hogs = atoi(optarg);
+			break;
+		case 'p':
+			period = atol(optarg);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc || nr_hogs < 0 || nr_hogs > MAX_HOGS ||
+	    period <= 0 || !seconds)
+		goto usage;
+
+	if (fg)
+		attach(fg, getpid());
+	if (bg)
+		print_stat(bg, "before");
+
+	for (i = 0; i < nr_hogs; ++i) {
+		hogs[i] = fork();
+		if (hogs[i] < 0) {
+			stop_hogs();
+			die("fork");
+		}
+		if (!hogs[i])
+			for (;;)
+				;
+		if (bg)
+			attach(bg, hogs[i]);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (nr < seconds * 1000000 / period) {
+		next.tv_nsec += period * 1000;
+		while (next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			++next.tv_sec;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &next, NULL) == EINTR)
+			;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		lat = ns(&now) - ns(&next);
+		sum += lat;
+		if (lat > max)
+			max = lat;
+		if (min < 0 || lat < min)
+			min = lat;
+		for (i = 0; i < NR_BUCKETS - 1; ++i)
+			if (lat < 100000LL << i)
+				break;
+		++hist[i];
+		++nr;
+	}
+
+	stop_hogs();
+
+	if (!nr) {
+		printf("no samples: the run is shorter than the period\n");
+		return 1;
+	}
+
+	printf("%lu wakeups every %ld us, %d hogs: latency min %lld avg %lld "
+	       "max %lld us\n", nr, period, nr_hogs, min / 1000,
+	       sum / (long long)nr / 1000, max / 1000);
+	for (i = 0; i < NR_BUCKETS; ++i) {
+		if (i < NR_BUCKETS - 1)
+			printf("  < %6d us", 100 << i);
+		else
+			printf("  >=%6d us", 100 << (i - 1));
+		printf(" %8lu\n", hist[i]);
+	}
+	if (bg)
+		print_stat(bg, "after");
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-b <bg cgroup>] [-f <fg cgroup>] "
+		"[-n <hogs>] [-p <period us>] [-t <seconds>]\n", argv[0]);
+	return 2;
+}
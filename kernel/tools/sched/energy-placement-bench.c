@@ -0,0 +1,319 @@
+/*
+ * energy-placement-bench.c -- idle residency and throughput of light tasks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* $(CROSS_COMPILE)gcc -Wall -Wextra -O2 -o energy-placement-bench \
+ *	energy-placement-bench.c -lrt */
+
+/*
+ * Run with:
+ *
+ *	energy-placement-bench [-e 0|1] [-n <tasks>] [-p <period us>]
+ *			       [-r <run us>] [-t <seconds>] [-w <workers>]
+ *
+ * Starts <tasks> periodic processes (four by default) that wake up every
+ * <period us> (16666, a 60Hz frame, by default) and run for <run us>
+ * (1000 by default), like audio or UI threads do, and <workers> busy
+ * looping processes (none by default) that count how much work they get
+ * done.  Prints, for each cpu, the share of the run it spent in each
+ * cpuidle state and how often it entered it, then how many periods the
+ * tasks ran and how many of them overran into the next one, and the
+ * loops the workers completed.  With -e
+ * it first writes kernel.sched_energy_aware and restores it afterwards,
+ * so that
+ *
+ *	energy-placement-bench -e 0
+ *	energy-placement-bench -e 1
+ *
+ * compares spreading with packing the tasks (CONFIG_SCHED_ENERGY_AWARE).
+ * How often wakeups were packed is in /sys/kernel/debug/sched_telemetry.
+ */
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define MAX_TASKS	64
+#define MAX_CPUS	8
+#define MAX_STATES	8
+
+#define ENERGY_AWARE	"/proc/sys/kernel/sched_energy_aware"
+
+struct count {
+	unsigned long done;		/* periods or loops */
+	unsigned long late;		/* periods that overran */
+};
+
+struct idle_stat {
+	unsigned long long time[MAX_STATES];	/* us */
+	unsigned long long usage[MAX_STATES];
+	char name[MAX_STATES][16];
+};
+
+static pid_t pids[2 * MAX_TASKS];
+static int nr_pids;
+static struct count *counts;
+
+
+static void die(const char *what)
+{
+	fprintf(stderr, "energy-placement-bench: %s: %s\n", what,
+		strerror(errno));
+	exit(1);
+}
+
+static void stop_all(void)
+{
+	int i;
+
+	for (i = 0; i < nr_pids; ++i)
+		if (pids[i] > 0) {
+			kill(pids[i], SIGKILL);
+			waitpid(pids[i], NULL, 0);
+		}
+}
+
+static long long ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static int read_ull(const char *path, unsigned long long *val)
+{
+	FILE *f = fopen(path, "r");
+	int ret;
+
+	if (!f)
+		return -1;
+	ret = fscanf(f, "%llu", val) == 1 ? 0 : -1;
+	fclose(f);
+	return ret;
+}
+
+/* Returns the number of idle states, 0 without CONFIG_CPU_IDLE */
+static int read_idle(int cpu, struct idle_stat *s)
+{
+	char path[128];
+	FILE *f;
+	int i;
+
+	for (i = 0; i < MAX_STATES; ++i) {
+		snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/"
+			 "cpuidle/state%d/time", cpu, i);
+		if (read_ull(path, &s->time[i]))
+			break;
+		snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/"
+			 "cpuidle/state%d/usage", cpu, i);
+		if (read_ull(path, &s->usage[i]))
+			break;
+		snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/"
+			 "cpuidle/state%d/name", cpu, i);
+		f = fopen(path, "r");
+		if (!f || !fgets(s->name[i], sizeof s->name[i], f))
+			strcpy(s->name[i], "?");
+		if (f)
+			fclose(f);
+		s->name[i][strcspn(s->name[i], "\n")] = 0;
+	}
+	return i;
+}
+
+static int write_energy_aware(int val)
+{
+	FILE *f = fopen(ENERGY_AWARE, "r+");
+	int old;
+
+	if (!f || fscanf(f, "%d", &old) != 1) {
+		if (f)
+			fclose(f);
+		return -1;
+	}
+	rewind(f);
+	if (fprintf(f, "%d\n", val) < 0 || fclose(f))
+		return -1;
+	return old;
+}
+
+static void spin(long long until)
+{
+	struct timespec now;
+
+	do
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	while (ns(&now) < until);
+}
+
+/* A period is late when its run ends after the next one should start */
+static void periodic(struct count *c, long period, long run)
+{
+	struct timespec next, now;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (;;) {
+		next.tv_nsec += period * 1000;
+		while (next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			++next.tv_sec;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &next, NULL) == EINTR)
+			;
+		spin(ns(&next) + run * 1000);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (ns(&now) > ns(&next) + period * 1000)
+			++c->late;
+		++c->done;
+	}
+}
+
+static void worker(struct count *c)
+{
+	volatile unsigned long i;
+
+	for (;;) {
+		for (i = 0; i < 100000; ++i)
+			;
+		++c->done;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct idle_stat before[MAX_CPUS], after[MAX_CPUS];
+	int states[MAX_CPUS];
+	unsigned long seconds = 10, done = 0, late = 0, loops = 0;
+	long period = 16666, run = 1000;
+	int nr_tasks = 4, nr_workers = 0, energy_aware = -1, old = -1;
+	int nr_cpus, cpu, c, i;
+	struct timespec start, end;
+	unsigned long long wall, idle;
+
+	while ((c = getopt(argc, argv, "e:n:p:r:t:w:")) != -1) {
+		switch (c) {
+		case 'e':
+			energy_aware = atoi(optarg);
+			break;
+		case 'n':
+			nr_tasks = atoi(optarg);
+			break;
+		case 'p':
+			period = atol(optarg);
+			break;
+		case 'r':
+			run = atol(optarg);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			nr_workers = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc || nr_tasks < 0 || nr_tasks > MAX_TASKS ||
+	    nr_workers < 0 || nr_workers > MAX_TASKS || period <= 0 ||
+	    run < 0 || run >= period || !seconds)
+		goto usage;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (nr_cpus > MAX_CPUS)
+		nr_cpus = MAX_CPUS;
+
+	counts = mmap(NULL, 2 * MAX_TASKS * sizeof *counts,
+		      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+		      -1, 0);
+	if (counts == MAP_FAILED)
+		die("mmap");
+
+	if (energy_aware >= 0) {
+		old = write_energy_aware(energy_aware);
+		if (old < 0)
+			die(ENERGY_AWARE);
+	}
+
+	for (cpu = 0; cpu < nr_cpus; ++cpu)
+		states[cpu] = read_idle(cpu, &before[cpu]);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < nr_tasks + nr_workers; ++i) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			stop_all();
+			die("fork");
+		}
+		if (!pids[i]) {
+			if (i < nr_tasks)
+				periodic(&counts[i], period, run);
+			worker(&counts[i]);
+		}
+		++nr_pids;
+	}
+
+	sleep(seconds);
+
+	for (cpu = 0; cpu < nr_cpus; ++cpu)
+		read_idle(cpu, &after[cpu]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	stop_all();
+	if (old >= 0 && write_energy_aware(old) < 0)
+		die(ENERGY_AWARE);
+
+	wall = (ns(&end) - ns(&start)) / 1000;
+	for (cpu = 0; cpu < nr_cpus; ++cpu) {
+		printf("cpu%d idle:", cpu);
+		if (!states[cpu])
+			printf("  no cpuidle states");
+		for (i = 0; i < states[cpu]; ++i) {
+			idle = after[cpu].time[i] - before[cpu].time[i];
+			printf("  %s %llu.%llu%% %llu times",
+			       after[cpu].name[i], idle * 100 / wall,
+			       idle * 1000 / wall % 10,
+			       after[cpu].usage[i] - before[cpu].usage[i]);
+		}
+		putchar('\n');
+	}
+
+	for (i = 0; i < nr_tasks; ++i) {
+		done += counts[i].done;
+		late += counts[i].late;
+	}
+	for (; i < nr_tasks + nr_workers; ++i)
+		loops += counts[i].done;
+	printf("%d tasks every %ld us for %ld us: %lu periods, %lu late\n",
+	       nr_tasks, period, run, done, late);
+	printf("%d workers: %lu loops, %llu per second\n", nr_workers, loops,
+	       loops * 1000000ULL / wall);
+	if (old >= 0)
+		printf("sched_energy_aware %d during the run, %d restored\n",
+		       energy_aware, old);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-e 0|1] [-n <tasks>] [-p <period us>] "
+		"[-r <run us>] [-t <seconds>] [-w <workers>]\n", argv[0]);
+	return 2;
+}
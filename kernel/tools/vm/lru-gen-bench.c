@@ -0,0 +1,232 @@
+/*
+ * lru-gen-bench.c -- reclaim cost and refaults of an anon and file workload
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* $(CROSS_COMPILE)gcc -Wall -Wextra -O2 -o lru-gen-bench lru-gen-bench.c */
+
+/*
+ * Run with:
+ *
+ *	lru-gen-bench <anon MB> <file> [<seconds>]
+ *
+ * once on a kernel booted with lru_gen=0 and once with lru_gen=1.  For
+ * <seconds> (60 by default) it writes to a hot eighth of <anon MB> of
+ * anonymous memory in every round, to the rest a slice at a time, and
+ * reads the next megabyte of <file>, going round in both.  Give it more
+ * anon memory than fits next to the file, and a file that is a fair
+ * part of memory, so that reclaim has to choose.  It prints the rounds
+ * it got done, the CPU time of the kswapd threads and of itself (which
+ * includes direct reclaim), and the reclaim and refault counters from
+ * /proc/vmstat.  See Documentation/vm/multigen_lru.txt.
+ */
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FILE_CHUNK	(1 << 20)
+#define COLD_SLICES	16
+
+/* Counters summed up over all the entries starting with the name */
+static const char *counters[] = {
+	"pgscan_kswapd", "pgscan_direct", "pgsteal", "allocstall",
+	"pswpin", "pswpout", "workingset_refault", "workingset_activate",
+	"lru_gen_aging", "lru_gen_young", NULL
+};
+
+struct sample {
+	struct timeval tv;
+	struct rusage ru;
+	unsigned long long kswapd_ticks;
+	unsigned long long vm[sizeof counters / sizeof *counters];
+};
+
+static long page_size;
+
+
+static void die(const char *what)
+{
+	fprintf(stderr, "lru-gen-bench: %s: %s\n", what, strerror(errno));
+	exit(1);
+}
+
+/* utime + stime of all kswapd threads, in clock ticks */
+static unsigned long long kswapd_ticks(void)
+{
+	unsigned long long total = 0;
+	unsigned long utime, stime;
+	char path[300], comm[32];
+	struct dirent *de;
+	FILE *f;
+	DIR *d;
+
+	d = opendir("/proc");
+	if (!d)
+		die("/proc");
+	while ((de = readdir(d))) {
+		if (de->d_name[0] < '0' || de->d_name[0] > '9')
+			continue;
+		snprintf(path, sizeof path, "/proc/%s/stat", de->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (fscanf(f, "%*d (%31[^)]) %*c %*d %*d %*d %*d %*d %*u "
+			   "%*u %*u %*u %*u %lu %lu", comm, &utime,
+			   &stime) == 3 && !strncmp(comm, "kswapd", 6))
+			total += utime + stime;
+		fclose(f);
+	}
+	closedir(d);
+	return total;
+}
+
+static void sample(struct sample *s)
+{
+	unsigned long long val;
+	char name[64];
+	FILE *f;
+	int i;
+
+	memset(s, 0, sizeof *s);
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		die("/proc/vmstat");
+	while (fscanf(f, "%63s %llu", name, &val) == 2)
+		for (i = 0; counters[i]; ++i)
+			if (!strncmp(name, counters[i], strlen(counters[i])))
+				s->vm[i] += val;
+	fclose(f);
+	s->kswapd_ticks = kswapd_ticks();
+	getrusage(RUSAGE_SELF, &s->ru);
+	gettimeofday(&s->tv, NULL);
+}
+
+static long ms(const struct timeval *a, const struct timeval *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1000 +
+		(b->tv_usec - a->tv_usec) / 1000;
+}
+
+static void print_mode(void)
+{
+	char cmdline[4096], *p;
+	size_t len;
+	FILE *f;
+
+	f = fopen("/proc/cmdline", "r");
+	if (!f)
+		return;
+	len = fread(cmdline, 1, sizeof cmdline - 1, f);
+	cmdline[len] = 0;
+	fclose(f);
+
+	p = strstr(cmdline, "lru_gen=");
+	printf("mode     lru_gen=%c\n", p ? p[8] : '?');
+}
+
+int main(int argc, char **argv)
+{
+	size_t anon_size, hot, cold, slice, n;
+	unsigned long rounds = 0, seconds = 60;
+	struct sample a, b;
+	off_t file_size, pos = 0;
+	char *anon, *buf;
+	long hz;
+	int fd, i;
+
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr, "usage: %s <anon MB> <file> [<seconds>]\n",
+			argv[0]);
+		return 2;
+	}
+	anon_size = strtoul(argv[1], NULL, 0) << 20;
+	if (argc > 3)
+		seconds = strtoul(argv[3], NULL, 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	hz = sysconf(_SC_CLK_TCK);
+
+	fd = open(argv[2], O_RDONLY);
+	if (fd < 0)
+		die(argv[2]);
+	file_size = lseek(fd, 0, SEEK_END);
+	if (file_size < FILE_CHUNK) {
+		fprintf(stderr, "lru-gen-bench: %s: too small\n", argv[2]);
+		return 1;
+	}
+	buf = malloc(FILE_CHUNK);
+	if (!buf)
+		die("malloc");
+
+	anon = mmap(NULL, anon_size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (anon == MAP_FAILED)
+		die("mmap");
+	hot = anon_size / 8 / page_size * page_size;
+	cold = anon_size - hot;
+	slice = cold / COLD_SLICES / page_size * page_size;
+
+	/* Populate everything before measuring */
+	for (n = 0; n < anon_size; n += page_size)
+		anon[n] = 1;
+
+	sample(&a);
+	for (;;) {
+		struct timeval now;
+		size_t start;
+
+		for (n = 0; n < hot; n += page_size)
+			anon[n]++;
+
+		start = hot + (rounds % COLD_SLICES) * slice;
+		for (n = 0; n < slice; n += page_size)
+			anon[start + n]++;
+
+		if (pos + FILE_CHUNK > file_size)
+			pos = 0;
+		if (pread(fd, buf, FILE_CHUNK, pos) < 0)
+			die("pread");
+		pos += FILE_CHUNK;
+
+		rounds++;
+		gettimeofday(&now, NULL);
+		if (now.tv_sec - a.tv.tv_sec >= (long)seconds)
+			break;
+	}
+	sample(&b);
+
+	print_mode();
+	printf("rounds   %lu in %ld ms\n", rounds, ms(&a.tv, &b.tv));
+	printf("kswapd   %llu ms\n",
+	       (b.kswapd_ticks - a.kswapd_ticks) * 1000 / hz);
+	printf("self     user %ld ms  sys %ld ms  majflt %ld\n",
+	       ms(&a.ru.ru_utime, &b.ru.ru_utime),
+	       ms(&a.ru.ru_stime, &b.ru.ru_stime),
+	       b.ru.ru_majflt - a.ru.ru_majflt);
+	for (i = 0; counters[i]; ++i)
+		printf("%-20s %llu\n", counters[i], b.vm[i] - a.vm[i]);
+
+	munmap(anon, anon_size);
+	close(fd);
+	return 0;
+}
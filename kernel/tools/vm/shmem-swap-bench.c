@@ -0,0 +1,199 @@
+/*
+ * shmem-swap-bench.c -- times swapping a large ashmem/tmpfs region back in
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* $(CROSS_COMPILE)gcc -Wall -Wextra -O2 -o shmem-swap-bench \
+ *	shmem-swap-bench.c */
+
+/*
+ * Run with:
+ *
+ *	shmem-swap-bench <region MB> <pressure MB> [seq|rand]
+ *
+ * Fills a region of ashmem (or of a tmpfs file in /dev/shm if there is no
+ * /dev/ashmem), pushes it out to swap by touching <pressure MB> of
+ * anonymous memory, then reads the region back in sequential or random
+ * page order.  Prints the time taken, the major faults and the swap
+ * counters from /proc/vmstat for both phases.
+ */
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ASHMEM_DEVICE	"/dev/ashmem"
+#define SHM_FILE	"/dev/shm/shmem-swap-bench"
+#define ASHMEM_SET_SIZE	_IOW(0x77, 3, size_t)	/* linux/ashmem.h */
+
+static const char *counters[] = {
+	"pswpin", "pswpout", "swap_ra", "swap_ra_hit", NULL
+};
+
+struct sample {
+	struct timeval tv;
+	long majflt;
+	unsigned long long vm[sizeof counters / sizeof *counters];
+};
+
+static long page_size;
+
+
+static void die(const char *what)
+{
+	fprintf(stderr, "shmem-swap-bench: %s: %s\n", what, strerror(errno));
+	exit(1);
+}
+
+static void sample(struct sample *s)
+{
+	unsigned long long val;
+	struct rusage ru;
+	char name[64];
+	FILE *f;
+	int i;
+
+	memset(s, 0, sizeof *s);
+	f = fopen("/proc/vmstat", "r");
+	if (f) {
+		while (fscanf(f, "%63s %llu", name, &val) == 2)
+			for (i = 0; counters[i]; ++i)
+				if (!strcmp(name, counters[i]))
+					s->vm[i] = val;
+		fclose(f);
+	}
+	getrusage(RUSAGE_SELF, &ru);
+	s->majflt = ru.ru_majflt;
+	gettimeofday(&s->tv, NULL);
+}
+
+static void report(const char *phase, const struct sample *a,
+		   const struct sample *b)
+{
+	long ms;
+	int i;
+
+	ms = (b->tv.tv_sec - a->tv.tv_sec) * 1000 +
+		(b->tv.tv_usec - a->tv.tv_usec) / 1000;
+	printf("%-8s %6ld ms  majflt %6ld", phase, ms, b->majflt - a->majflt);
+	for (i = 0; counters[i]; ++i)
+		printf("  %s %llu", counters[i], b->vm[i] - a->vm[i]);
+	putchar('\n');
+}
+
+static char *map_region(size_t size)
+{
+	char *p;
+	int fd;
+
+	fd = open(ASHMEM_DEVICE, O_RDWR);
+	if (fd >= 0) {
+		if (ioctl(fd, ASHMEM_SET_SIZE, size) < 0)
+			die("ASHMEM_SET_SIZE");
+	} else {
+		fd = open(SHM_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (fd < 0)
+			die(SHM_FILE);
+		unlink(SHM_FILE);
+		if (ftruncate(fd, size) < 0)
+			die("ftruncate");
+	}
+
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		die("mmap");
+	close(fd);
+	return p;
+}
+
+int main(int argc, char **argv)
+{
+	size_t size, pressure, pages, i, n;
+	struct sample a, b;
+	size_t *order;
+	char *region, *anon;
+	int random = 0;
+
+	if (argc < 3 || (argc > 3 && strcmp(argv[3], "seq") &&
+			 strcmp(argv[3], "rand"))) {
+		fprintf(stderr, "usage: %s <region MB> <pressure MB> "
+			"[seq|rand]\n", argv[0]);
+		return 2;
+	}
+	size = strtoul(argv[1], NULL, 0) << 20;
+	pressure = strtoul(argv[2], NULL, 0) << 20;
+	random = argc > 3 && !strcmp(argv[3], "rand");
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (size < (size_t)page_size) {
+		fprintf(stderr, "shmem-swap-bench: the region is smaller "
+			"than a page\n");
+		return 2;
+	}
+	pages = size / page_size;
+	region = map_region(size);
+
+	order = malloc(pages * sizeof *order);
+	if (!order)
+		die("malloc");
+	for (i = 0; i < pages; ++i)
+		order[i] = i;
+	if (random) {
+		srand(getpid());
+		for (i = pages - 1; i > 0; --i) {
+			size_t j = rand() % (i + 1), t = order[i];
+			order[i] = order[j];
+			order[j] = t;
+		}
+	}
+
+	for (i = 0; i < pages; ++i)
+		memset(region + i * page_size, (int)(i & 0xff), page_size);
+
+	/* Push the region out */
+	sample(&a);
+	anon = mmap(NULL, pressure, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (anon == MAP_FAILED)
+		die("mmap");
+	for (n = 0; n < pressure; n += page_size)
+		anon[n] = 1;
+	munmap(anon, pressure);
+	sample(&b);
+	report("swapout", &a, &b);
+
+	/* And read it back */
+	sample(&a);
+	for (i = 0; i < pages; ++i) {
+		char *page = region + order[i] * page_size;
+
+		if (page[page_size - 1] != (char)(order[i] & 0xff)) {
+			fprintf(stderr, "shmem-swap-bench: page %zu "
+				"corrupted\n", order[i]);
+			return 1;
+		}
+	}
+	sample(&b);
+	report(random ? "rand-in" : "seq-in", &a, &b);
+
+	munmap(region, size);
+	return 0;
+}